@@ -0,0 +1,13 @@
+// The passes of array_loops.as done with the native array builtins, plus a
+// sort of all 10M elements.
+let n := 10000000;
+let a := map(map(range(n), "*", 7919), "%", 100003);
+
+let total := sum(a);
+let top := max(a);
+let b := map(a, "+", 3);
+let found := search(a, 100003);
+lets_print{total + top + b[n - 1] + found};
+
+sort(a);
+lets_print{a[0] + a[n - 1] + min(a)};
@@ -0,0 +1,35 @@
+// Bulk array work written as interpreted loops over 10M ints; compare with
+// array_builtins.as, which does the same passes with the native builtins.
+// (repeat_while stands in for `if` so assignments reach the loop's frame.)
+let n := 10000000;
+let a := map(map(range(n), "*", 7919), "%", 100003);
+
+let total := 0;
+let top := a[0];
+let i := 0;
+repeat_while (n > i) {
+    let v := a[i];
+    total := total + v;
+    repeat_while (v > top) {
+        top := v;
+    }
+    i := i + 1;
+}
+
+let b := array(n, 0);
+i := 0;
+repeat_while (n > i) {
+    b[i] := a[i] + 3;
+    i := i + 1;
+}
+
+let found := 0 - 1;
+i := 0;
+repeat_while (n > i) {
+    repeat_while (a[i] == 100003) {
+        found := i;
+        i := n - 1;
+    }
+    i := i + 1;
+}
+lets_print{total + top + b[n - 1] + found};
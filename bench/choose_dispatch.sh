@@ -0,0 +1,55 @@
+#!/bin/sh
+# Times a loop dispatching on an int and on a string through a `choose`
+# of N cases against the same dispatch written as a check_if / else_when
+# chain, reporting the fastest exec_ms (from --stats) of RUNS runs.
+# Usage: bench/choose_dispatch.sh <interpreter> [cases] [runs] [flags...]
+LANG_BIN=${1:?usage: $0 <interpreter> [cases] [runs] [flags...]}
+N=${2:-100}
+RUNS=${3:-5}
+shift; [ $# -gt 0 ] && shift; [ $# -gt 0 ] && shift
+TMP=$(mktemp -d) || exit 1
+trap 'rm -rf "$TMP"' EXIT
+
+# $1: choose or chain. Subjects cycle through every case and one miss.
+gen() {
+    awk -v n="$N" -v style="$1" 'BEGIN {
+        for (f = 0; f < 2; f++) {
+            printf "define pick%d(v) {\n", f
+            if (style == "choose") printf "    choose (v) {\n"
+            for (i = 0; i < n; i++) {
+                label = f ? "\"k" i "\"" : i
+                if (style == "choose") printf "        when %s { yield %d; }\n", label, i
+                else printf "    %s (v == %s) { yield %d; }\n", i ? "else_when" : "check_if", label, i
+            }
+            if (style == "choose") printf "    }\n"
+            printf "    yield 0 - 1;\n}\n"
+        }
+        print "let keys := [];"
+        printf "let i := 0;\nrepeat_while (%d > i) {\n    append(keys, \"k\" + i);\n    i := i + 1;\n}\n", n + 1
+        print "let total := 0;"
+        print "let round := 0;"
+        printf "repeat_while (%d > round) {\n", int(200000 / (n + 1))
+        print "    let v := 0;"
+        printf "    repeat_while (%d > v) {\n", n + 1
+        print "        total := total + pick0(v) + pick1(keys[v]);"
+        print "        v := v + 1;"
+        print "    }"
+        print "    round := round + 1;"
+        print "}"
+        print "lets_print{total};"
+    }'
+}
+
+best() {
+    n=0
+    while [ "$n" -lt "$RUNS" ]; do
+        "$LANG_BIN" --quiet --stats "$@" 2>&1 >/dev/null | sed -n 's/.*"exec_ms":\([0-9.]*\).*/\1/p'
+        n=$((n + 1))
+    done | sort -n | head -n 1
+}
+
+gen choose > "$TMP/choose.as"
+gen chain > "$TMP/chain.as"
+[ "$("$LANG_BIN" --quiet "$@" "$TMP/choose.as")" = "$("$LANG_BIN" --quiet "$@" "$TMP/chain.as")" ] || { echo "outputs differ" >&2; exit 1; }
+printf '%6s %12s %12s\n' cases choose_ms chain_ms
+printf '%6d %12s %12s\n' "$N" "$(best "$@" "$TMP/choose.as")" "$(best "$@" "$TMP/chain.as")"
@@ -0,0 +1,103 @@
+// Microbenchmark of the interpreter's Dict against std::unordered_map on the
+// operations scripts use: insert, hit lookup, miss lookup and erase, with
+// int keys and with string keys (interned and built at run time).
+// Build and run with `make bench-dict`; prints one JSON object per case.
+#include "interpreter.h"
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+double ms_since(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+void report(const char* keys, const char* table, size_t n, double insert, double hit, double miss, double erase,
+            long check) {
+    std::printf("{\"keys\":\"%s\",\"table\":\"%s\",\"n\":%zu,\"insert_ns\":%.1f,\"hit_ns\":%.1f,\"miss_ns\":%.1f,"
+                "\"erase_ns\":%.1f,\"check\":%ld}\n",
+                keys, table, n, insert * 1e6 / n, hit * 1e6 / n, miss * 1e6 / n, erase * 1e6 / n, check);
+}
+
+// Runs the four phases over `present` (inserted) and `absent` (never inserted) keys.
+template <typename Key, typename Hash>
+void bench_std(const char* name, const std::vector<Key>& present, const std::vector<Key>& absent) {
+    std::unordered_map<Key, Value, Hash> table;
+    long check = 0;
+    Clock::time_point start = Clock::now();
+    for (size_t i = 0; i < present.size(); ++i) table[present[i]] = Value(static_cast<int>(i));
+    double insert = ms_since(start);
+    start = Clock::now();
+    for (auto& key : present) check += table.find(key)->second.int_val;
+    double hit = ms_since(start);
+    start = Clock::now();
+    for (auto& key : absent) check += table.find(key) != table.end();
+    double miss = ms_since(start);
+    start = Clock::now();
+    for (auto& key : present) check += static_cast<long>(table.erase(key));
+    double erase = ms_since(start);
+    report(name, "std::unordered_map", present.size(), insert, hit, miss, erase, check);
+}
+
+void bench_dict(const char* name, const std::vector<Value>& present, const std::vector<Value>& absent) {
+    Dict table;
+    long check = 0;
+    Clock::time_point start = Clock::now();
+    for (size_t i = 0; i < present.size(); ++i) table.insert(present[i]) = Value(static_cast<int>(i));
+    double insert = ms_since(start);
+    start = Clock::now();
+    for (auto& key : present) check += table.find(key)->int_val;
+    double hit = ms_since(start);
+    start = Clock::now();
+    for (auto& key : absent) check += table.find(key) != nullptr;
+    double miss = ms_since(start);
+    start = Clock::now();
+    for (auto& key : present) check += table.erase(key);
+    double erase = ms_since(start);
+    report(name, "Dict", present.size(), insert, hit, miss, erase, check);
+}
+
+std::vector<Value> string_values(const std::vector<std::string>& texts, bool interned) {
+    std::vector<Value> values;
+    values.reserve(texts.size());
+    for (auto& text : texts) {
+        values.push_back(Value(text));
+        if (interned) values.back().int_val = SymbolTable::intern(text);
+    }
+    return values;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    size_t n = argc > 1 ? std::stoul(argv[1]) : 1000000;
+
+    // Scattered ints, and strings shaped like identifiers.
+    std::vector<int> ints, missing_ints;
+    std::vector<std::string> texts, missing_texts;
+    for (size_t i = 0; i < n; ++i) {
+        ints.push_back(static_cast<int>(i * 2654435761u));
+        missing_ints.push_back(static_cast<int>(i * 2654435761u + 1));
+        texts.push_back("key_" + std::to_string(i * 7919));
+        missing_texts.push_back("miss_" + std::to_string(i * 7919));
+    }
+
+    std::vector<Value> int_keys, missing_int_keys;
+    for (size_t i = 0; i < n; ++i) {
+        int_keys.push_back(Value(ints[i]));
+        missing_int_keys.push_back(Value(missing_ints[i]));
+    }
+
+    bench_std<int, std::hash<int>>("int", ints, missing_ints);
+    bench_dict("int", int_keys, missing_int_keys);
+    bench_std<std::string, std::hash<std::string>>("string", texts, missing_texts);
+    bench_dict("string", string_values(texts, false), string_values(missing_texts, false));
+    bench_dict("interned string", string_values(texts, true), string_values(missing_texts, true));
+    return 0;
+}
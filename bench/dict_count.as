@@ -0,0 +1,25 @@
+// Counts 1M keys drawn from 50k distinct ints in a dictionary, then looks
+// every key up again and removes half of them.
+let n := 1000000;
+let keys := map(map(range(n), "*", 7919), "%", 50021);
+let counts := {};
+let i := 0;
+repeat_while (n > i) {
+    let k := keys[i];
+    counts[k] := get(counts, k, 0) + 1;
+    i := i + 1;
+}
+
+let total := 0;
+i := 0;
+repeat_while (n > i) {
+    total := total + counts[keys[i]];
+    i := i + 1;
+}
+
+i := 0;
+repeat_while (50021 > i) {
+    remove(counts, i);
+    i := i + 2;
+}
+lets_print{length(counts) + total};
@@ -0,0 +1,55 @@
+#!/bin/sh
+# Streams a generated access log through open_file/read_line and reports
+# throughput and peak RSS, which should stay flat as the file grows. The
+# log is made once per size under bench/generated; `wc -l` gives the I/O floor.
+# Usage: bench/file_scan.sh <interpreter> [size_mb]
+LANG_BIN=${1:?usage: $0 <interpreter> [size_mb]}
+SIZE_MB=${2:-2048}
+DIR=$(dirname "$0")
+LOG=$DIR/generated/access_${SIZE_MB}mb.log
+
+if [ ! -f "$LOG" ]; then
+    mkdir -p "$DIR/generated"
+    awk -v bytes=$((SIZE_MB * 1048576)) 'BEGIN {
+        split("GET POST PUT DELETE", verb, " ")
+        split("200 200 200 304 404 500", status, " ")
+        for (i = 0; total < bytes; i++) {
+            line = sprintf("%s /item/%d %s %d", verb[i % 4 + 1], i % 9973, status[i % 6 + 1], (i * 7919) % 65536)
+            print line
+            total += length(line) + 1
+        }
+    }' > "$LOG"
+fi
+
+SCRIPT=$(mktemp)
+cat > "$SCRIPT" <<AS
+let f := open_file("$LOG");
+let lines := 0;
+let bytes := 0;
+let errors := 0;
+repeat_while (has_line(f)) {
+    let line := read_line(f);
+    bytes := bytes + number(field(line, 3));
+    repeat_while (field(line, 2) == "500") {
+        errors := errors + 1;
+        line := "";
+    }
+    lines := lines + 1;
+}
+lets_print{lines};
+lets_print{errors};
+lets_print{bytes};
+AS
+
+now() { date +%s%N; }
+start=$(now)
+wc -l "$LOG" > /dev/null
+wc_ms=$(( ($(now) - start) / 1000000 ))
+start=$(now)
+"$LANG_BIN" --quiet --stats "$SCRIPT" > /dev/null 2> "$SCRIPT.err" || { cat "$SCRIPT.err"; exit 1; }
+ms=$(( ($(now) - start) / 1000000 ))
+[ "$ms" -gt 0 ] || ms=1
+rss=$(sed -n 's/.*"peak_rss_kb":\([0-9]*\).*/\1/p' "$SCRIPT.err")
+printf '{"bench":"file_scan","size_mb":%d,"wall_ms":%d,"mb_per_s":%.1f,"wc_ms":%d,"peak_rss_kb":%s}\n' \
+    "$SIZE_MB" "$ms" "$(echo "$SIZE_MB $ms" | awk '{ print $1 * 1000 / $2 }')" "$wc_ms" "${rss:-0}"
+rm -f "$SCRIPT" "$SCRIPT.err"
@@ -0,0 +1,17 @@
+#!/bin/sh
+# Writes a large generated script for lexer/parser timing.
+# Usage: bench/gen_large.sh <output.as> [functions]
+OUT=${1:?usage: $0 <output.as> [functions]}
+N=${2:-5000}
+mkdir -p "$(dirname "$OUT")"
+awk -v n="$N" 'BEGIN {
+    print "// Generated: " n " functions, one blueprint per 10 functions, a short main."
+    for (i = 0; i < n; i++) {
+        if (i % 10 == 0) printf "blueprint Shape%d {\n    define area(w, h) {\n        let a := w + h;\n        yield a;\n    }\n}\n", i
+        printf "define helper%d(a, b) {\n    let t := a + b - %d;\n", i, i
+        printf "    if (t > 10) {\n        lets_print{\"big \" + t};\n    } else_when (t == 3) {\n        t := t + 1;\n    } otherwise {\n        t := 0;\n    }\n"
+        printf "    repeat_while (t > 0) {\n        t := t - 1;\n    }\n    yield t + helper_base;\n}\n"
+    }
+    print "let helper_base := 1;"
+    print "lets_print{helper0(5, 6)};"
+}' > "$OUT"
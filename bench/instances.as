@@ -0,0 +1,25 @@
+// Blueprint instances: create a million, update their fields by name and
+// through a method, and read them back.
+blueprint Particle {
+    let x := 0;
+    let y := 0;
+    let vx := 1;
+    let vy := 2;
+
+    define step() {
+        x := x + vx;
+        y := y + vy;
+    }
+}
+
+let i := 0;
+let checksum := 0;
+repeat_while (1000000 > i) {
+    instance Particle p;
+    p.vx := i;
+    p.step();
+    p.y := p.y + 1;
+    checksum := checksum + p.x + p.y;
+    i := i + 1;
+}
+lets_print{checksum};
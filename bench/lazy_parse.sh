@@ -0,0 +1,28 @@
+#!/bin/sh
+# Time to the first statement (lex + parse + import, from --stats) of a
+# generated script whose main calls one of its functions, parsed up front
+# and with --lazy-parse.
+# Usage: bench/lazy_parse.sh <interpreter> [functions] [runs]
+LANG_BIN=${1:?usage: $0 <interpreter> [functions] [runs]}
+N=${2:-5000}
+RUNS=${3:-5}
+TMP=$(mktemp -d) || exit 1
+trap 'rm -rf "$TMP"' EXIT
+"$(dirname "$0")/gen_large.sh" "$TMP/large.as" "$N"
+
+# Fastest of RUNS runs: "first_stmt_ms parse_ms".
+best() {
+    n=0
+    while [ "$n" -lt "$RUNS" ]; do
+        "$LANG_BIN" --quiet --stats "$@" "$TMP/large.as" 2>&1 >/dev/null | tail -n 1
+        n=$((n + 1))
+    done | sed 's/[{}"]//g' | awk -F, '{
+        for (i = 1; i <= NF; i++) { split($i, kv, ":"); v[kv[1]] = kv[2] }
+        t = v["lex_ms"] + v["parse_ms"] + v["import_ms"]
+        if (NR == 1 || t < best) { best = t; parse = v["parse_ms"] }
+    } END { printf "%.1f %.1f", best, parse }'
+}
+
+printf '%10s %14s %10s\n' mode first_stmt_ms parse_ms
+printf '%10s %14s %10s\n' eager $(best)
+printf '%10s %14s %10s\n' lazy $(best --lazy-parse)
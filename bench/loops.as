@@ -0,0 +1,8 @@
+// Tight integer loop: arithmetic, comparison and assignment only.
+let i := 0;
+let acc := 0;
+repeat_while (300000 > i) {
+    acc := acc + i - 3;
+    i := i + 1;
+}
+lets_print{acc};
@@ -0,0 +1,20 @@
+// Method-heavy blueprint code: small methods called from a hot loop.
+blueprint Point {
+    define shift(x, dx) {
+        yield x + dx;
+    }
+    define dist(x, y) {
+        yield x + y;
+    }
+}
+
+instance Point p;
+let i := 0;
+let acc := 0;
+repeat_while (50000 > i) {
+    let x := p.shift(i, 3);
+    let y := p.shift(x, 0 - 2);
+    acc := acc + p.dist(x, y);
+    i := i + 1;
+}
+lets_print{acc};
@@ -0,0 +1,23 @@
+#!/bin/sh
+# Times bench/parallel_sum.as with 1, 2, 4, ... N parallel_repeat workers.
+# Usage: bench/parallel_scaling.sh <interpreter> [max_workers] [grain]
+LANG_BIN=${1:?usage: $0 <interpreter> [max_workers] [grain]}
+MAX=${2:-$(nproc 2>/dev/null || echo 4)}
+GRAIN=${3:-0}
+SCRIPT=$(dirname "$0")/parallel_sum.as
+
+now() { date +%s%N; }
+
+printf '%8s %12s %9s\n' workers wall_ms speedup
+base=
+w=1
+while :; do
+    start=$(now)
+    "$LANG_BIN" --workers "$w" --grain "$GRAIN" "$SCRIPT" > /dev/null || exit 1
+    ms=$(( ($(now) - start) / 1000000 ))
+    [ "$ms" -gt 0 ] || ms=1
+    [ -n "$base" ] || base=$ms
+    awk -v w="$w" -v ms="$ms" -v b="$base" 'BEGIN { printf "%8d %12d %9.2f\n", w, ms, b / ms }'
+    [ "$w" -ge "$MAX" ] && break
+    w=$((w * 2)); [ "$w" -gt "$MAX" ] && w=$MAX
+done
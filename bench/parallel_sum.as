@@ -0,0 +1,12 @@
+// Scaling workload for parallel_repeat: independent, equally sized iterations.
+let total := 0;
+parallel_repeat (i := 0 until 2000) accumulate total {
+    let acc := 0;
+    let k := 0;
+    repeat_while (200 > k) {
+        acc := acc + i - k;
+        k := k + 1;
+    }
+    accumulate acc;
+}
+lets_print{total};
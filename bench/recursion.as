@@ -0,0 +1,17 @@
+// Deep recursion: 200 descents of 1000 nested calls each.
+define depth(n) {
+    let r := 0;
+    repeat_while (n > 0) {
+        r := 1 + depth(n - 1);
+        n := 0;
+    }
+    yield r;
+}
+
+let round := 0;
+let total := 0;
+repeat_while (200 > round) {
+    total := total + depth(1000);
+    round := round + 1;
+}
+lets_print{total};
@@ -0,0 +1,131 @@
+// Reparse latency of a one-character edit in a generated 100k-line script:
+// a full lex + parse against Document::apply(). Each edit is applied and then
+// undone; after every step the incremental tokens and statements are checked
+// against a from-scratch parse of the same text.
+// Build and run with `make bench-reparse`; prints one JSON object per case.
+#include "incremental.h"
+#include "parser.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+double ms_since(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// The same shape as bench/gen_large.sh, grown to `lines` lines.
+std::string generate(size_t lines) {
+    std::string source;
+    size_t n = 0;
+    char buffer[512];
+    for (int i = 0; n < lines; ++i) {
+        if (i % 10 == 0) {
+            std::snprintf(buffer, sizeof buffer,
+                          "blueprint Shape%d {\n    define area(w, h) {\n        let a := w + h;\n"
+                          "        yield a;\n    }\n}\n", i);
+            source += buffer;
+            n += 6;
+        }
+        std::snprintf(buffer, sizeof buffer,
+                      "define helper%d(a, b) {\n    let t := a + b - %d;\n    if (t > 10) {\n"
+                      "        lets_print{\"big \" + t};\n    } else_when (t == 3) {\n        t := t + 1;\n"
+                      "    } otherwise {\n        t := 0;\n    }\n    repeat_while (t > 0) {\n"
+                      "        t := t - 1;\n    }\n    yield t + helper_base;\n}\n", i, i);
+        source += buffer;
+        n += 14;
+    }
+    return source + "let helper_base := 1;\nlets_print{helper0(5, 6)};\n";
+}
+
+bool same_tokens(const std::vector<Token>& a, const std::vector<Token>& b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (a[i].type != b[i].type || a[i].value != b[i].value || a[i].line != b[i].line ||
+            a[i].offset != b[i].offset || a[i].end != b[i].end) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void check(Document& doc) {
+    Document fresh(doc.source());
+    if (!same_tokens(doc.tokens(), fresh.tokens())) throw std::runtime_error("token streams differ");
+    if (doc.program().statements.size() != fresh.program().statements.size()) throw std::runtime_error("statement counts differ");
+    if (doc.errors() != fresh.errors()) throw std::runtime_error("errors differ");
+    for (size_t i = 0; i < fresh.program().statements.size(); ++i) {
+        if (doc.program().statements[i]->line != fresh.program().statements[i]->line) throw std::runtime_error("lines differ");
+    }
+}
+
+double median(std::vector<double> v) {
+    std::sort(v.begin(), v.end());
+    return v[v.size() / 2];
+}
+
+// Applies `edit` and its inverse `runs` times, timing each apply().
+void bench_edit(Document& doc, const char* name, const TextEdit& edit) {
+    TextEdit undo{edit.offset, edit.inserted.size(), doc.source().substr(edit.offset, edit.removed)};
+    std::vector<double> apply_ms, undo_ms;
+    Document::EditStats stats;
+    for (int run = 0; run < 7; ++run) {
+        Clock::time_point start = Clock::now();
+        doc.apply(edit);
+        apply_ms.push_back(ms_since(start));
+        stats = doc.last_edit();
+        if (run == 0) check(doc);
+        start = Clock::now();
+        doc.apply(undo);
+        undo_ms.push_back(ms_since(start));
+        if (run == 0) check(doc);
+    }
+    std::printf("{\"edit\":\"%s\",\"apply_ms\":%.3f,\"undo_ms\":%.3f,\"tokens_relexed\":%zu,\"statements_reparsed\":%zu,\"statements_reused\":%zu}\n",
+                name, median(apply_ms), median(undo_ms), stats.tokens_relexed, stats.statements_reparsed,
+                stats.statements_reused);
+}
+
+size_t find_after(const std::string& text, size_t from, const std::string& needle) {
+    size_t at = text.find(needle, from);
+    if (at == std::string::npos) throw std::runtime_error("needle not found: " + needle);
+    return at;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    size_t lines = argc > 1 ? std::stoul(argv[1]) : 100000;
+    std::string source = generate(lines);
+
+    std::vector<double> full_ms;
+    size_t statement_count = 0;
+    for (int run = 0; run < 5; ++run) {
+        Clock::time_point start = Clock::now();
+        Lexer lexer(source, true);
+        Parser parser(lexer.tokenize());
+        auto ast = parser.parse();
+        full_ms.push_back(ms_since(start));
+        statement_count = static_cast<ProgramNode&>(*ast).statements.size();
+    }
+    std::printf("{\"lines\":%zu,\"bytes\":%zu,\"statements\":%zu,\"full_parse_ms\":%.3f}\n",
+                static_cast<size_t>(std::count(source.begin(), source.end(), '\n')), source.size(), statement_count,
+                median(full_ms));
+
+    Document doc(source);
+    size_t middle = find_after(source, source.size() / 2, "define helper");
+    bench_edit(doc, "digit in a function body", TextEdit{find_after(source, middle, "t - 1;") + 4, 1, "2"});
+    bench_edit(doc, "char in an identifier", TextEdit{find_after(source, middle, "helper_base;") + 6, 0, "x"});
+    bench_edit(doc, "newline (shifts later lines)", TextEdit{find_after(source, middle, "let t"), 0, "\n"});
+    bench_edit(doc, "delete a ';' (syntax error)", TextEdit{find_after(source, middle, "t := 0;") + 6, 1, ""});
+    bench_edit(doc, "delete a '}' (unbalanced)", TextEdit{find_after(source, middle, "    }\n    yield") + 4, 1, ""});
+    bench_edit(doc, "open a string (relexes to the end)", TextEdit{find_after(source, middle, "t := 0;") + 5, 0, "\""});
+    bench_edit(doc, "digit in the last statement", TextEdit{source.size() - 5, 1, "7"});
+    return 0;
+}
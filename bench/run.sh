@@ -0,0 +1,39 @@
+#!/bin/sh
+# Runs every bench/*.as workload (plus generated sources) several times and
+# prints one JSON object per workload: median wall time, median per-phase
+# times reported by --stats, and peak RSS. Compare output across commits.
+# Usage: bench/run.sh <interpreter> [runs] [extra interpreter flags...]
+LANG_BIN=${1:?usage: $0 <interpreter> [runs] [flags...]}
+RUNS=${2:-5}
+shift; [ $# -gt 0 ] && shift
+DIR=$(dirname "$0")
+COMMIT=$(git -C "$DIR" rev-parse --short HEAD 2>/dev/null || echo unknown)
+
+[ -f "$DIR/generated/large.as" ] || "$DIR/gen_large.sh" "$DIR/generated/large.as" 5000
+
+median() { sort -n | awk '{ v[NR] = $1 } END { if (NR == 0) print 0; else if (NR % 2) print v[(NR + 1) / 2]; else print (v[NR / 2] + v[NR / 2 + 1]) / 2 }'; }
+field() { sed -n "s/.*\"$1\":\([-0-9.]*\).*/\1/p"; }
+
+for script in "$DIR"/*.as "$DIR"/generated/*.as; do
+    [ -f "$script" ] || continue
+    name=$(basename "$script" .as)
+    tmp=$(mktemp)
+    r=0
+    while [ "$r" -lt "$RUNS" ]; do
+        start=$(date +%s%N)
+        "$LANG_BIN" --quiet --stats "$@" "$script" > /dev/null 2> "$tmp.err" < /dev/null
+        end=$(date +%s%N)
+        stats=$(grep '^{' "$tmp.err" | tail -1)
+        echo "$(( (end - start) / 1000 )) $(echo "$stats" | field lex_ms) $(echo "$stats" | field parse_ms) $(echo "$stats" | field exec_ms) $(echo "$stats" | field peak_rss_kb) $(echo "$stats" | field status)" >> "$tmp"
+        r=$((r + 1))
+    done
+    wall=$(awk '{ print $1 / 1000 }' "$tmp" | median)
+    lex=$(awk '{ print $2 }' "$tmp" | median)
+    parse=$(awk '{ print $3 }' "$tmp" | median)
+    exec_ms=$(awk '{ print $4 }' "$tmp" | median)
+    rss=$(awk '{ print $5 }' "$tmp" | sort -n | tail -1)
+    status=$(awk '{ print $6 }' "$tmp" | sort -n | tail -1)
+    printf '{"bench":"%s","commit":"%s","runs":%d,"wall_ms":%s,"lex_ms":%s,"parse_ms":%s,"exec_ms":%s,"peak_rss_kb":%s,"status":%s}\n' \
+        "$name" "$COMMIT" "$RUNS" "$wall" "${lex:-0}" "${parse:-0}" "${exec_ms:-0}" "${rss:-0}" "${status:-1}"
+    rm -f "$tmp" "$tmp.err"
+done
@@ -0,0 +1,27 @@
+// Initialization for bench/snapshot_startup.sh: a lookup table, a word
+// list and a few blueprints, built the slow way at startup.
+let squares := {};
+let words := [];
+let i := 0;
+repeat_while (60000 > i) {
+    let square := 0;
+    let j := 0;
+    repeat_while (8 > j) {
+        square := square + i;
+        j := j + 1;
+    }
+    squares[i] := square;
+    append(words, "w" + i);
+    i := i + 1;
+}
+blueprint Config {
+    let name := "bench";
+    let size := 60000;
+    define describe() {
+        yield name + ":" + size;
+    }
+}
+instance Config config;
+define lookup(n) {
+    yield squares[n];
+}
@@ -0,0 +1,3 @@
+lets_print{lookup(1234)};
+lets_print{words[59999]};
+lets_print{config.describe()};
@@ -0,0 +1,36 @@
+#!/bin/sh
+# Times bench/snapshot/query.as after running bench/snapshot/init.as in the
+# same process, against restoring the state that script leaves behind from
+# a --snapshot-out image.
+# Usage: bench/snapshot_startup.sh <interpreter> [runs]
+LANG_BIN=${1:?usage: $0 <interpreter> [runs]}
+RUNS=${2:-5}
+DIR=$(dirname "$0")
+TMP=$(mktemp -d) || exit 1
+trap 'rm -rf "$TMP"' EXIT
+
+cat "$DIR/snapshot/init.as" "$DIR/snapshot/query.as" > "$TMP/cold.as"
+"$LANG_BIN" --quiet --snapshot-out "$TMP/init.snap" "$DIR/snapshot/init.as" || exit 1
+
+now() { date +%s%N; }
+
+# Fastest of RUNS runs, in ms.
+best() {
+    min=
+    n=0
+    while [ "$n" -lt "$RUNS" ]; do
+        start=$(now)
+        "$LANG_BIN" --quiet "$@" > /dev/null || exit 1
+        ms=$(( ($(now) - start) / 1000000 ))
+        [ -z "$min" ] || [ "$ms" -lt "$min" ] && min=$ms
+        n=$((n + 1))
+    done
+    echo "$min"
+}
+
+cold=$(best "$TMP/cold.as")
+warm=$(best --snapshot "$TMP/init.snap" "$DIR/snapshot/query.as")
+[ "$warm" -gt 0 ] || warm=1
+printf '%8s %10s %10s %9s\n' image_kb cold_ms warm_ms speedup
+awk -v kb=$(( $(wc -c < "$TMP/init.snap") / 1024 )) -v c="$cold" -v w="$warm" \
+    'BEGIN { printf "%8d %10d %10d %9.2f\n", kb, c, w, c / w }'
@@ -0,0 +1,10 @@
+// Builds a 10 MB string with s := s + x, one 10-byte piece at a time.
+let s := "";
+let i := 0;
+repeat_while (1048576 > i) {
+    s := s + "0123456789";
+    i := i + 1;
+}
+let check := s == "";
+lets_print{"built"};
+lets_print{check};
@@ -0,0 +1,8 @@
+// Repeated string concatenation: s := s + x in a loop.
+let s := "";
+let i := 0;
+repeat_while (20000 > i) {
+    s := s + "row " + i + ";";
+    i := i + 1;
+}
+lets_print{"built"};
@@ -1,9 +1,40 @@
 #ifndef AST_H
 #define AST_H
 
+#include "symbol.h"
+#include <atomic>
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <memory>
+#include <mutex>
+#include <unordered_map>
+
+// Slots of one interpreter frame (a block, a function body or one
+// parallel_repeat iteration), filled in by resolve_slots(). Every name
+// written in the frame gets a fixed index into the frame's stack window.
+struct FrameLayout {
+    std::vector<Symbol> slots;
+    std::unordered_map<Symbol, int> index;
+
+    int find(Symbol name) const {
+        if (slots.size() <= 8) {
+            for (size_t i = 0; i < slots.size(); ++i) {
+                if (slots[i] == name) return static_cast<int>(i);
+            }
+            return -1;
+        }
+        auto it = index.find(name);
+        return it == index.end() ? -1 : it->second;
+    }
+    int add(Symbol name) {
+        int slot = find(name);
+        if (slot >= 0) return slot;
+        slots.push_back(name);
+        index[name] = static_cast<int>(slots.size() - 1);
+        return static_cast<int>(slots.size() - 1);
+    }
+};
 
 class ASTVisitor {
 public:
@@ -26,6 +57,40 @@ public:
     virtual void visit(class YieldNode& node) = 0;
     virtual void visit(class InstanceNode& node) = 0;
     virtual void visit(class LetConstDeclNode& node) = 0;  // Added
+    virtual void visit(class ParallelForNode& node) = 0;
+    virtual void visit(class AccumulateNode& node) = 0;
+    virtual void visit(class FieldAccessNode& node) = 0;
+    virtual void visit(class FieldAssignmentNode& node) = 0;
+    virtual void visit(class ArrayLiteralNode& node) = 0;
+    virtual void visit(class IndexNode& node) = 0;
+    virtual void visit(class IndexAssignmentNode& node) = 0;
+    virtual void visit(class DictLiteralNode& node) = 0;
+    virtual void visit(class ImportNode& node) = 0;
+    virtual void visit(class InlinedCallNode& node) = 0;
+    virtual void visit(class ChooseNode& node) = 0;
+};
+
+// Type feedback on a node the interpreter quickens: Unseen until it first
+// runs, Quick while the specialized variant it rewrote itself into keeps
+// passing its guard, Generic for good once no variant fits or a guard fails.
+// Nodes are shared by every context running the program, so feedback is
+// written with atomics and only ever moves forward.
+enum class Feedback : uint8_t { Unseen, Quick, Generic };
+
+struct Builtin;
+struct Token;
+class FunctionNode;
+
+// A function body a lazy Parser only brace-matched: parse_body() parses,
+// resolves and type-checks it when the function is first called. Functions
+// may be shared by several contexts, so that happens once, under `mutex`.
+struct LazyBody {
+    std::shared_ptr<const std::vector<Token>> tokens;
+    size_t begin;              // First token after the '{'
+    size_t end;                // The matching '}'
+    const FrameLayout* fields; // The receiver's fields, for a method; else null
+    std::atomic<bool> parsed{false};
+    std::mutex mutex;
 };
 
 class ASTNode {
@@ -39,26 +104,31 @@ public:
 class ProgramNode : public ASTNode {
 public:
     std::vector<std::unique_ptr<ASTNode>> statements;
+    FrameLayout layout; // When run as a block; while bodies use the enclosing frame
     explicit ProgramNode(int l) : ASTNode(l) {}
     void accept(ASTVisitor& visitor) override { visitor.visit(*this); }
 };
 
-class BlueprintNode : public ASTNode {
-public:
-    std::string name;
-    std::vector<std::unique_ptr<ASTNode>> body;
-    bool is_abstract = false; // For future abstraction support
-    BlueprintNode(const std::string& n, int l) : ASTNode(l), name(n) {}
-    void accept(ASTVisitor& visitor) override { visitor.visit(*this); }
-};
-
 class VarDeclNode : public ASTNode {
 public:
     std::string type; // e.g., "integer", "var" (string), later "real", "truth"
-    std::string name;
+    Symbol name;
     std::unique_ptr<ASTNode> initializer;
     bool is_hidden = false; // For encapsulation (private)
-    VarDeclNode(const std::string& t, const std::string& n, int l) : ASTNode(l), type(t), name(n) {}
+    int slot = -1;          // Index in the enclosing frame, set by resolve_slots()
+    bool int_proven = false; // An integer whose initializer infer_types() proved int
+    VarDeclNode(const std::string& t, Symbol n, int l) : ASTNode(l), type(t), name(n) {}
+    void accept(ASTVisitor& visitor) override { visitor.visit(*this); }
+};
+
+class BlueprintNode : public ASTNode {
+public:
+    Symbol name;
+    std::vector<std::unique_ptr<VarDeclNode>> fields; // Declared fields, in layout order
+    FrameLayout field_layout;                         // Field name -> offset in every instance
+    std::vector<std::unique_ptr<ASTNode>> body;
+    bool is_abstract = false; // For future abstraction support
+    BlueprintNode(Symbol n, int l) : ASTNode(l), name(n) {}
     void accept(ASTVisitor& visitor) override { visitor.visit(*this); }
 };
 
@@ -66,9 +136,10 @@ public:
 class LetConstDeclNode : public ASTNode {
 public:
     bool is_const;
-    std::string name;
+    Symbol name;
     std::unique_ptr<ASTNode> initializer;
-    LetConstDeclNode(bool is_c, const std::string& n, int l) : ASTNode(l), is_const(is_c), name(n) {}
+    int slot = -1;
+    LetConstDeclNode(bool is_c, Symbol n, int l) : ASTNode(l), is_const(is_c), name(n) {}
     void accept(ASTVisitor& visitor) override { visitor.visit(*this); }
 };
 
@@ -81,11 +152,13 @@ public:
 
 class FunctionNode : public ASTNode {
 public:
-    std::string name;
-    std::vector<std::string> parameters; // Added: Parameter names (e.g., "name" in greet(name))
+    Symbol name;
+    std::vector<Symbol> parameters; // Added: Parameter names (e.g., "name" in greet(name))
     std::vector<std::unique_ptr<ASTNode>> body;
     bool is_hidden = false; // For encapsulation (private)
-    FunctionNode(const std::string& n, int l) : ASTNode(l), name(n) {}
+    FrameLayout layout;     // Parameters first, in order, then the body's locals
+    std::unique_ptr<LazyBody> lazy; // Set when the parser skipped the body
+    FunctionNode(Symbol n, int l) : ASTNode(l), name(n) {}
     void accept(ASTVisitor& visitor) override { visitor.visit(*this); }
 };
 
@@ -107,6 +180,29 @@ public:
     void accept(ASTVisitor& visitor) override { visitor.visit(*this); }
 };
 
+// parallel_repeat (i := start until end) accumulate total { ... }
+// Iterations run on the work-stealing pool, each in its own local scope.
+class ParallelForNode : public ASTNode {
+public:
+    Symbol counter;
+    std::unique_ptr<ASTNode> start;
+    std::unique_ptr<ASTNode> end;
+    Symbol accumulator = NO_SYMBOL; // When the loop has no accumulate clause
+    int accumulator_slot = -1;
+    std::unique_ptr<ProgramNode> body;
+    FrameLayout layout; // One iteration's frame; the counter is slot 0
+    explicit ParallelForNode(int l) : ASTNode(l) {}
+    void accept(ASTVisitor& visitor) override { visitor.visit(*this); }
+};
+
+// accumulate expr; -- adds into the enclosing parallel_repeat's accumulator
+class AccumulateNode : public ASTNode {
+public:
+    std::unique_ptr<ASTNode> expression;
+    explicit AccumulateNode(int l) : ASTNode(l) {}
+    void accept(ASTVisitor& visitor) override { visitor.visit(*this); }
+};
+
 class PrintNode : public ASTNode {
 public:
     std::unique_ptr<ASTNode> expression;
@@ -123,7 +219,15 @@ public:
 
 class BinaryOpNode : public ASTNode {
 public:
+    // Set by infer_types() when the operand types are proven, so the
+    // interpreter can skip its type checks; Generic otherwise.
+    enum class Kind { Generic, IntAdd, IntSub, IntMul, IntDiv, IntLessEqual, IntNotLess, IntGreater, IntEqual, Concat, StringEqual };
     std::string op;
+    Kind kind = Kind::Generic;
+    // Quickening of Generic nodes: the kernel the operands have called for,
+    // run while both still have the types it was chosen for.
+    std::atomic<Feedback> feedback{Feedback::Unseen};
+    std::atomic<Kind> quick{Kind::Generic};
     std::unique_ptr<ASTNode> left;
     std::unique_ptr<ASTNode> right;
     BinaryOpNode(const std::string& o, int l) : ASTNode(l), op(o) {}
@@ -132,8 +236,12 @@ public:
 
 class IdentifierNode : public ASTNode {
 public:
-    std::string name;
-    IdentifierNode(const std::string& n, int l) : ASTNode(l), name(n) {}
+    Symbol name;
+    int slot = -1;  // -1 when the name is never written in this frame
+    int field = -1; // Offset of a receiver field read by bare name inside a method
+    bool assigned = false; // The slot is written on every path here (infer_types()), so it is never unset
+    std::atomic<Feedback> feedback{Feedback::Unseen}; // Quick: reads the current frame's slot while it is set
+    IdentifierNode(Symbol n, int l) : ASTNode(l), name(n) {}
     void accept(ASTVisitor& visitor) override { visitor.visit(*this); }
 };
 
@@ -146,8 +254,9 @@ public:
 
 class StringNode : public ASTNode {
 public:
-    std::string value;
-    StringNode(const std::string& v, int l) : ASTNode(l), value(v) {}
+    Symbol value; // Interned literal text
+    StringNode(Symbol v, int l) : ASTNode(l), value(v) {}
+    const std::string& text() const { return symbol_name(value); }
     void accept(ASTVisitor& visitor) override { visitor.visit(*this); }
 };
 
@@ -161,26 +270,180 @@ public:
 
 class AssignmentNode : public ASTNode {
 public:
-    std::string name;
+    Symbol name;
     std::unique_ptr<ASTNode> value;
-    AssignmentNode(const std::string& n, int l) : ASTNode(l), name(n) {}
+    int slot = -1;
+    int field = -1;
+    AssignmentNode(Symbol n, int l) : ASTNode(l), name(n) {}
     void accept(ASTVisitor& visitor) override { visitor.visit(*this); }
 };
 
 class CallNode : public ASTNode {
 public:
-    std::string name;
+    Symbol receiver; // Instance for method calls (p in p.greet("Bob")), NO_SYMBOL for plain calls
+    Symbol name;
     std::vector<std::unique_ptr<ASTNode>> arguments; // Added: Argument expressions (e.g., "Bob" in p.greet("Bob"))
-    CallNode(const std::string& n, int l) : ASTNode(l), name(n) {}
+    int receiver_slot = -1;
+    // Quickening: the function, builtin or method (of blueprint `blueprint`)
+    // this site reached, valid while the context's definitions stamp equals
+    // `stamp`. STAMP_BUSY while a context is rewriting the cache.
+    static const uint64_t STAMP_BUSY = ~0ull;
+    std::atomic<Feedback> feedback{Feedback::Unseen};
+    std::atomic<uint64_t> stamp{0};
+    std::atomic<Symbol> blueprint{NO_SYMBOL};
+    std::atomic<FunctionNode*> target{nullptr};
+    std::atomic<const Builtin*> builtin{nullptr};
+    CallNode(Symbol r, Symbol n, int l) : ASTNode(l), receiver(r), name(n) {}
+    void accept(ASTVisitor& visitor) override { visitor.visit(*this); }
+};
+
+// obj.field -- `offset` is the field's offset in every blueprint declaring
+// it, or -1 when blueprints disagree; it is checked against the instance's
+// own layout before use.
+class FieldAccessNode : public ASTNode {
+public:
+    Symbol receiver;
+    Symbol field;
+    int receiver_slot = -1;
+    int offset = -1;
+    FieldAccessNode(Symbol r, Symbol f, int l) : ASTNode(l), receiver(r), field(f) {}
+    void accept(ASTVisitor& visitor) override { visitor.visit(*this); }
+};
+
+// obj.field := value;
+class FieldAssignmentNode : public ASTNode {
+public:
+    Symbol receiver;
+    Symbol field;
+    std::unique_ptr<ASTNode> value;
+    int receiver_slot = -1;
+    int offset = -1;
+    FieldAssignmentNode(Symbol r, Symbol f, int l) : ASTNode(l), receiver(r), field(f) {}
+    void accept(ASTVisitor& visitor) override { visitor.visit(*this); }
+};
+
+// [a, b, c]
+class ArrayLiteralNode : public ASTNode {
+public:
+    std::vector<std::unique_ptr<ASTNode>> elements;
+    explicit ArrayLiteralNode(int l) : ASTNode(l) {}
+    void accept(ASTVisitor& visitor) override { visitor.visit(*this); }
+};
+
+// {key: value, ...}
+class DictLiteralNode : public ASTNode {
+public:
+    std::vector<std::unique_ptr<ASTNode>> keys;
+    std::vector<std::unique_ptr<ASTNode>> values;
+    explicit DictLiteralNode(int l) : ASTNode(l) {}
+    void accept(ASTVisitor& visitor) override { visitor.visit(*this); }
+};
+
+// name[index] -- an array element or a dictionary entry
+class IndexNode : public ASTNode {
+public:
+    Symbol name;
+    std::unique_ptr<ASTNode> index;
+    int slot = -1;
+    IndexNode(Symbol n, int l) : ASTNode(l), name(n) {}
+    void accept(ASTVisitor& visitor) override { visitor.visit(*this); }
+};
+
+// name[index] := value; -- stores into the array, the variable is only read
+class IndexAssignmentNode : public ASTNode {
+public:
+    Symbol name;
+    std::unique_ptr<ASTNode> index;
+    std::unique_ptr<ASTNode> value;
+    int slot = -1;
+    IndexAssignmentNode(Symbol n, int l) : ASTNode(l), name(n) {}
     void accept(ASTVisitor& visitor) override { visitor.visit(*this); }
 };
 
 class InstanceNode : public ASTNode {
 public:
-    std::string blueprint_name;
-    std::string instance_name;
-    InstanceNode(const std::string& bn, const std::string& in, int l) : ASTNode(l), blueprint_name(bn), instance_name(in) {}
+    Symbol blueprint_name;
+    Symbol instance_name;
+    int slot = -1;
+    InstanceNode(Symbol bn, Symbol in, int l) : ASTNode(l), blueprint_name(bn), instance_name(in) {}
+    void accept(ASTVisitor& visitor) override { visitor.visit(*this); }
+};
+
+// A call replaced by the callee's body (see inline_calls()). `bindings`
+// are let declarations storing the arguments in renamed variables of the
+// caller's frame, in argument order; `result` is the callee's yielded
+// expression over them.
+class InlinedCallNode : public ASTNode {
+public:
+    Symbol receiver; // As in the CallNode it replaced; looked up first, as the call would
+    Symbol callee;
+    int receiver_slot = -1;
+    std::vector<std::unique_ptr<LetConstDeclNode>> bindings;
+    std::unique_ptr<ASTNode> result;
+    InlinedCallNode(Symbol r, Symbol c, int l) : ASTNode(l), receiver(r), callee(c) {}
+    void accept(ASTVisitor& visitor) override { visitor.visit(*this); }
+};
+
+// choose (subject) { when 1, 2 { ... } when "stop" { ... } otherwise { ... } }
+// Runs the first case with a label equal to the subject, else `otherwise`
+// when present. Labels are int or string constants and only match a
+// subject of the same type. build_dispatch() precomputes where each
+// subject goes: a table indexed by the value when the int labels are
+// dense, hash tables for sparse ints and for strings, so dispatch costs the
+// same however many cases there are.
+class ChooseNode : public ASTNode {
+public:
+    struct Label {
+        bool is_string;
+        int number;
+        Symbol text; // Interned, for a string label
+        int line;
+    };
+    static const int NO_CASE = -1;
+
+    std::unique_ptr<ASTNode> subject;
+    std::vector<std::vector<Label>> labels; // Per case
+    std::vector<std::unique_ptr<ProgramNode>> cases;
+    std::unique_ptr<ProgramNode> otherwise; // Null when absent
+    explicit ChooseNode(int l) : ASTNode(l) {}
     void accept(ASTVisitor& visitor) override { visitor.visit(*this); }
+
+    // Fills the tables from `labels`; throws on a label repeated across cases.
+    void build_dispatch();
+
+    // The case an int or string subject selects, or NO_CASE.
+    int find(int value) const {
+        if (!table.empty()) {
+            uint64_t i = static_cast<uint64_t>(static_cast<int64_t>(value) - table_base);
+            return i < table.size() ? table[i] : NO_CASE;
+        }
+        auto it = int_cases.find(value);
+        return it == int_cases.end() ? NO_CASE : it->second;
+    }
+    int find(const char* data, size_t length, Symbol interned) const;
+
+private:
+    struct StringCase {
+        uint64_t hash;
+        std::string text;
+        int target; // NO_CASE marks a free bucket
+    };
+    int64_t table_base = 0;
+    std::vector<int> table;                 // Case of subject table_base + i, when the int labels are dense
+    std::unordered_map<int, int> int_cases; // Otherwise
+    std::vector<StringCase> string_cases;   // Open addressing, power-of-two size
 };
 
-#endif
\ No newline at end of file
+// import "path"; -- top level only. The module loader reads these before
+// anything runs; executing one does nothing.
+class ImportNode : public ASTNode {
+public:
+    std::string path; // As written, relative to the importing file's directory
+    ImportNode(const std::string& p, int l) : ASTNode(l), path(p) {}
+    void accept(ASTVisitor& visitor) override { visitor.visit(*this); }
+};
+
+// One-line description of a node, e.g. While("") or Identifier("x").
+std::string to_string(const ASTNode& node);
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <string>
+#include <vector>
+
+struct BatchOptions {
+    std::string target;       // A directory of .as files, or a single .as file
+    int copies = 1;           // How many times each script is executed
+    unsigned threads = 0;     // 0 = one per hardware thread
+    bool scaling = false;     // Repeat the batch at 1, 2, 4, ... threads
+    bool show_output = false; // Dump every job's buffered output afterwards
+    bool inline_small = true; // Off with --no-inline
+};
+
+// The .as files of a directory in name order, or just `target` if it is a file.
+std::vector<std::string> collect_scripts(const std::string& target);
+
+// Runs every job of the batch on a fixed thread pool, each job in its own
+// ExecutionContext with a private output buffer. Returns a process exit code.
+int run_batch(const BatchOptions& options);
+
+#endif
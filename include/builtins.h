@@ -0,0 +1,16 @@
+#ifndef BUILTINS_H
+#define BUILTINS_H
+
+#include "interpreter.h"
+
+// A native function callable from scripts by plain name. Script functions
+// of the same name take precedence. Builtins take at most three arguments.
+struct Builtin {
+    const char* name;
+    size_t arity;
+    Value (*call)(Value* args, int line);
+};
+
+const Builtin* find_builtin(Symbol name);
+
+#endif
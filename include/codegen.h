@@ -0,0 +1,51 @@
+#ifndef CODEGEN_H
+#define CODEGEN_H
+
+#include "interpreter.h"
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+// A second execution engine next to InterpreterVisitor. Every node is
+// converted once into a closure with its operands, resolved slot, operator
+// kernel and lookup strategy already bound, so running a program is a
+// chain of direct closure calls: no visitor double dispatch, no operator
+// strings compared, no choice between slot and by-name reads at run time.
+// Function bodies compile on their first call and call sites cache the
+// function or method they reached last.
+//
+// Nodes without a compiled form (blueprint and instance declarations,
+// arrays and dictionaries, parallel_repeat, input, imports) are run by an
+// InterpreterVisitor on the same context, so both engines give the same
+// results on every program. Profiling is only done by InterpreterVisitor.
+class ClosureEngine {
+public:
+    explicit ClosureEngine(ExecutionContext& context);
+    ~ClosureEngine();
+
+    void run(ProgramNode& program);       // As program.accept(InterpreterVisitor)
+    void run_module(ProgramNode& module); // As InterpreterVisitor::run_module()
+
+    typedef std::function<Value()> Expr;
+    typedef std::function<void()> Stmt;
+    struct Code {
+        std::vector<Stmt> stmts;
+        std::vector<int> lines; // Source line of each statement
+    };
+
+private:
+    class Compiler;
+
+    ExecutionContext& ctx;
+    InterpreterVisitor interpreter;
+    std::unordered_map<const FunctionNode*, std::unique_ptr<Code>> bodies;
+
+    Expr expression(ASTNode& node);
+    Code statements(const std::vector<std::unique_ptr<ASTNode>>& nodes);
+    const Code& body(FunctionNode& function);
+    void execute(const Code& code);
+    Value call(FunctionNode& function, const Code& code, const std::vector<Expr>& arguments, int line, Instance* self);
+};
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef FILES_H
+#define FILES_H
+
+#include "interpreter.h"
+#include <cstdio>
+#include <memory>
+#include <string>
+
+// Reads a text file one line at a time through large chunk buffers. Lines
+// are handed out as string slices of the current chunk rather than copies;
+// a chunk is refilled in place once no line still points into it, or else
+// swapped with a spare, so memory stays at about two chunks regardless of
+// file size. Values that are stored away copy their slice (Value::own_text).
+// A reader is shared, not copied, so it must not be read from parallel workers.
+class LineReader : public Object {
+public:
+    static const size_t CHUNK_SIZE = size_t(1) << 20;
+
+    static LineReader* open(const std::string& path); // nullptr if the file cannot be opened
+    ~LineReader();
+
+    bool has_line();  // Reads ahead as needed
+    Value next_line(); // Without its '\n' (or "\r\n"); call only after has_line()
+
+private:
+    explicit LineReader(std::FILE* file) : file(file) {}
+    void refill();
+
+    static const size_t NO_LINE = static_cast<size_t>(-1);
+
+    std::FILE* file;
+    std::shared_ptr<StringBuffer> chunk;
+    std::shared_ptr<StringBuffer> spare;
+    size_t pos = 0;          // Start of the next line in chunk
+    size_t end = 0;          // End of the bytes read into chunk
+    size_t line_end = NO_LINE; // Found by has_line() for next_line()
+    bool eof = false;
+};
+
+#endif
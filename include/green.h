@@ -0,0 +1,117 @@
+#ifndef GREEN_H
+#define GREEN_H
+
+#include "interpreter.h"
+#include "program.h"
+#include <deque>
+#include <functional>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <ucontext.h>
+#endif
+
+class GreenScheduler;
+
+// One script execution running on its own small stack. The task gives up
+// the thread at loop back-edges and call boundaries once its time slice is
+// spent, and whenever it needs input that has not arrived yet.
+class GreenTask : public YieldPoints {
+public:
+    enum class State { Ready, WaitingInput, Done };
+
+    GreenTask(GreenScheduler& owner, int id, std::shared_ptr<const Program> program);
+    ~GreenTask();
+
+    void safepoint() override;
+    void wait_for_input() override;
+
+    int id;
+    State state = State::Ready;
+    std::shared_ptr<const Program> program;
+    std::ostringstream out;
+    std::stringstream in;     // Lines handed to the script, one at a time
+    std::string inbox;        // Input fed to the task but not yet consumed
+    bool input_closed = false;
+    std::string error;
+    size_t stack_high_water = 0; // Deepest stack use seen at a yield point, in bytes
+    unsigned long switches = 0;
+
+private:
+    friend class GreenScheduler;
+    GreenScheduler& scheduler;
+    ExecutionContext context;
+    unsigned slice_left = 0;
+    char* stack = nullptr;
+    size_t stack_size = 0;
+    uintptr_t stack_floor = 0; // StackGuard::floor while the task runs
+    HeapBudget* heap_budget = nullptr; // HeapQuota::current while the task runs
+#ifdef _WIN32
+    LPVOID fiber = nullptr;
+#else
+    ucontext_t uctx;
+#endif
+
+    bool input_ready() const;
+    void suspend(State next);
+    void note_stack_depth();
+    static void entry();
+#ifdef _WIN32
+    static void CALLBACK fiber_entry(LPVOID);
+#endif
+};
+
+// Single-threaded round-robin scheduler multiplexing many GreenTasks.
+class GreenScheduler {
+public:
+    explicit GreenScheduler(size_t stack_size = 4096 * 1024, unsigned slice = 1000);
+    ~GreenScheduler();
+
+    GreenTask& spawn(std::shared_ptr<const Program> program);
+    void feed(GreenTask& task, const std::string& text);
+    void close_input(GreenTask& task);
+
+    // Runs until every task is done. `poll` is called once per scheduling
+    // round and may feed or close task input; it returns false once it has
+    // nothing more to deliver.
+    void run(const std::function<bool()>& poll = std::function<bool()>());
+
+    const std::vector<std::unique_ptr<GreenTask>>& tasks() const { return all; }
+    size_t stack_size() const { return stack_bytes; }
+    unsigned long rounds = 0;
+
+private:
+    friend class GreenTask;
+    std::vector<std::unique_ptr<GreenTask>> all;
+    size_t stack_bytes;
+    unsigned slice_steps;
+    GreenTask* current = nullptr;
+#ifdef _WIN32
+    LPVOID main_fiber = nullptr;
+#else
+    ucontext_t main_uctx;
+#endif
+
+    void resume(GreenTask& task);
+    void release_stack(GreenTask& task);
+};
+
+struct GreenOptions {
+    std::string target;       // A directory of .as files, or a single .as file
+    int copies = 1;
+    unsigned slice = 1000;    // Yield points per time slice
+    size_t stack_kb = 4096;   // Reserved per task; pages are only touched as the task recurses
+    bool show_output = false;
+    bool inline_small = true; // Off with --no-inline
+};
+
+// Runs a batch of scripts as green tasks on the calling thread. A script's
+// `<name>.in` file, if present, is delivered one line per scheduling round.
+int run_green(const GreenOptions& options);
+
+#endif
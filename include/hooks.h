@@ -0,0 +1,100 @@
+#ifndef HOOKS_H
+#define HOOKS_H
+
+#include "interpreter.h"
+#include <iostream>
+#include <map>
+#include <set>
+#include <string>
+#include <typeindex>
+#include <unordered_map>
+
+// Instrumented hook policies for BasicInterpreter; the production policy,
+// NoHooks, is in interpreter.h. Each policy is its own instantiation of the
+// interpreter, picked at startup with --hooks, so instrumentation costs the
+// default interpreter nothing.
+
+// Prints every node visit, call and allocation, indented by nesting.
+class TraceHooks {
+public:
+    static const bool enabled = true;
+    explicit TraceHooks(std::ostream& out = std::cerr) : out(&out) {}
+
+    void before(ASTNode& node, ExecutionContext& ctx);
+    void after(ASTNode&, ExecutionContext&) { --depth; }
+    void call(Symbol name, int line, ExecutionContext& ctx);
+    void returned(Symbol name, ExecutionContext& ctx);
+    void allocate(Value::Type type, size_t bytes, int line);
+
+private:
+    std::ostream* out;
+    int depth = 0;
+};
+
+// Counts node visits by kind, calls by name, and allocations by type.
+class CountHooks {
+public:
+    static const bool enabled = true;
+
+    void before(ASTNode& node, ExecutionContext&) {
+        Visits& visits = by_kind[std::type_index(typeid(node))];
+        if (!visits.count++) visits.sample = &node;
+    }
+    void after(ASTNode&, ExecutionContext&) {}
+    void call(Symbol name, int, ExecutionContext&) { ++calls[name]; }
+    void returned(Symbol, ExecutionContext&) {}
+    void allocate(Value::Type type, size_t bytes, int) {
+        Allocations& allocations = by_type[static_cast<int>(type)];
+        ++allocations.count;
+        allocations.bytes += bytes;
+    }
+
+    // One JSON object: {"visits":{...},"calls":{...},"allocations":{...}}.
+    void write_report(std::ostream& out) const;
+
+private:
+    struct Visits {
+        long count = 0;
+        const ASTNode* sample = nullptr; // Names the kind in the report
+    };
+    struct Allocations {
+        long count = 0;
+        long long bytes = 0;
+    };
+    std::unordered_map<std::type_index, Visits> by_kind;
+    std::unordered_map<Symbol, long> calls;
+    std::map<int, Allocations> by_type;
+};
+
+// Stops before the first node of every visit to a breakpoint line, shows
+// the innermost frame's variables and reads commands: empty or `c` to
+// continue, `s` to stop again at the next line, `p NAME` to print a
+// variable, `q` to end the script. End of input continues.
+class BreakpointHooks {
+public:
+    static const bool enabled = true;
+    explicit BreakpointHooks(std::set<int> lines = std::set<int>(), std::istream& commands = std::cin,
+                             std::ostream& out = std::cerr)
+        : lines(lines), commands(&commands), out(&out) {}
+
+    void before(ASTNode& node, ExecutionContext& ctx) {
+        if (node.line == current_line) return;
+        current_line = node.line;
+        if (stepping || lines.count(node.line)) stop(node.line, ctx);
+    }
+    void after(ASTNode&, ExecutionContext&) {}
+    void call(Symbol, int, ExecutionContext&) {}
+    void returned(Symbol, ExecutionContext&) {}
+    void allocate(Value::Type, size_t, int) {}
+
+private:
+    std::set<int> lines;
+    std::istream* commands;
+    std::ostream* out;
+    int current_line = 0;
+    bool stepping = false;
+
+    void stop(int line, ExecutionContext& ctx);
+};
+
+#endif
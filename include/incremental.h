@@ -0,0 +1,59 @@
+#ifndef INCREMENTAL_H
+#define INCREMENTAL_H
+
+#include "ast.h"
+#include "lexer.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+// Replaces `removed` bytes at `offset` with `inserted`.
+struct TextEdit {
+    size_t offset;
+    size_t removed;
+    std::string inserted;
+};
+
+// A source file kept lexed and parsed across edits, for editors and watch
+// loops. An edit is relexed from the end of the last token before it until
+// the new tokens line up with the old stream again; then only the top-level
+// statements that read a changed token are reparsed, and every other
+// statement keeps its AST. A syntax error drops just its own statement:
+// program() holds the statements that parse and errors() the rest.
+class Document {
+public:
+    explicit Document(std::string text);
+
+    void apply(const TextEdit& edit);
+
+    const std::string& source() const { return text; }
+    const std::vector<Token>& tokens() const { return toks; }
+    ProgramNode& program() { return *root; } // Run resolve_slots() on it before executing
+    std::vector<std::string> errors() const;
+
+    // What the last apply() redid and what it kept.
+    struct EditStats {
+        size_t tokens_relexed = 0;
+        size_t statements_reparsed = 0;
+        size_t statements_reused = 0;
+    };
+    const EditStats& last_edit() const { return stats; }
+
+private:
+    struct Statement {
+        size_t first; // Token range [first, end); the parser may also look at token `end`
+        size_t end;
+        ASTNode* node; // Owned by root->statements; null when the statement has a syntax error
+        std::string error;
+    };
+
+    std::string text;
+    std::vector<Token> toks;
+    std::vector<Statement> statements;
+    std::unique_ptr<ProgramNode> root;
+    EditStats stats;
+
+    void splice_tokens(size_t first, size_t old_end, std::vector<Token>& fresh, long delta, int line_delta);
+};
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef INLINER_H
+#define INLINER_H
+
+#include "ast.h"
+#include <vector>
+
+// One call site that inline_calls() replaced with its callee's body.
+struct InlinedSite {
+    int line;
+    Symbol receiver; // NO_SYMBOL for a plain call
+    Symbol callee;
+    int size;        // Nodes in the substituted expression
+};
+
+// Largest callee expression, in nodes, that inline_calls() substitutes.
+const int INLINE_BUDGET = 16;
+
+// Replaces calls to small functions and statically resolvable methods with
+// InlinedCallNodes holding the callee's body, so those calls push no frame
+// and copy nothing but their arguments.
+//
+// A callee qualifies when its body is a single `yield` of at most
+// INLINE_BUDGET literal, operator, variable and field-access nodes that
+// reads nothing but its parameters and, for a method, the receiver's
+// fields: scoping is dynamic, so any other name could mean something
+// different at the call site. Such a body calls nothing, so it is never
+// recursive. A plain function must be defined once, at the top level, before
+// the call. A method must belong to the only blueprint of that name, and
+// the receiver must be an instance that is declared once and never
+// reassigned.
+//
+// Parameters are renamed apart for every site and bound to the arguments,
+// in order, in the caller's frame. Runs before resolve_slots(), and only on
+// a program with no imports, since a module could redefine any name.
+std::vector<InlinedSite> inline_calls(ProgramNode& program);
+
+#endif
@@ -2,71 +2,701 @@
 #define INTERPRETER_H
 
 #include "ast.h"
+#include "memory_report.h"
 #include <string>
 #include <vector>
 #include <unordered_map>
+#include <unordered_set>
 #include <memory>
+#include <stdexcept>
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <new>
+#include <utility>
 
-struct Value {
-    enum class Type { None, Int, String, Instance } type;
-    int int_val;
-    std::string str_val;
-    std::unique_ptr<std::unordered_map<std::string, Value>> instance_fields;
-    std::string blueprint_name;
-
-    Value() : type(Type::None), int_val(0), instance_fields(nullptr) {}
-    explicit Value(int v) : type(Type::Int), int_val(v), instance_fields(nullptr) {}
-    explicit Value(const std::string& v) : type(Type::String), str_val(v), instance_fields(nullptr) {}
-    Value(const std::string& bn, const std::unordered_map<std::string, Value>& fields)
-        : type(Type::Instance), blueprint_name(bn), instance_fields(new std::unordered_map<std::string, Value>(fields)) {}
-    Value(const Value& other) 
-        : type(other.type), int_val(other.int_val), str_val(other.str_val), blueprint_name(other.blueprint_name) {
-        if (other.instance_fields) {
-            instance_fields.reset(new std::unordered_map<std::string, Value>(*other.instance_fields));
-        } else {
-            instance_fields = nullptr;
+// The heap limit of one script run. Every thread working for the run, such
+// as parallel_repeat workers, charges the same budget, and each allocation
+// is released to the budget it was charged to, whichever thread frees it.
+struct HeapBudget {
+    std::atomic<long long> live{0};
+    long long limit = 0;
+};
+
+// Charges string buffers, instances, arrays and dictionaries to the budget
+// current on the allocating thread, checked on every allocation against
+// its limit (see ExecutionLimits). Nothing is counted without a limit.
+struct HeapQuota {
+    struct Exceeded : std::runtime_error {
+        explicit Exceeded(long long limit)
+            : std::runtime_error("Memory limit of " + std::to_string(limit) + " bytes exceeded") {}
+    };
+
+    static thread_local HeapBudget* current; // Null when no limit applies
+
+    static void charge(HeapBudget* budget, long long bytes) {
+        if (!budget) return;
+        long long live = budget->live.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+        if (bytes > 0 && live > budget->limit) {
+            budget->live.fetch_sub(bytes, std::memory_order_relaxed);
+            throw Exceeded(budget->limit);
+        }
+    }
+    static void release(HeapBudget* budget, long long bytes) {
+        if (budget) budget->live.fetch_sub(bytes, std::memory_order_relaxed);
+    }
+
+    // Makes `budget` current on this thread for its lifetime; null keeps the enclosing one.
+    class Scope {
+    public:
+        explicit Scope(HeapBudget* budget) : saved(current) {
+            if (budget) current = budget;
         }
+        ~Scope() { current = saved; }
+    private:
+        HeapBudget* saved;
+    };
+};
+
+// Bytes one string buffer, array or dictionary has charged, and the budget
+// they were charged to, which they go back to when it is freed. A holder
+// that has nothing charged takes the current budget when it next grows.
+struct HeapCharge {
+    HeapBudget* budget = nullptr;
+    size_t bytes = 0;
+
+    HeapCharge() {}
+    HeapCharge(const HeapCharge&) = delete;
+    HeapCharge& operator=(const HeapCharge&) = delete;
+    ~HeapCharge() { HeapQuota::release(budget, static_cast<long long>(bytes)); }
+
+    // Charges or releases the difference to `total` bytes.
+    void update(size_t total) {
+        if (total == bytes) return;
+        if (bytes == 0) budget = HeapQuota::current;
+        HeapQuota::charge(budget, static_cast<long long>(total) - static_cast<long long>(bytes));
+        bytes = total;
+    }
+};
+
+// Lowest native stack address a script call may start below, on this
+// thread, so that runaway recursion stops with an error instead of
+// overflowing the stack. It is read from the thread's own stack on first
+// use; a green task sets it to its own stack while it runs.
+struct StackGuard {
+    static const size_t RESERVE = 64 * 1024; // Kept free below the last call for builtins, output and unwinding
+
+    static thread_local uintptr_t floor; // 0 until known
+
+    static bool exhausted() {
+        char marker;
+        if (!floor) floor = thread_floor();
+        return reinterpret_cast<uintptr_t>(&marker) < floor;
+    }
+    // Floor for a stack of `size` bytes starting at `bottom`; small stacks keep a quarter free.
+    static uintptr_t floor_for(const char* bottom, size_t size) {
+        return reinterpret_cast<uintptr_t>(bottom) + std::min<size_t>(RESERVE, size / 4);
+    }
+
+private:
+    static uintptr_t thread_floor();
+};
+
+// Backing store for string values. Several values may share one buffer,
+// each seeing its own slice of it (usually a prefix; lines read from a file
+// are slices of the reader's chunk). A value whose slice ends at the end of
+// the buffer may append in place: every other holder keeps seeing the same
+// (shorter) slice, so `s := s + x` grows one buffer instead of copying it.
+struct StringBuffer {
+    std::string data;
+    HeapCharge charged; // data's capacity
+
+    StringBuffer() {}
+    explicit StringBuffer(const std::string& text) : data(text) { account(); }
+
+    // Counts data's capacity after it was allocated or grew. Buffers never
+    // accounted, such as a file reader's chunks, stay uncounted.
+    void account() {
+        if (data.capacity() == charged.bytes) return;
+        charged.update(data.capacity());
+        if (MemoryReport::enabled) MemoryReport::record(MemoryCategory::Strings, charged.bytes);
+    }
+};
+
+struct Value;
+
+// One blueprint instance: a fixed header followed directly by its field
+// values, packed in the order of the blueprint's field layout, all in a
+// single allocation.
+struct Instance {
+    Symbol blueprint;          // Qualified blueprint name
+    uint32_t count;            // Number of fields
+    const FrameLayout* layout; // The blueprint's field layout, for access by name
+    HeapBudget* budget;        // Charged for this instance's memory
+
+    Value* fields() { return reinterpret_cast<Value*>(this + 1); }
+    const Value* fields() const { return reinterpret_cast<const Value*>(this + 1); }
+
+    static Instance* create(Symbol blueprint, const FrameLayout& layout);
+    static Instance* clone(const Instance& other);
+    static void destroy(Instance* instance);
+};
+
+struct InstanceDeleter {
+    void operator()(Instance* instance) const { Instance::destroy(instance); }
+};
+
+// Reference-counted storage behind array and dictionary values.
+struct Object {
+    std::atomic<long> refs;
+    Object() : refs(0) {}
+    Object(const Object&) : refs(0) {}
+    virtual ~Object() {}
+
+    // Deletes an object whose last reference is gone. Objects released while
+    // another one is being deleted wait in a queue instead, so freeing a
+    // deeply nested array or dictionary does not recurse once per level.
+    static void release(Object* object);
+};
+
+struct Array;
+struct Dict;
+
+// Counted reference to an Object. Arrays and dictionaries are shared, not
+// copied, when a value is copied: `let b := a;` makes b another name for a.
+class ObjectRef {
+public:
+    ObjectRef() : ptr(nullptr) {}
+    explicit ObjectRef(Object* object) : ptr(object) {
+        if (ptr) ptr->refs.fetch_add(1, std::memory_order_relaxed);
     }
+    ObjectRef(const ObjectRef& other) : ptr(other.ptr) {
+        if (ptr) ptr->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+    ObjectRef(ObjectRef&& other) noexcept : ptr(other.ptr) { other.ptr = nullptr; }
+    ObjectRef& operator=(ObjectRef other) noexcept {
+        std::swap(ptr, other.ptr);
+        return *this;
+    }
+    ~ObjectRef() {
+        if (ptr && ptr->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) Object::release(ptr);
+    }
+
+    Object* get() const { return ptr; }
+    explicit operator bool() const { return ptr != nullptr; }
+
+private:
+    Object* ptr;
+};
+
+struct Value {
+    enum class Type { None, Int, String, Instance, Array, Dict, File, Unset } type; // Unset: a stack slot not yet written
+    int int_val; // For strings, the Symbol of the text when it is interned (literals), else NO_SYMBOL
+    std::shared_ptr<StringBuffer> str_buf;
+    size_t str_off; // Start of this string's slice of str_buf
+    size_t str_len;
+    std::unique_ptr<Instance, InstanceDeleter> instance; // Instances are values: copies are deep
+    ObjectRef object; // Array, Dict or LineReader storage
+
+    Value() : type(Type::None), int_val(0), str_off(0), str_len(0) {}
+    explicit Value(int v) : type(Type::Int), int_val(v), str_off(0), str_len(0) {}
+    explicit Value(const std::string& v)
+        : type(Type::String), int_val(0), str_buf(new StringBuffer{v}), str_off(0), str_len(v.size()) {}
+    explicit Value(Instance* object) : type(Type::Instance), int_val(0), str_off(0), str_len(0), instance(object) {}
+    explicit Value(Array* elements);
+    explicit Value(Dict* entries);
+    Value(const Value& other) 
+        : type(other.type), int_val(other.int_val), str_buf(other.str_buf), str_off(other.str_off), str_len(other.str_len),
+          instance(other.instance ? Instance::clone(*other.instance) : nullptr), object(other.object) {}
+    Value(Value&& other) noexcept
+        : type(other.type), int_val(other.int_val), str_buf(std::move(other.str_buf)), str_off(other.str_off),
+          str_len(other.str_len),
+          instance(std::move(other.instance)), object(std::move(other.object)) {}
     Value& operator=(const Value& other) {
         if (this != &other) {
             type = other.type;
             int_val = other.int_val;
-            str_val = other.str_val;
-            blueprint_name = other.blueprint_name;
-            if (other.instance_fields) {
-                instance_fields.reset(new std::unordered_map<std::string, Value>(*other.instance_fields));
-            } else {
-                instance_fields.reset();
-            }
+            str_buf = other.str_buf;
+            str_off = other.str_off;
+            str_len = other.str_len;
+            instance.reset(other.instance ? Instance::clone(*other.instance) : nullptr);
+            object = other.object;
         }
         return *this;
     }
+    Value& operator=(Value&& other) noexcept {
+        type = other.type;
+        int_val = other.int_val;
+        str_buf = std::move(other.str_buf);
+        str_off = other.str_off;
+        str_len = other.str_len;
+        instance = std::move(other.instance);
+        object = std::move(other.object);
+        return *this;
+    }
     ~Value() = default;
 
-    std::string as_string() const {
-        if (type == Type::Int) return std::to_string(int_val);
-        if (type == Type::String) return str_val;
-        return "";
+    static Value unset() {
+        Value v;
+        v.type = Type::Unset;
+        return v;
+    }
+
+    const char* str_data() const { return str_buf ? str_buf->data.data() + str_off : ""; }
+    Array& array() const;
+    Dict& dict() const;
+
+    // `left + right` with string semantics; appends in place when `left` owns
+    // the end of its buffer, otherwise starts a new buffer with headroom.
+    static Value concat(const Value& left, const Value& right) {
+        std::string number;
+        const char* data;
+        size_t n;
+        if (right.type == Type::String) {
+            data = right.str_data();
+            n = right.str_len;
+        } else {
+            number = right.as_string();
+            data = number.data();
+            n = number.size();
+        }
+        Value result;
+        result.type = Type::String;
+        if (left.type == Type::String && left.str_buf && left.str_off + left.str_len == left.str_buf->data.size() &&
+            left.str_buf != right.str_buf) {
+            result.str_buf = left.str_buf;
+            result.str_off = left.str_off;
+        } else {
+            std::string prefix = left.as_string();
+            result.str_buf.reset(new StringBuffer());
+            result.str_buf->data.reserve(2 * (prefix.size() + n));
+            result.str_buf->data = prefix;
+        }
+        result.str_buf->data.append(data, n);
+        result.str_buf->account();
+        result.str_len = result.str_buf->data.size() - result.str_off;
+        return result;
+    }
+
+    // Copies a string that is a small slice of a much larger buffer, so that
+    // storing it somewhere long-lived does not keep the whole buffer alive.
+    void own_text() {
+        if (type == Type::String && str_buf && str_buf->data.size() > 2 * str_len + 64) {
+            str_buf.reset(new StringBuffer{std::string(str_data(), str_len)});
+            str_off = 0;
+        }
     }
-    int as_int() const { return type == Type::Int ? int_val : std::stoi(str_val); }
+
+    // Gives this value (and any instance fields) private string buffers,
+    // arrays and dictionaries, so it can be handed to another thread
+    // without sharing them.
+    void detach();
+
+    std::string as_string() const;
+    int as_int() const { return type == Type::Int ? int_val : std::stoi(as_string()); }
+
+    // Whether `target` is this value's array or dictionary, or can be reached
+    // from it through elements, dictionary values and instance fields.
+    // Storing such a value into `target` would make a reference cycle.
+    bool reaches(const Object* target) const;
 };
 
-class InterpreterVisitor : public ASTVisitor {
+// Contiguous array storage. While every element is an int the elements stay
+// unboxed in `ints`; storing anything else moves them all to `boxed`.
+struct Array : Object {
+    std::vector<int> ints;
+    std::vector<Value> boxed;
+    bool is_boxed;
+    HeapCharge charged; // Element capacity
+
+    Array() : is_boxed(false) {}
+
+    size_t size() const { return is_boxed ? boxed.size() : ints.size(); }
+    Value get(size_t i) const { return is_boxed ? boxed[i] : Value(ints[i]); }
+    void set(size_t i, Value value) {
+        if (!is_boxed && value.type == Value::Type::Int) {
+            ints[i] = value.int_val;
+            return;
+        }
+        box();
+        value.own_text();
+        boxed[i] = std::move(value);
+    }
+    void push(Value value) {
+        if (!is_boxed && value.type == Value::Type::Int) {
+            bool grows = ints.size() == ints.capacity();
+            ints.push_back(value.int_val);
+            if (grows) account();
+            return;
+        }
+        box();
+        value.own_text();
+        bool grows = boxed.size() == boxed.capacity();
+        boxed.push_back(std::move(value));
+        if (grows) account();
+    }
+    void box() {
+        if (is_boxed) return;
+        boxed.reserve(ints.size());
+        for (int v : ints) boxed.push_back(Value(v));
+        std::vector<int>().swap(ints);
+        is_boxed = true;
+        account();
+    }
+    // Makes room for n elements, charging for it before it is allocated so
+    // that an oversized request fails on the heap limit.
+    void reserve(size_t n) {
+        size_t bytes = n * (is_boxed ? sizeof(Value) : sizeof(int));
+        if (bytes > charged.bytes) charged.update(bytes);
+        if (is_boxed) {
+            boxed.reserve(n);
+        } else {
+            ints.reserve(n);
+        }
+        account();
+    }
+    // Counts the element capacity after it grew or shrank.
+    void account() {
+        charged.update(ints.capacity() * sizeof(int) + boxed.capacity() * sizeof(Value));
+    }
+};
+
+// Hash table keyed by ints and strings, with open addressing and Robin Hood
+// probing. A bucket is only a 32-bit hash and an entry index, so a probe
+// walks a few contiguous 8-byte buckets and compares hashes before keys.
+// Entries are stored densely in insertion order, which is also iteration
+// order; deleted entries stay behind as unset keys until the next rehash.
+struct Dict : Object {
+    struct Entry {
+        Value key;
+        Value value;
+        uint32_t hash;
+    };
+    struct Bucket {
+        uint32_t hash;
+        uint32_t entry; // EMPTY when the bucket is free
+    };
+    static const uint32_t EMPTY = 0xffffffffu;
+
+    std::vector<Entry> entries;
+    std::vector<Bucket> buckets; // Power-of-two size
+    size_t live = 0;
+    HeapCharge charged; // Entry and bucket capacity
+
+    Dict() {}
+    Dict(const Dict& other) : Object(other), entries(other.entries), buckets(other.buckets), live(other.live) { account(); }
+
+    static bool valid_key(const Value& key) { return key.type == Value::Type::Int || key.type == Value::Type::String; }
+    static uint32_t hash_key(const Value& key);
+
+    size_t size() const { return live; }
+    Value* find(const Value& key);
+    Value& insert(const Value& key); // Slot for key's value; a new key starts as None
+    bool erase(const Value& key);
+
+private:
+    void account();
+    size_t find_bucket(const Value& key, uint32_t hash) const;
+    void place(Bucket bucket);
+    void rehash(size_t capacity);
+};
+
+inline Value::Value(Array* elements) : type(Type::Array), int_val(0), str_off(0), str_len(0), object(elements) {}
+inline Value::Value(Dict* entries) : type(Type::Dict), int_val(0), str_off(0), str_len(0), object(entries) {}
+inline Array& Value::array() const { return static_cast<Array&>(*object.get()); }
+inline Dict& Value::dict() const { return static_cast<Dict&>(*object.get()); }
+
+// Values still to detach wait on an explicit list, so deeply nested arrays
+// and dictionaries do not recurse once per level.
+inline void Value::detach() {
+    std::vector<Value*> pending{this};
+    while (!pending.empty()) {
+        Value& value = *pending.back();
+        pending.pop_back();
+        if (value.type == Type::String && value.str_buf) {
+            value.str_buf.reset(new StringBuffer{value.as_string()});
+            value.str_off = 0;
+        }
+        if (value.instance) {
+            for (uint32_t i = 0; i < value.instance->count; ++i) pending.push_back(&value.instance->fields()[i]);
+        }
+        if (value.type == Type::Array) {
+            Array* copy = new Array();
+            ObjectRef owner(copy);
+            copy->ints = value.array().ints;
+            copy->boxed = value.array().boxed;
+            copy->is_boxed = value.array().is_boxed;
+            copy->account();
+            value.object = std::move(owner);
+            for (auto& element : copy->boxed) pending.push_back(&element);
+        } else if (value.type == Type::Dict) {
+            Dict* copy = new Dict(value.dict());
+            value.object = ObjectRef(copy);
+            for (auto& entry : copy->entries) {
+                pending.push_back(&entry.key);
+                pending.push_back(&entry.value);
+            }
+        }
+    }
+}
+
+// Arrays and dictionaries are written with an explicit stack of the ones
+// still open, so printing deeply nested ones does not recurse per level.
+inline std::string Value::as_string() const {
+    if (type == Type::Int) return std::to_string(int_val);
+    if (type == Type::String) return std::string(str_data(), str_len);
+    if (type == Type::File) return "<file>";
+    if (type != Type::Array && type != Type::Dict) return "";
+    struct Open {
+        const Value* container;
+        size_t next;  // Element or entry to write next
+        bool written; // Whether a dictionary entry was written yet
+    };
+    std::vector<Open> open;
+    std::string text;
+    const Value* value = this;
+    for (;;) {
+        if (value) {
+            if (value->type == Type::Array || value->type == Type::Dict) {
+                text += value->type == Type::Array ? '[' : '{';
+                open.push_back(Open{value, 0, false});
+            } else {
+                text += value->as_string();
+            }
+            value = nullptr;
+        }
+        if (open.empty()) return text;
+        Open& top = open.back();
+        if (top.container->type == Type::Array) {
+            const Array& array = top.container->array();
+            if (top.next == array.size()) {
+                text += ']';
+                open.pop_back();
+                continue;
+            }
+            if (top.next) text += ", ";
+            size_t i = top.next++;
+            if (array.is_boxed) {
+                value = &array.boxed[i];
+            } else {
+                text += std::to_string(array.ints[i]);
+            }
+        } else {
+            const Dict& dict = top.container->dict();
+            while (top.next < dict.entries.size() && dict.entries[top.next].key.type == Type::Unset) ++top.next;
+            if (top.next == dict.entries.size()) {
+                text += '}';
+                open.pop_back();
+                continue;
+            }
+            if (top.written) text += ", ";
+            top.written = true;
+            const Dict::Entry& entry = dict.entries[top.next++];
+            text += entry.key.as_string() + ": ";
+            value = &entry.value;
+        }
+    }
+}
+
+inline bool Value::reaches(const Object* target) const {
+    std::vector<const Value*> pending{this};
+    std::unordered_set<const Object*> seen;
+    while (!pending.empty()) {
+        const Value* value = pending.back();
+        pending.pop_back();
+        if (value->instance) {
+            for (uint32_t i = 0; i < value->instance->count; ++i) pending.push_back(&value->instance->fields()[i]);
+        }
+        if (value->type != Type::Array && value->type != Type::Dict) continue;
+        if (value->object.get() == target) return true;
+        if (!seen.insert(value->object.get()).second) continue;
+        if (value->type == Type::Array) {
+            for (auto& element : value->array().boxed) pending.push_back(&element);
+        } else {
+            for (auto& entry : value->dict().entries) pending.push_back(&entry.value);
+        }
+    }
+    return false;
+}
+
+static_assert(sizeof(Instance) % alignof(Value) == 0, "instance fields must follow the header aligned");
+
+inline Instance* Instance::create(Symbol blueprint, const FrameLayout& layout) {
+    uint32_t count = static_cast<uint32_t>(layout.slots.size());
+    HeapBudget* budget = HeapQuota::current;
+    HeapQuota::charge(budget, sizeof(Instance) + count * sizeof(Value));
+    if (MemoryReport::enabled) MemoryReport::instance_created(blueprint, sizeof(Instance) + count * sizeof(Value));
+    void* memory = ::operator new(sizeof(Instance) + count * sizeof(Value));
+    Instance* object = static_cast<Instance*>(memory);
+    object->blueprint = blueprint;
+    object->count = count;
+    object->layout = &layout;
+    object->budget = budget;
+    for (uint32_t i = 0; i < count; ++i) new (&object->fields()[i]) Value();
+    return object;
+}
+
+inline Instance* Instance::clone(const Instance& other) {
+    Instance* object = create(other.blueprint, *other.layout);
+    for (uint32_t i = 0; i < other.count; ++i) object->fields()[i] = other.fields()[i];
+    return object;
+}
+
+inline void Instance::destroy(Instance* object) {
+    for (uint32_t i = 0; i < object->count; ++i) object->fields()[i].~Value();
+    HeapQuota::release(object->budget, sizeof(Instance) + object->count * sizeof(Value));
+    if (MemoryReport::enabled) MemoryReport::instance_destroyed(object->blueprint, sizeof(Instance) + object->count * sizeof(Value));
+    ::operator delete(object);
+}
+
+class Profiler;
+
+// Cooperative scheduling hooks, installed on contexts run by a GreenScheduler.
+struct YieldPoints {
+    virtual ~YieldPoints() = default;
+    virtual void safepoint() = 0;      // Loop back-edges and call boundaries
+    virtual void wait_for_input() = 0; // Before every scanning_user_input read
+};
+
+// Sites that rewrote themselves into a specialized variant, and sites whose
+// guard later failed and sent them back to the generic path, summed over
+// every context since startup.
+struct QuickeningCounters {
+    std::atomic<long> quickened{0};
+    std::atomic<long> deopted{0};
+};
+
+QuickeningCounters& quickening_counters();
+
+// Limits on one script run, for untrusted code; 0 means none. Steps are
+// loop back-edges, calls and parallel_repeat iterations; the step count
+// and the clock are checked on a countdown of those, the heap on every
+// string, instance, array and dictionary allocation. Exceeding one throws
+// a RuntimeError at the line that was running.
+struct ExecutionLimits {
+    long long steps = 0;
+    long long heap_bytes = 0;
+    long long timeout_ms = 0;
+};
+
+// One activation on the value stack: a window of layout->slots.size() values
+// starting at `base`. Method frames also expose the receiver's fields.
+struct Frame {
+    size_t base;
+    const FrameLayout* layout;
+    Instance* self; // Receiver of a method frame, searched after its slots; null otherwise
+};
+
+// All mutable state of one script execution. Any number of contexts can run
+// the same program concurrently; what they write to the shared AST is
+// limited to atomic quickening feedback, stamped call caches and lazy bodies
+// (see Program).
+struct ExecutionContext {
+    HeapBudget heap;           // First, so it outlives every value charged to it
+    std::vector<Value> stack;  // Slots of every live frame, innermost last
+    std::vector<Frame> frames;
+    Value result;              // Value of the last evaluated expression
+    Value return_value;
+    bool returning = false;    // Set by yield; unwinds statement loops up to the call
+    Instance* self = nullptr;  // Receiver of the innermost running method
+    std::unordered_map<Symbol, BlueprintNode*> blueprints; // Keyed by qualified name, e.g. Outer.Inner
+    std::unordered_map<Symbol, FunctionNode*> functions;
+    Symbol current_scope = NO_SYMBOL; // Tracks nested blueprint scope
+    unsigned parallel_workers = 0; // parallel_repeat threads, 0 = one per hardware thread
+    long parallel_grain = 0;       // Iterations per chunk, 0 = derived from the range size
+    int parallel_depth = 0;        // > 0 inside a parallel_repeat body; nested loops run serially
+    Value* accumulator = nullptr;  // Partial sum of the innermost parallel_repeat
+    YieldPoints* yield_points = nullptr;
+    Profiler* profiler = nullptr;  // Set in --profile mode; not shared with parallel workers
+    bool quicken = true;           // Let executing nodes specialize themselves; off with --no-quicken
+    uint64_t definitions;          // Stamp of functions and blueprints: bumped when either maps a name to a new node
+    ExecutionLimits limits;
+    long long countdown = LLONG_MAX; // Steps left before the limits are checked again
+    long long chunk = LLONG_MAX;     // Length of the current countdown
+    long long steps = 0;             // Steps taken before the current countdown
+    std::chrono::steady_clock::time_point deadline;
+    std::ostream& out;
+    std::istream& in;
+
+    explicit ExecutionContext(std::ostream& o = std::cout, std::istream& i = std::cin)
+        : definitions(fresh_stamp()), out(o), in(i) {
+        stack.reserve(1024);
+        frames.reserve(64);
+    }
+
+    // Starts counting steps and time against `limits`; the heap limit is
+    // applied by a HeapQuota::Scope of heap_budget() around the run.
+    void start_limits() {
+        heap.limit = limits.heap_bytes;
+        steps = 0;
+        if (limits.timeout_ms) deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(limits.timeout_ms);
+        rearm();
+    }
+    HeapBudget* heap_budget() { return limits.heap_bytes ? &heap : nullptr; }
+    long long steps_taken() const { return steps + (chunk - countdown); }
+    // The countdown runs out when the step limit is passed, or often enough
+    // to notice the deadline within a fraction of a millisecond.
+    void rearm() {
+        long long next = limits.timeout_ms ? 4096 : LLONG_MAX;
+        if (limits.steps) next = std::min(next, std::max(1LL, limits.steps + 1 - steps));
+        chunk = countdown = next;
+    }
+
+    // Stamps of different contexts never collide: the high half is unique
+    // per context, the low half counts its definition changes.
+    static uint64_t fresh_stamp() {
+        static std::atomic<uint64_t> contexts(0);
+        return (contexts.fetch_add(1) + 1) << 32;
+    }
+};
+
+// What every interpreter instantiation shares, so errors thrown by any of
+// them are one type.
+class InterpreterBase : public ASTVisitor {
 public:
     struct RuntimeError : public std::runtime_error {
         RuntimeError(const std::string& msg, int l) : std::runtime_error(msg + " at line " + std::to_string(l)) {}
     };
+};
 
-    struct ReturnValue : public std::runtime_error {
-        Value value;
-        ReturnValue(const Value& v) : std::runtime_error("Return"), value(v) {}
-    };
+// Rejects storing `value` into `container` when that would make the
+// container hold itself; such a cycle could not be printed, copied or freed.
+inline void check_no_cycle(const Object& container, const Value& value, const char* kind, int line) {
+    if (value.type == Value::Type::Int || value.type == Value::Type::String) return;
+    if (value.reaches(&container)) throw InterpreterBase::RuntimeError(std::string("Cannot store ") + kind + " inside itself", line);
+}
+
+// The hook policy of the production interpreter. BasicInterpreter calls a
+// policy before and after every node it visits, around every call, and for
+// every string, array, dictionary and instance it builds; these empty
+// inline members compile to nothing. Instrumented policies are in hooks.h.
+struct NoHooks {
+    static const bool enabled = false; // When false, hooks must do nothing, and parallel_repeat may use threads
+    void before(ASTNode&, ExecutionContext&) {}
+    void after(ASTNode&, ExecutionContext&) {}
+    void call(Symbol, int, ExecutionContext&) {}
+    void returned(Symbol, ExecutionContext&) {}
+    void allocate(Value::Type, size_t, int) {}
+};
+
+// The tree-walking interpreter, compiled once per hook policy. Instrumented
+// instantiations run parallel_repeat bodies serially on their own thread, so
+// every iteration passes through the policy.
+template <class Hooks>
+class BasicInterpreter : public InterpreterBase {
+public:
+    BasicInterpreter();                                    // Owns a context bound to std::cout/std::cin
+    explicit BasicInterpreter(ExecutionContext& context, Hooks hooks = Hooks());
 
     void visit(ProgramNode& node) override;
     void visit(BlueprintNode& node) override;
     void visit(VarDeclNode& node) override;
     void visit(FunctionNode& node) override;
     void visit(IfNode& node) override;
+    void visit(ChooseNode& node) override;
     void visit(WhileNode& node) override;
     void visit(PrintNode& node) override;
     void visit(InputNode& node) override;
@@ -80,18 +710,73 @@ public:
     void visit(YieldNode& node) override;
     void visit(InstanceNode& node) override;
     void visit(LetConstDeclNode& node) override;
+    void visit(ParallelForNode& node) override;
+    void visit(AccumulateNode& node) override;
+    void visit(FieldAccessNode& node) override;
+    void visit(FieldAssignmentNode& node) override;
+    void visit(ArrayLiteralNode& node) override;
+    void visit(DictLiteralNode& node) override;
+    void visit(IndexNode& node) override;
+    void visit(IndexAssignmentNode& node) override;
+    void visit(ImportNode& node) override;
+    void visit(InlinedCallNode& node) override;
 
     Value evaluate(ASTNode* node);
-    Value* current_instance = nullptr;
-    Value call_function(const std::string& name, const std::vector<Value>& args = {});
     bool to_bool(const Value& value);
 
+    ExecutionContext& context() { return ctx; }
+    Hooks& policy() { return hooks; }
+    void run_iterations(ParallelForNode& node, long begin, long end, Value& partial);
+
+    // For the REPL, which keeps one outermost frame across inputs.
+    // enter_globals() makes `layout` that frame's layout, growing the stack
+    // to fit and dropping whatever a failed statement left above it; the
+    // layout may only have gained slots since the last call. run_global()
+    // then runs one top-level statement in it.
+    void enter_globals(const FrameLayout& layout);
+    void run_global(ASTNode& stmt) { execute(stmt); }
+
+    // Runs an imported module's top level in a frame of its own that stays
+    // on the stack, so its globals stay visible by name to whatever runs
+    // after it. Modules are resolved on their own, so one parsed module can
+    // run under any importer.
+    void run_module(ProgramNode& module);
+
 private:
-    std::vector<std::unordered_map<std::string, Value>> scopes;
-    std::unordered_map<std::string, BlueprintNode*> blueprints;
-    std::unordered_map<std::string, FunctionNode*> functions;
-    std::string current_scope; // Added to track nested blueprint scope
-    Value call_method(const Value& instance, const std::string& method_name, const std::vector<Value>& args = {});
+    friend class ClosureEngine; // Shares the frame and lookup helpers
+    std::unique_ptr<ExecutionContext> owned_context;
+    ExecutionContext& ctx;
+    Hooks hooks;
+    void execute(ASTNode& stmt);
+    void run_block(const std::vector<std::unique_ptr<ASTNode>>& statements);
+    void push_frame(const FrameLayout& layout, size_t base, Instance* self = nullptr);
+    void pop_frame();
+    Value* lookup(Symbol name, int slot);
+    Value& local(int slot) { return ctx.stack[ctx.frames.back().base + slot]; }
+    Value invoke(FunctionNode& function, CallNode& call, Instance* self);
+    Instance& receiver(Symbol name, int slot, int line);
+    int field_offset(const Instance& object, Symbol field, int guess, int line);
+    Value& container_named(Symbol name, int slot, int line);
+    void quicken(BinaryOpNode& node, const Value& left, const Value& right);
+    bool quick_call(CallNode& node);
+    void cache_call(CallNode& node, Symbol blueprint, FunctionNode* target, const Builtin* builtin);
+    void deopt(std::atomic<Feedback>& feedback);
+    // Counts a loop back-edge or a call against ctx.limits.
+    void tick(int line) {
+        if (--ctx.countdown <= 0) check_limits(line);
+    }
+    void check_limits(int line);
+    // Reports a string an operator just built to the hooks.
+    void built_string(int line) {
+        if (Hooks::enabled && ctx.result.type == Value::Type::String) {
+            hooks.allocate(Value::Type::String, ctx.result.str_len, line);
+        }
+    }
+    Value call_builtin(const Builtin& builtin, CallNode& node);
+    size_t array_index(const Array& array, const Value& index, int line);
 };
 
+// The interpreter everything but an instrumented run uses.
+typedef BasicInterpreter<NoHooks> InterpreterVisitor;
+
 #endif
\ No newline at end of file
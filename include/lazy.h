@@ -0,0 +1,16 @@
+#ifndef LAZY_H
+#define LAZY_H
+
+#include "ast.h"
+
+// Parses, resolves and type-checks the body a lazy Parser left in
+// `function.lazy`, the first time only. Throws the body's first syntax
+// error, or its type errors, on every call until the body is valid.
+void parse_body(FunctionNode& function);
+
+// Called before running a function's body or reading its layout.
+inline void ensure_parsed(FunctionNode& function) {
+    if (function.lazy && !function.lazy->parsed.load(std::memory_order_acquire)) parse_body(function);
+}
+
+#endif
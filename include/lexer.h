@@ -1,6 +1,7 @@
 #ifndef LEXER_H
 #define LEXER_H
 
+#include "symbol.h"
 #include <string>
 #include <vector>
 
@@ -40,24 +41,46 @@ enum TokenType {
     TOK_IF,       // Added new token
     TOK_TRUE,     // Added new token
     TOK_FALSE,    // Added new token
-    TOK_ELSE_WHEN // Added new token for "else if"
+    TOK_ELSE_WHEN, // Added new token for "else if"
+    TOK_PARALLEL_REPEAT,
+    TOK_UNTIL,
+    TOK_ACCUMULATE,
+    TOK_LBRACKET,
+    TOK_RBRACKET,
+    TOK_COLON,
+    TOK_IMPORT,
+    TOK_CHOOSE,
+    TOK_WHEN,
+    TOK_ERROR     // Bad input in recovering mode; value is the message
 };
 
 struct Token {
     TokenType type;
     std::string value;
     int line;
+    Symbol symbol; // Interned text of identifiers and string literals, NO_SYMBOL otherwise
+    uint32_t offset; // Byte range [offset, end) in the source; `line` is the line at `end`
+    uint32_t end;
 };
 
+// Lexes a source string the caller keeps alive. A recovering lexer turns
+// bad input into TOK_ERROR tokens instead of throwing, so an editor buffer
+// with a typo still yields a token stream.
 class Lexer {
 public:
-    Lexer(const std::string& src);
+    explicit Lexer(const std::string& src, bool recover = false);
+    Lexer(std::string&&, bool = false) = delete;
     std::vector<Token> tokenize();
 
+    // Restarts at a token boundary, e.g. the end of an unchanged token.
+    void seek(size_t offset, int at_line) { pos = offset; line = at_line; }
+    Token next(); // The next token with its source range; TOK_EOF at the end
+
 private:
-    std::string source;
+    const std::string& source;
     size_t pos;
     int line;
+    bool recover;
 
     char peek();
     char advance();
@@ -0,0 +1,53 @@
+#ifndef MEMORY_REPORT_H
+#define MEMORY_REPORT_H
+
+#include "symbol.h"
+#include <atomic>
+#include <cstddef>
+#include <ostream>
+
+// What the program was doing when memory was allocated.
+enum class MemoryPhase { Startup, Lex, Parse, Exec };
+const int MEMORY_PHASES = 4;
+
+// What an allocation was for. Tokens, Ast and Scopes are the calling
+// thread's tag (see MemoryReport::Tag) while operator new runs; Strings
+// and Instances are recorded where script strings grow and instances are
+// created, whatever the tag.
+enum class MemoryCategory { Other, Tokens, Ast, Scopes, Strings, Instances };
+const int MEMORY_CATEGORIES = 6;
+
+// Allocation accounting for --mem-report. Once enabled, the global operator
+// new and delete in memory_report.cpp count every allocation against the
+// current phase and tag, and track live and peak heap bytes. Live instances
+// are also counted per blueprint. When it is off, each allocation costs one
+// extra branch.
+struct MemoryReport {
+    static bool enabled; // Set once, before any other thread starts
+    static std::atomic<int> phase;
+    static thread_local MemoryCategory tag;
+
+    static void enable() { enabled = true; }
+    static void enter(MemoryPhase next) { phase.store(static_cast<int>(next), std::memory_order_relaxed); }
+
+    // Tags allocations on this thread for its lifetime.
+    class Tag {
+    public:
+        explicit Tag(MemoryCategory category) : saved(tag) { tag = category; }
+        ~Tag() { tag = saved; }
+    private:
+        MemoryCategory saved;
+    };
+
+    static void allocated(void* memory, size_t bytes); // From operator new
+    static void freed(void* memory);                   // From operator delete
+    static void record(MemoryCategory category, size_t bytes);
+    static void instance_created(Symbol blueprint, size_t bytes);
+    static void instance_destroyed(Symbol blueprint, size_t bytes);
+
+    // Allocations per phase and category, peak and final live heap, and
+    // the blueprints whose live instances peaked highest, in bytes.
+    static void write_report(std::ostream& out, size_t max_blueprints = 10);
+};
+
+#endif
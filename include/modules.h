@@ -0,0 +1,74 @@
+#ifndef MODULES_H
+#define MODULES_H
+
+#include "ast.h"
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class ThreadPool;
+
+// One parsed .as file. Its AST is resolved on its own, independent of who
+// imports it, so a module is parsed once and shared by every program and
+// thread that imports it.
+struct Module {
+    std::string path;                  // Canonical path, the cache key
+    std::unique_ptr<ProgramNode> ast;
+    std::vector<std::string> imports;  // Canonical paths of its top-level imports, in source order
+    long long mtime_ns = 0;            // Of the file the AST was parsed from
+    long long size = 0;
+    double compile_ms = 0;             // Read, lex, parse and resolve
+};
+
+// Finds, parses and caches modules. A load walks the import graph from a
+// program's top-level import statements; every module not seen yet in that
+// load is lexed and parsed as a job on a thread pool, so independent
+// modules compile concurrently and a module imported along several paths
+// (a diamond) is compiled once. Parsed modules are kept across loads and
+// reused while the file's size and modification time are unchanged, so
+// after an edit only the edited file is parsed again.
+class ModuleLoader {
+public:
+    explicit ModuleLoader(unsigned threads = 0); // 0 = one per hardware thread
+    ~ModuleLoader();
+
+    // How the last load got each module, in run order.
+    struct Report {
+        std::string path;
+        double compile_ms; // 0 when reused
+        bool reused;
+    };
+
+    // The modules `program` imports, directly or not, in dependency order:
+    // every module comes after the modules it imports. Import paths are
+    // relative to `dir`, or to the importing module's directory. Throws with
+    // every unreadable or unparsable module, or an import cycle;
+    // `importer` is the program's own path, so importing it is a cycle too.
+    std::vector<std::shared_ptr<const Module>> load_imports(const ProgramNode& program, const std::string& dir,
+                                                            const std::string& importer = "");
+    const std::vector<Report>& last_report() const { return report; }
+
+    // Shared by load_program(), so scripts of one batch reuse their libraries.
+    static ModuleLoader& shared();
+
+private:
+    std::unique_ptr<ThreadPool> pool;
+    unsigned threads;
+    std::mutex load_mutex;  // One load at a time; it owns `pool` and `report`
+    std::mutex cache_mutex;
+    std::unordered_map<std::string, std::shared_ptr<const Module>> cache;
+    std::vector<Report> report;
+
+    std::shared_ptr<const Module> fetch(const std::string& path, bool& reused);
+};
+
+// The path a module is cached under: `path` made absolute and canonical,
+// resolved against `dir` when relative.
+std::string module_path(const std::string& dir, const std::string& path);
+
+// The directory part of a path, "." when it has none.
+std::string directory_of(const std::string& path);
+
+#endif
@@ -6,20 +6,43 @@
 #include <vector>
 
 
+// Recursive-descent parser. After a syntax error it skips to the end of the
+// broken top-level statement and carries on, so parse() reports every error
+// at once and an editor can keep the statements that still parse.
 class Parser {
 public:
-    Parser(const std::vector<Token>& t);
-    std::unique_ptr<ASTNode> parse();
+    explicit Parser(std::vector<Token> t);         // Owns the tokens
+    explicit Parser(const std::vector<Token>* t);  // Borrows tokens that outlive the parser
+    // With `lazy_bodies`, function bodies are only brace-matched and left as
+    // LazyBodies sharing the tokens, to be parsed on the function's first
+    // call. Syntax errors inside them are reported then.
+    Parser(std::shared_ptr<const std::vector<Token>> t, bool lazy_bodies);
+    std::unique_ptr<ASTNode> parse(); // Throws with every syntax error, one per line
+
+    // One top-level statement from the current token, or null after a
+    // syntax error, with the message in `error` and the broken statement skipped.
+    std::unique_ptr<ASTNode> next_statement(std::string& error);
+    size_t position() const { return pos; }
+    void seek(size_t token) { pos = token; }
+    bool done() { return at_end(); }
+
+    // The statements of a body this parser's tokens hold; throws the first
+    // syntax error. Bodies of functions inside it stay lazy.
+    std::vector<std::unique_ptr<ASTNode>> skipped_body(const LazyBody& body);
 
 private:
-    std::vector<Token> tokens;
+    std::vector<Token> owned;
+    std::shared_ptr<const std::vector<Token>> shared; // Kept alive for lazy bodies
+    const std::vector<Token>* tokens;
     size_t pos;
+    bool lazy_bodies = false;
 
-    Token peek();
-    Token advance();
+    const Token& peek();
+    const Token& advance();
     bool match(TokenType type);
     bool at_end();
-    Token peek_next();
+    const Token& peek_next();
+    void synchronize();
     int get_precedence(TokenType type);
     Token expect(TokenType type, const std::string& msg);
 
@@ -28,12 +51,17 @@ private:
     std::unique_ptr<ASTNode> var_decl();
     std::unique_ptr<ASTNode> let_const_decl(); // Added missing declaration
     std::unique_ptr<ASTNode> function();
+    void skip_body(FunctionNode& function);
     std::unique_ptr<ASTNode> if_stmt();
     std::unique_ptr<ASTNode> while_stmt();
+    std::unique_ptr<ASTNode> choose_stmt();
+    std::unique_ptr<ASTNode> parallel_repeat_stmt();
+    std::unique_ptr<ASTNode> accumulate_stmt();
     std::unique_ptr<ASTNode> print_stmt();
     std::unique_ptr<ASTNode> input_stmt();
     std::unique_ptr<ASTNode> yield_stmt();
     std::unique_ptr<ASTNode> instance_stmt();
+    std::unique_ptr<ASTNode> import_stmt();
     std::unique_ptr<ASTNode> assignment(); // Keep this for compatibility
     std::unique_ptr<ASTNode> parse_assignment(const Token& id); // Added declaration
     std::unique_ptr<ASTNode> expression();
@@ -0,0 +1,84 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include "symbol.h"
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Records call counts and inclusive/exclusive time per function and method,
+// a call tree for flamegraphs, and how often each source line executed.
+// Attached to an ExecutionContext only in --profile mode; the interpreter
+// checks for a null profiler and does nothing else when it is absent.
+class Profiler {
+public:
+    Profiler();
+
+    // `callee` identifies the function (its FunctionNode, or its Builtin);
+    // `owner` is the blueprint for methods, NO_SYMBOL for plain functions.
+    void enter(const void* callee, Symbol owner, Symbol name);
+    void leave();
+    void count_line(int line) {
+        if (line >= static_cast<int>(line_counts.size())) line_counts.resize(line + 1, 0);
+        line_counts[line]++;
+    }
+    void finish(); // Closes the top-level frame; call once execution ends
+
+    // One "root;f;g <microseconds>" line per call path, as flamegraph.pl expects.
+    void write_collapsed(std::ostream& out) const;
+    // Functions sorted by exclusive time, then the most executed lines.
+    void write_report(std::ostream& out, const std::string& source, size_t max_lines = 20) const;
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct FunctionStats {
+        std::string name;
+        uint64_t calls = 0;
+        uint64_t inclusive_ns = 0;
+        uint64_t exclusive_ns = 0;
+    };
+    struct TreeNode {
+        size_t function;
+        uint64_t self_ns = 0;
+        std::map<size_t, size_t> children; // Function index -> tree node index
+    };
+    struct Frame {
+        size_t function;
+        size_t tree_node;
+        Clock::time_point start;
+        uint64_t child_ns;
+        bool recursive; // Function already on the stack: inclusive time counted by the outer frame
+    };
+
+    std::vector<FunctionStats> functions;
+    std::unordered_map<const void*, size_t> function_index;
+    std::vector<TreeNode> tree;
+    std::vector<Frame> stack;
+    std::vector<uint64_t> line_counts;
+
+    void write_tree(std::ostream& out, size_t node, std::string& path) const;
+};
+
+// Enters a profiler frame for the lifetime of the guard; no-op without a profiler.
+class ProfileScope {
+public:
+    ProfileScope(Profiler* p, const void* callee, Symbol owner, Symbol name)
+        : profiler(p) {
+        if (profiler) profiler->enter(callee, owner, name);
+    }
+    ~ProfileScope() {
+        if (profiler) profiler->leave();
+    }
+
+private:
+    Profiler* profiler;
+    ProfileScope(const ProfileScope&);
+    ProfileScope& operator=(const ProfileScope&);
+};
+
+#endif
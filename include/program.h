@@ -0,0 +1,29 @@
+#ifndef PROGRAM_H
+#define PROGRAM_H
+
+#include "ast.h"
+#include "modules.h"
+#include <string>
+#include <memory>
+#include <vector>
+
+struct ExecutionContext;
+
+// A lexed and parsed script. One Program can be shared by any number of
+// ExecutionContexts on any thread, although running it still writes to the
+// AST: quickened nodes update their feedback atomically, a call site's
+// cache is only rewritten by the context whose definitions stamp it holds,
+// and a lazily parsed body is parsed once, under its LazyBody's mutex.
+struct Program {
+    std::string name;
+    std::unique_ptr<ASTNode> ast;
+    std::vector<std::shared_ptr<const Module>> imports; // Run first, in this order
+
+    void run(ExecutionContext& context) const;
+};
+
+// `inline_small` inlines calls to small functions, as --no-inline turns off for single scripts.
+std::shared_ptr<const Program> parse_program(const std::string& name, const std::string& source, bool inline_small = true);
+std::shared_ptr<const Program> load_program(const std::string& path, bool inline_small = true);
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef REPL_H
+#define REPL_H
+
+#include "ast.h"
+#include "interpreter.h"
+#include "modules.h"
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct ReplOptions {
+    bool timing = false;        // Start with :time on
+    unsigned workers = 0;       // As --workers
+    long grain = 0;             // As --grain
+};
+
+// One long-lived interpreter context fed a piece of source at a time. Each
+// input is lexed, parsed and resolved on its own, then only its statements
+// run: the outermost frame is kept and grown, so earlier globals, functions
+// and blueprints stay visible without re-running the input that made them.
+// Inputs are kept alive for as long as the session, since registered
+// functions and blueprints point into them. An imported module runs once
+// per version of its file, paths relative to the working directory; its
+// top-level variables become session globals.
+class ReplSession {
+public:
+    explicit ReplSession(ExecutionContext& context);
+
+    struct StatementTime {
+        int line;
+        double ms;
+    };
+
+    // True while `text` leaves a brace, bracket or parenthesis open, so the
+    // input continues on the next line.
+    static bool incomplete(const std::string& text);
+
+    // Compiles and runs one input. Syntax errors throw before anything runs;
+    // a runtime error stops the input at the failing statement, keeping what
+    // the statements before it did. When `times` is given it receives the
+    // execution time of every top-level statement that ran.
+    void submit(const std::string& text, std::vector<StatementTime>* times = nullptr);
+
+    double last_compile_ms() const { return compile_ms; } // -1 when the last input did not compile
+    const std::vector<ModuleLoader::Report>& last_imports() const { return ModuleLoader::shared().last_report(); }
+
+private:
+    ExecutionContext& ctx;
+    InterpreterVisitor interpreter;
+    std::vector<std::unique_ptr<ProgramNode>> inputs;
+    std::unordered_map<std::string, std::shared_ptr<const Module>> imported; // The version of each module that ran
+    std::deque<FrameLayout> module_layouts; // Globals grown by imported modules
+    FrameLayout empty;
+    const FrameLayout* globals = &empty; // Layout of the newest input's outermost frame
+    int next_line = 1;                   // Lines count on across inputs, for error messages
+    double compile_ms = 0;
+
+    void run_import(const Module& module);
+};
+
+// Reads inputs from `in` until end of input or :quit. Prompts are shown
+// only on a terminal. Returns 1 if any input failed, else 0.
+int run_repl(const ReplOptions& options, std::istream& in = std::cin);
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef RESOLVER_H
+#define RESOLVER_H
+
+#include "ast.h"
+
+// Assigns stack slots to every name written in each frame of the tree and
+// points identifier reads at them. Runs once after parsing; the interpreter
+// falls back to a by-name search of outer frames for reads left at -1 and
+// for slots that are still unset when read.
+void resolve_slots(ASTNode& root);
+
+// Resolves a program whose outermost frame continues `globals`: existing
+// names keep their slots and new ones are appended, so program.layout is
+// `globals` grown by the names this program writes. Used by the REPL.
+void resolve_slots(ProgramNode& program, const FrameLayout& globals);
+
+// Resolves a body parsed on its function's first call (see LazyBody);
+// `fields` is the receiver's field layout when the function is a method.
+void resolve_slots(FunctionNode& function, const FrameLayout* fields);
+
+#endif
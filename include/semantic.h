@@ -0,0 +1,38 @@
+#ifndef SEMANTIC_H
+#define SEMANTIC_H
+
+#include "ast.h"
+#include <string>
+#include <vector>
+
+// What the inference pass can prove about a value. Bottom means no value
+// has reached it yet; Bool values are ints at run time, so Bool and Int
+// join to Int; anything else that disagrees joins to Unknown.
+enum class StaticType { Bottom, Bool, Int, String, Instance, Array, Dict, Unknown };
+
+const char* type_name(StaticType type);
+
+// Infers the types of locals, parameters and yield results, joining every
+// write to a slot, and annotates the tree for the interpreter: operators on
+// proven ints or strings get an unchecked BinaryOpNode::kind, reads of
+// slots that are written on every path before them skip the outer-frame
+// fallback, and integer declarations of proven ints skip their runtime
+// check. Runs after resolve_slots().
+//
+// Scoping is dynamic, so parameters and call results are only typed when
+// `whole_program` promises that no code outside this tree (an importer, a
+// later REPL input) defines or calls its functions.
+//
+// Returns the type errors that fail whenever the code runs, such as an
+// integer declared with a string or arithmetic on an array, one message
+// per error.
+std::vector<std::string> infer_types(ProgramNode& program, bool whole_program);
+
+// infer_types(), throwing its errors one per line, as Parser::parse() does.
+void check_types(ProgramNode& program, bool whole_program);
+
+// check_types() for a body parsed on its function's first call (see
+// LazyBody). Nothing is assumed about its parameters, as in a module.
+void check_types(FunctionNode& function);
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "interpreter.h"
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+// The state an initialization script leaves behind, saved as a binary image
+// so later runs start from it instead of running the script again: its
+// code, the functions and blueprints it registered, and its top-level
+// variables.
+//
+// The initialization script is compiled as a module (resolved on its own,
+// not inlined) and may not import anything. write_snapshot() runs after it
+// has run as a module, leaving its frame on the stack. Snapshot::load() maps
+// the image and rebuilds the code. Each restore() decodes the variables
+// straight from the mapping into a context as an outermost module frame, so
+// a program run after it sees them by name, as it would an import's.
+//
+// The image stores names as text and is only read by the binary that wrote
+// it (the version must match). Files cannot be saved; arrays and
+// dictionaries shared between variables stay shared.
+void write_snapshot(const std::string& path, ProgramNode& program, const ExecutionContext& ctx);
+
+class Snapshot {
+public:
+    ~Snapshot();
+
+    // Throws std::runtime_error when the file is missing or not a snapshot.
+    static std::shared_ptr<const Snapshot> load(const std::string& path);
+
+    // Pushes the saved variables as a frame on `ctx` and registers the
+    // saved functions and blueprints. `ctx` must have no frames yet.
+    void restore(ExecutionContext& ctx) const;
+
+    size_t image_size() const { return size; }
+
+private:
+    Snapshot() {}
+    Snapshot(const Snapshot&);
+    Snapshot& operator=(const Snapshot&);
+
+    const char* image = nullptr; // The mapped file
+    size_t size = 0;
+    bool mapped = false;         // Else `image` is a heap copy of the file
+    size_t globals_offset = 0;   // Where the variables start in `image`
+    std::vector<Symbol> symbols; // The image's symbol numbers in this process
+    std::unique_ptr<ProgramNode> ast;
+    std::vector<std::pair<Symbol, FunctionNode*>> functions;
+    std::vector<std::pair<Symbol, BlueprintNode*>> blueprints;
+    std::vector<ASTNode*> defined; // Function and blueprint nodes, numbered in image order
+};
+
+#endif
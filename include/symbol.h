@@ -0,0 +1,42 @@
+#ifndef SYMBOL_H
+#define SYMBOL_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+// Small integer id for an interned identifier or string literal. Equal text
+// always gets the same id, so names compare and hash as integers.
+typedef uint32_t Symbol;
+const Symbol NO_SYMBOL = 0; // The empty string
+
+// Process-wide intern table. Interning takes a lock; looking a name up does
+// not, since stored names never move once interned.
+class SymbolTable {
+public:
+    static Symbol intern(const std::string& text);
+    static const std::string& name(Symbol symbol);
+    static uint64_t hash(Symbol symbol); // hash_bytes() of the name, computed once at interning
+    static size_t size();
+};
+
+inline const std::string& symbol_name(Symbol symbol) { return SymbolTable::name(symbol); }
+
+// Fast non-cryptographic hash of a byte string, eight bytes per step.
+inline uint64_t hash_bytes(const char* data, size_t n) {
+    uint64_t h = 0x9e3779b97f4a7c15ull ^ n;
+    while (n >= 8) {
+        uint64_t word;
+        std::memcpy(&word, data, 8);
+        h = (h ^ word) * 0xff51afd7ed558ccdull;
+        h ^= h >> 32;
+        data += 8;
+        n -= 8;
+    }
+    uint64_t tail = 0;
+    std::memcpy(&tail, data, n);
+    h = (h ^ tail) * 0xc4ceb9fe1a85ec53ull;
+    return h ^ (h >> 29);
+}
+
+#endif
@@ -0,0 +1,81 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed-size pool of worker threads draining one shared FIFO of jobs.
+class ThreadPool {
+public:
+    explicit ThreadPool(unsigned workers);
+    ~ThreadPool();
+
+    void submit(std::function<void()> job);
+    void wait(); // Blocks until every submitted job has finished
+    unsigned size() const { return static_cast<unsigned>(threads.size()); }
+
+    static unsigned hardware_threads();
+
+private:
+    std::vector<std::thread> threads;
+    std::deque<std::function<void()>> queue;
+    std::mutex mutex;
+    std::condition_variable work_ready;
+    std::condition_variable work_done;
+    size_t pending = 0;
+    bool stopping = false;
+
+    void worker_loop();
+};
+
+// Fork-join pool for index ranges. Each worker owns a deque of ranges: it
+// splits the range it holds in halves down to the grain size, keeping the
+// lower half and pushing the upper half to the back of its deque, while idle
+// workers steal the oldest (largest) ranges from the front of other deques.
+class WorkStealingPool {
+public:
+    typedef std::function<void(unsigned worker, long begin, long end)> RangeBody;
+
+    explicit WorkStealingPool(unsigned workers);
+    ~WorkStealingPool();
+
+    // Calls body over [begin, end) in chunks of at most `grain` indices and
+    // returns once every chunk has run. One loop runs on a pool at a time, and
+    // body must not throw.
+    void parallel_for(long begin, long end, long grain, const RangeBody& body);
+    unsigned size() const { return static_cast<unsigned>(workers.size()); }
+
+    // Process-wide pool with `count` workers, recreated when the count changes.
+    // The returned lock must be held while the pool is used.
+    static WorkStealingPool& shared(unsigned count, std::unique_lock<std::mutex>& lock);
+
+private:
+    struct Range { long begin, end; };
+    struct Worker {
+        std::thread thread;
+        std::mutex mutex;
+        std::deque<Range> ranges;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::mutex mutex;
+    std::condition_variable loop_ready;
+    std::condition_variable loop_done;
+    const RangeBody* body = nullptr;
+    long grain = 1;
+    unsigned generation = 0;
+    unsigned active = 0;
+    std::atomic<long> remaining;
+    bool stopping = false;
+
+    void worker_loop(unsigned index);
+    bool pop_local(unsigned index, Range& out);
+    bool steal(unsigned thief, Range& out);
+};
+
+#endif
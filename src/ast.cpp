@@ -1,50 +1,141 @@
 #include "ast.h"
+#include <algorithm>
+#include <cstring>
 #include <sstream>
+#include <stdexcept>
 
 std::string to_string(const ASTNode& node) {
     std::ostringstream oss;
-    if (const auto* programNode = dynamic_cast<const ProgramNode*>(&node)) {
+    if (dynamic_cast<const ProgramNode*>(&node)) {
         oss << "Program(\"\")";
     } else if (const auto* blueprintNode = dynamic_cast<const BlueprintNode*>(&node)) {
-        oss << "Blueprint(\"" << blueprintNode->name << "\")";
+        oss << "Blueprint(\"" << symbol_name(blueprintNode->name) << "\")";
     } else if (const auto* varDeclNode = dynamic_cast<const VarDeclNode*>(&node)) {
-        oss << "VarDecl(\"" << varDeclNode->type << " " << varDeclNode->name << "\")";
+        oss << "VarDecl(\"" << varDeclNode->type << " " << symbol_name(varDeclNode->name) << "\")";
     } else if (const auto* functionNode = dynamic_cast<const FunctionNode*>(&node)) {
-        oss << "Function(\"" << functionNode->name << " (";
+        oss << "Function(\"" << symbol_name(functionNode->name) << " (";
         for (size_t i = 0; i < functionNode->parameters.size(); ++i) {
-            oss << functionNode->parameters[i];
+            oss << symbol_name(functionNode->parameters[i]);
             if (i < functionNode->parameters.size() - 1) oss << ", ";
         }
         oss << ")\")";
-    } else if (const auto* ifNode = dynamic_cast<const IfNode*>(&node)) {
+    } else if (dynamic_cast<const IfNode*>(&node)) {
         oss << "If(\"\")";
-    } else if (const auto* whileNode = dynamic_cast<const WhileNode*>(&node)) {
+    } else if (dynamic_cast<const ChooseNode*>(&node)) {
+        oss << "Choose(\"\")";
+    } else if (dynamic_cast<const WhileNode*>(&node)) {
         oss << "While(\"\")";
-    } else if (const auto* printNode = dynamic_cast<const PrintNode*>(&node)) {
+    } else if (const auto* parallelNode = dynamic_cast<const ParallelForNode*>(&node)) {
+        oss << "ParallelFor(\"" << symbol_name(parallelNode->counter) << "\")";
+    } else if (dynamic_cast<const AccumulateNode*>(&node)) {
+        oss << "Accumulate(\"\")";
+    } else if (dynamic_cast<const PrintNode*>(&node)) {
         oss << "Print(\"\")";
     } else if (const auto* inputNode = dynamic_cast<const InputNode*>(&node)) {
         oss << "Input(\"" << inputNode->type << "\")";
     } else if (const auto* binaryOpNode = dynamic_cast<const BinaryOpNode*>(&node)) {
         oss << "BinaryOp(\"" << binaryOpNode->op << "\")";
     } else if (const auto* identifierNode = dynamic_cast<const IdentifierNode*>(&node)) {
-        oss << "Identifier(\"" << identifierNode->name << "\")";
+        oss << "Identifier(\"" << symbol_name(identifierNode->name) << "\")";
     } else if (const auto* numberNode = dynamic_cast<const NumberNode*>(&node)) {
         oss << "Number(\"" << numberNode->value << "\")";
     } else if (const auto* stringNode = dynamic_cast<const StringNode*>(&node)) {
-        oss << "String(\"" << stringNode->value << "\")";
+        oss << "String(\"" << stringNode->text() << "\")";
+    } else if (const auto* booleanNode = dynamic_cast<const BooleanNode*>(&node)) {
+        oss << "Boolean(\"" << (booleanNode->value ? "true" : "false") << "\")";
+    } else if (const auto* letConstNode = dynamic_cast<const LetConstDeclNode*>(&node)) {
+        oss << (letConstNode->is_const ? "ConstDecl" : "LetDecl") << "(\"" << symbol_name(letConstNode->name) << "\")";
     } else if (const auto* assignmentNode = dynamic_cast<const AssignmentNode*>(&node)) {
-        oss << "Assignment(\"" << assignmentNode->name << "\")";
+        oss << "Assignment(\"" << symbol_name(assignmentNode->name) << "\")";
     } else if (const auto* callNode = dynamic_cast<const CallNode*>(&node)) {
-        oss << "Call(\"" << callNode->name << " (";
+        oss << "Call(\"";
+        if (callNode->receiver != NO_SYMBOL) oss << symbol_name(callNode->receiver) << ".";
+        oss << symbol_name(callNode->name) << " (";
         for (size_t i = 0; i < callNode->arguments.size(); ++i) {
             oss << to_string(*callNode->arguments[i]);
             if (i < callNode->arguments.size() - 1) oss << ", ";
         }
         oss << ")\")";
-    } else if (const auto* yieldNode = dynamic_cast<const YieldNode*>(&node)) {
+    } else if (dynamic_cast<const YieldNode*>(&node)) {
         oss << "Yield(\"\")";
     } else if (const auto* instanceNode = dynamic_cast<const InstanceNode*>(&node)) {
-        oss << "Instance(\"" << instanceNode->blueprint_name << " " << instanceNode->instance_name << "\")";
+        oss << "Instance(\"" << symbol_name(instanceNode->blueprint_name) << " " << symbol_name(instanceNode->instance_name) << "\")";
+    } else if (const auto* fieldNode = dynamic_cast<const FieldAccessNode*>(&node)) {
+        oss << "Field(\"" << symbol_name(fieldNode->receiver) << "." << symbol_name(fieldNode->field) << "\")";
+    } else if (const auto* fieldAssignNode = dynamic_cast<const FieldAssignmentNode*>(&node)) {
+        oss << "FieldAssignment(\"" << symbol_name(fieldAssignNode->receiver) << "." << symbol_name(fieldAssignNode->field) << "\")";
+    } else if (const auto* arrayNode = dynamic_cast<const ArrayLiteralNode*>(&node)) {
+        oss << "Array(\"" << arrayNode->elements.size() << "\")";
+    } else if (const auto* dictNode = dynamic_cast<const DictLiteralNode*>(&node)) {
+        oss << "Dict(\"" << dictNode->keys.size() << "\")";
+    } else if (const auto* indexNode = dynamic_cast<const IndexNode*>(&node)) {
+        oss << "Index(\"" << symbol_name(indexNode->name) << "\")";
+    } else if (const auto* indexAssignNode = dynamic_cast<const IndexAssignmentNode*>(&node)) {
+        oss << "IndexAssignment(\"" << symbol_name(indexAssignNode->name) << "\")";
+    } else if (const auto* importNode = dynamic_cast<const ImportNode*>(&node)) {
+        oss << "Import(\"" << importNode->path << "\")";
+    } else if (const auto* inlinedNode = dynamic_cast<const InlinedCallNode*>(&node)) {
+        oss << "Inlined(\"";
+        if (inlinedNode->receiver != NO_SYMBOL) oss << symbol_name(inlinedNode->receiver) << ".";
+        oss << symbol_name(inlinedNode->callee) << " (" << to_string(*inlinedNode->result) << ")\")";
     }
     return oss.str();
-}
\ No newline at end of file
+}
+
+const int ChooseNode::NO_CASE;
+
+// Int labels fill a table when it would be at least a quarter full.
+void ChooseNode::build_dispatch() {
+    std::unordered_map<int, int> ints;
+    std::unordered_map<Symbol, int> strings;
+    for (size_t c = 0; c < labels.size(); ++c) {
+        for (const Label& label : labels[c]) {
+            bool added = label.is_string ? strings.insert(std::make_pair(label.text, static_cast<int>(c))).second
+                                         : ints.insert(std::make_pair(label.number, static_cast<int>(c))).second;
+            if (!added) {
+                std::string shown = label.is_string ? "\"" + symbol_name(label.text) + "\"" : std::to_string(label.number);
+                throw std::runtime_error("Duplicate case " + shown + " at line " + std::to_string(label.line));
+            }
+        }
+    }
+
+    table.clear();
+    int_cases.clear();
+    if (!ints.empty()) {
+        int64_t low = ints.begin()->first, high = low;
+        for (auto& entry : ints) {
+            low = std::min<int64_t>(low, entry.first);
+            high = std::max<int64_t>(high, entry.first);
+        }
+        if (high - low < 4 * static_cast<int64_t>(ints.size())) {
+            table_base = low;
+            table.assign(static_cast<size_t>(high - low + 1), NO_CASE);
+            for (auto& entry : ints) table[entry.first - low] = entry.second;
+        } else {
+            int_cases = ints;
+        }
+    }
+
+    size_t buckets = 1;
+    while (buckets < 2 * strings.size()) buckets <<= 1;
+    string_cases.assign(strings.empty() ? 0 : buckets, StringCase{0, std::string(), NO_CASE});
+    for (auto& entry : strings) {
+        uint64_t hash = SymbolTable::hash(entry.first);
+        size_t pos = hash & (buckets - 1);
+        while (string_cases[pos].target != NO_CASE) pos = (pos + 1) & (buckets - 1);
+        string_cases[pos] = StringCase{hash, symbol_name(entry.first), entry.second};
+    }
+}
+
+int ChooseNode::find(const char* data, size_t length, Symbol interned) const {
+    if (string_cases.empty()) return NO_CASE;
+    uint64_t hash = interned != NO_SYMBOL ? SymbolTable::hash(interned) : hash_bytes(data, length);
+    size_t mask = string_cases.size() - 1;
+    for (size_t pos = hash & mask; string_cases[pos].target != NO_CASE; pos = (pos + 1) & mask) {
+        const StringCase& entry = string_cases[pos];
+        if (entry.hash == hash && entry.text.size() == length && std::memcmp(entry.text.data(), data, length) == 0) {
+            return entry.target;
+        }
+    }
+    return NO_CASE;
+}
@@ -0,0 +1,136 @@
+#include "batch.h"
+#include "program.h"
+#include "interpreter.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <dirent.h>
+#include <iostream>
+#include <sstream>
+#include <sys/stat.h>
+#include <vector>
+
+namespace {
+
+struct JobResult {
+    std::string output;
+    std::string error;
+};
+
+bool is_directory(const std::string& path) {
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+std::vector<std::string> list_scripts(const std::string& dir) {
+    std::vector<std::string> paths;
+    DIR* d = opendir(dir.c_str());
+    if (!d) throw std::runtime_error("Error opening directory: " + dir);
+    while (dirent* entry = readdir(d)) {
+        std::string name = entry->d_name;
+        if (name.size() > 3 && name.compare(name.size() - 3, 3, ".as") == 0) {
+            paths.push_back(dir + "/" + name);
+        }
+    }
+    closedir(d);
+    std::sort(paths.begin(), paths.end());
+    return paths;
+}
+
+} // namespace
+
+std::vector<std::string> collect_scripts(const std::string& target) {
+    if (is_directory(target)) return list_scripts(target);
+    return std::vector<std::string>(1, target);
+}
+
+namespace {
+
+// Executes all jobs once on `threads` workers and returns the wall time in seconds.
+double run_jobs(const std::vector<std::shared_ptr<const Program>>& jobs, unsigned threads,
+                std::vector<JobResult>& results) {
+    results.assign(jobs.size(), JobResult());
+    auto start = std::chrono::steady_clock::now();
+    {
+        ThreadPool pool(threads);
+        for (size_t i = 0; i < jobs.size(); ++i) {
+            pool.submit([&jobs, &results, i] {
+                std::ostringstream out;
+                std::istringstream in;
+                ExecutionContext context(out, in);
+                try {
+                    jobs[i]->run(context);
+                } catch (const std::exception& e) {
+                    results[i].error = e.what();
+                }
+                results[i].output = out.str();
+            });
+        }
+        pool.wait();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+} // namespace
+
+int run_batch(const BatchOptions& options) {
+    std::vector<std::string> paths;
+    try {
+        paths = collect_scripts(options.target);
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    std::vector<std::shared_ptr<const Program>> programs;
+    for (auto& path : paths) {
+        try {
+            programs.push_back(load_program(path, options.inline_small));
+        } catch (const std::exception& e) {
+            std::cerr << "Skipping " << path << ": " << e.what() << std::endl;
+        }
+    }
+    if (programs.empty()) {
+        std::cerr << "No .as files in " << options.target << std::endl;
+        return 1;
+    }
+
+    // Copies share the parsed program; only the execution state is per job.
+    std::vector<std::shared_ptr<const Program>> jobs;
+    for (int c = 0; c < std::max(options.copies, 1); ++c) {
+        jobs.insert(jobs.end(), programs.begin(), programs.end());
+    }
+
+    unsigned threads = options.threads ? options.threads : ThreadPool::hardware_threads();
+    std::vector<JobResult> results;
+    double seconds = run_jobs(jobs, threads, results);
+
+    size_t failed = 0;
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        if (!results[i].error.empty()) failed++;
+        if (options.show_output) {
+            std::cout << "=== " << jobs[i]->name << " (job " << i << ")\n" << results[i].output;
+            if (!results[i].error.empty()) std::cout << "error: " << results[i].error << "\n";
+        }
+    }
+
+    char line[160];
+    std::snprintf(line, sizeof(line), "Batch: %zu jobs (%zu failed) on %u threads in %.3f ms, %.1f jobs/s",
+                  jobs.size(), failed, threads, seconds * 1000.0, jobs.size() / seconds);
+    std::cout << line << std::endl;
+
+    if (options.scaling) {
+        std::cout << "Scaling:\n  threads      wall ms       jobs/s  speedup  efficiency\n";
+        double base = 0;
+        for (unsigned t = 1; ; t = std::min(t * 2, threads)) {
+            double s = run_jobs(jobs, t, results);
+            if (t == 1) base = s;
+            std::snprintf(line, sizeof(line), "  %7u %12.3f %12.1f %8.2f %10.0f%%",
+                          t, s * 1000.0, jobs.size() / s, base / s, 100.0 * base / s / t);
+            std::cout << line << "\n";
+            if (t == threads) break;
+        }
+    }
+    return failed == 0 ? 0 : 2;
+}
@@ -0,0 +1,376 @@
+#include "builtins.h"
+#include "files.h"
+#include <algorithm>
+#include <cctype>
+#include <unordered_map>
+
+// Array, dictionary and file builtins. The int kernels work on the unboxed
+// storage with plain counted loops over contiguous memory so the compiler
+// can vectorize them (the Makefile builds this file at -O3); boxed arrays
+// take generic paths.
+
+namespace {
+
+typedef InterpreterVisitor::RuntimeError RuntimeError;
+
+Array& array_arg(Value& value, const char* builtin, int line) {
+    if (value.type != Value::Type::Array) throw RuntimeError(std::string(builtin) + " needs an array", line);
+    return value.array();
+}
+
+Dict& dict_arg(Value& value, const char* builtin, int line) {
+    if (value.type != Value::Type::Dict) throw RuntimeError(std::string(builtin) + " needs a dictionary", line);
+    return value.dict();
+}
+
+LineReader& file_arg(Value& value, const char* builtin, int line) {
+    if (value.type != Value::Type::File) throw RuntimeError(std::string(builtin) + " needs a file", line);
+    return static_cast<LineReader&>(*value.object.get());
+}
+
+Value& string_arg(Value& value, const char* builtin, int line) {
+    if (value.type != Value::Type::String) throw RuntimeError(std::string(builtin) + " needs a string", line);
+    return value;
+}
+
+const Value& key_arg(const Value& key, const char* builtin, int line) {
+    if (!Dict::valid_key(key)) throw RuntimeError(std::string(builtin) + " needs an integer or string key", line);
+    return key;
+}
+
+const int* int_elements(Array& array, const char* builtin, int line) {
+    if (array.is_boxed) throw RuntimeError(std::string(builtin) + " needs an array of integers", line);
+    return array.ints.data();
+}
+
+int int_arg(Value& value, const char* builtin, int line) {
+    if (value.type != Value::Type::Int) throw RuntimeError(std::string(builtin) + " needs an integer", line);
+    return value.int_val;
+}
+
+bool same_value(const Value& a, const Value& b) {
+    if (a.type != b.type) return false;
+    if (a.type == Value::Type::Int) return a.int_val == b.int_val;
+    if (a.type == Value::Type::String) {
+        return a.str_len == b.str_len && std::char_traits<char>::compare(a.str_data(), b.str_data(), a.str_len) == 0;
+    }
+    return false;
+}
+
+// Kernels -------------------------------------------------------------------
+
+long long sum_ints(const int* p, size_t n) {
+    long long total = 0;
+    for (size_t i = 0; i < n; ++i) total += p[i];
+    return total;
+}
+
+int min_ints(const int* p, size_t n) {
+    int m = p[0];
+    for (size_t i = 1; i < n; ++i) m = p[i] < m ? p[i] : m;
+    return m;
+}
+
+int max_ints(const int* p, size_t n) {
+    int m = p[0];
+    for (size_t i = 1; i < n; ++i) m = p[i] > m ? p[i] : m;
+    return m;
+}
+
+// Integer ops wrap around like the interpreter's 32-bit arithmetic.
+void map_ints(const int* p, int* out, size_t n, char op, int k) {
+    unsigned uk = static_cast<unsigned>(k);
+    switch (op) {
+        case '+': for (size_t i = 0; i < n; ++i) out[i] = static_cast<int>(static_cast<unsigned>(p[i]) + uk); break;
+        case '-': for (size_t i = 0; i < n; ++i) out[i] = static_cast<int>(static_cast<unsigned>(p[i]) - uk); break;
+        case '*': for (size_t i = 0; i < n; ++i) out[i] = static_cast<int>(static_cast<unsigned>(p[i]) * uk); break;
+        case '/':
+            if (k == -1) {
+                for (size_t i = 0; i < n; ++i) out[i] = static_cast<int>(0u - static_cast<unsigned>(p[i]));
+            } else {
+                for (size_t i = 0; i < n; ++i) out[i] = p[i] / k;
+            }
+            break;
+        case '%':
+            if (k == -1) {
+                for (size_t i = 0; i < n; ++i) out[i] = 0;
+            } else {
+                for (size_t i = 0; i < n; ++i) out[i] = p[i] % k;
+            }
+            break;
+    }
+}
+
+// Index of the first element equal to `v`, or -1. Each block is tested with
+// a branch-free reduction first and only scanned when it holds a match.
+long search_ints(const int* p, size_t n, int v) {
+    const size_t block = 64;
+    size_t i = 0;
+    for (; i + block <= n; i += block) {
+        int hit = 0;
+        for (size_t j = 0; j < block; ++j) hit |= p[i + j] == v;
+        if (hit) break;
+    }
+    for (; i < n; ++i) {
+        if (p[i] == v) return static_cast<long>(i);
+    }
+    return -1;
+}
+
+// Builtins ------------------------------------------------------------------
+
+Value builtin_length(Value* args, int line) {
+    if (args[0].type == Value::Type::String) return Value(static_cast<int>(args[0].str_len));
+    if (args[0].type == Value::Type::Dict) return Value(static_cast<int>(args[0].dict().size()));
+    return Value(static_cast<int>(array_arg(args[0], "length", line).size()));
+}
+
+Value builtin_append(Value* args, int line) {
+    Array& array = array_arg(args[0], "append", line);
+    check_no_cycle(array, args[1], "an array", line);
+    array.push(std::move(args[1]));
+    return Value();
+}
+
+// array(n, value) -- n copies of value
+Value builtin_array(Value* args, int line) {
+    int n = int_arg(args[0], "array", line);
+    if (n < 0) throw RuntimeError("array size must not be negative", line);
+    Array* array = new Array();
+    Value result(array);
+    array->is_boxed = args[1].type != Value::Type::Int;
+    array->reserve(n);
+    if (array->is_boxed) {
+        array->boxed.assign(n, args[1]);
+    } else {
+        array->ints.assign(n, args[1].int_val);
+    }
+    return result;
+}
+
+// range(n) -- 0, 1, ..., n - 1
+Value builtin_range(Value* args, int line) {
+    int n = int_arg(args[0], "range", line);
+    if (n < 0) throw RuntimeError("range size must not be negative", line);
+    Array* array = new Array();
+    Value result(array);
+    array->reserve(n);
+    array->ints.resize(n);
+    int* p = array->ints.data();
+    for (int i = 0; i < n; ++i) p[i] = i;
+    return result;
+}
+
+Value builtin_sum(Value* args, int line) {
+    Array& array = array_arg(args[0], "sum", line);
+    const int* p = int_elements(array, "sum", line);
+    return Value(static_cast<int>(sum_ints(p, array.ints.size())));
+}
+
+Value builtin_min(Value* args, int line) {
+    Array& array = array_arg(args[0], "min", line);
+    const int* p = int_elements(array, "min", line);
+    if (array.ints.empty()) throw RuntimeError("min of an empty array", line);
+    return Value(min_ints(p, array.ints.size()));
+}
+
+Value builtin_max(Value* args, int line) {
+    Array& array = array_arg(args[0], "max", line);
+    const int* p = int_elements(array, "max", line);
+    if (array.ints.empty()) throw RuntimeError("max of an empty array", line);
+    return Value(max_ints(p, array.ints.size()));
+}
+
+// map(a, "*", k) -- a new array of each element combined with k
+Value builtin_map(Value* args, int line) {
+    Array& array = array_arg(args[0], "map", line);
+    const int* p = int_elements(array, "map", line);
+    std::string op = args[1].type == Value::Type::String ? args[1].as_string() : "";
+    if (op != "+" && op != "-" && op != "*" && op != "/" && op != "%") {
+        throw RuntimeError("map operator must be one of \"+\", \"-\", \"*\", \"/\", \"%\"", line);
+    }
+    int k = int_arg(args[2], "map", line);
+    if ((op == "/" || op == "%") && k == 0) throw RuntimeError("Division by zero", line);
+    Array* mapped = new Array();
+    Value result(mapped);
+    mapped->reserve(array.ints.size());
+    mapped->ints.resize(array.ints.size());
+    map_ints(p, mapped->ints.data(), array.ints.size(), op[0], k);
+    return result;
+}
+
+Value builtin_fill(Value* args, int line) {
+    Array& array = array_arg(args[0], "fill", line);
+    if (!array.is_boxed && args[1].type == Value::Type::Int) {
+        std::fill(array.ints.begin(), array.ints.end(), args[1].int_val);
+    } else {
+        check_no_cycle(array, args[1], "an array", line);
+        array.box();
+        std::fill(array.boxed.begin(), array.boxed.end(), args[1]);
+    }
+    return Value();
+}
+
+Value builtin_sort(Value* args, int line) {
+    Array& array = array_arg(args[0], "sort", line);
+    if (!array.is_boxed) {
+        std::sort(array.ints.begin(), array.ints.end());
+        return Value();
+    }
+    for (auto& element : array.boxed) {
+        if (element.type != Value::Type::String) throw RuntimeError("sort needs an array of integers or of strings", line);
+    }
+    std::sort(array.boxed.begin(), array.boxed.end(), [](const Value& a, const Value& b) {
+        int order = std::char_traits<char>::compare(a.str_data(), b.str_data(), std::min(a.str_len, b.str_len));
+        return order != 0 ? order < 0 : a.str_len < b.str_len;
+    });
+    return Value();
+}
+
+// search(a, v) -- index of the first element equal to v, or -1
+Value builtin_search(Value* args, int line) {
+    Array& array = array_arg(args[0], "search", line);
+    if (!array.is_boxed) {
+        if (args[1].type != Value::Type::Int) return Value(-1);
+        return Value(static_cast<int>(search_ints(array.ints.data(), array.ints.size(), args[1].int_val)));
+    }
+    for (size_t i = 0; i < array.boxed.size(); ++i) {
+        if (same_value(array.boxed[i], args[1])) return Value(static_cast<int>(i));
+    }
+    return Value(-1);
+}
+
+// has(d, key) -- 1 when the dictionary holds key
+Value builtin_has(Value* args, int line) {
+    Dict& dict = dict_arg(args[0], "has", line);
+    return Value(dict.find(key_arg(args[1], "has", line)) ? 1 : 0);
+}
+
+// get(d, key, default) -- the value for key, or default when it is missing
+Value builtin_get(Value* args, int line) {
+    Dict& dict = dict_arg(args[0], "get", line);
+    Value* value = dict.find(key_arg(args[1], "get", line));
+    return value ? *value : std::move(args[2]);
+}
+
+// remove(d, key) -- 1 when key was present
+Value builtin_remove(Value* args, int line) {
+    Dict& dict = dict_arg(args[0], "remove", line);
+    return Value(dict.erase(key_arg(args[1], "remove", line)) ? 1 : 0);
+}
+
+// keys(d), values(d) -- new arrays in insertion order
+Value builtin_keys(Value* args, int line) {
+    Dict& dict = dict_arg(args[0], "keys", line);
+    Array* keys = new Array();
+    Value result(keys);
+    for (auto& entry : dict.entries) {
+        if (entry.key.type != Value::Type::Unset) keys->push(entry.key);
+    }
+    return result;
+}
+
+Value builtin_values(Value* args, int line) {
+    Dict& dict = dict_arg(args[0], "values", line);
+    Array* values = new Array();
+    Value result(values);
+    for (auto& entry : dict.entries) {
+        if (entry.key.type != Value::Type::Unset) values->push(entry.value);
+    }
+    return result;
+}
+
+// open_file(path) -- a file to read line by line with has_line/read_line
+Value builtin_open_file(Value* args, int line) {
+    std::string path = string_arg(args[0], "open_file", line).as_string();
+    LineReader* reader = LineReader::open(path);
+    if (!reader) throw RuntimeError("Cannot open file " + path, line);
+    Value result;
+    result.type = Value::Type::File;
+    result.object = ObjectRef(reader);
+    return result;
+}
+
+Value builtin_has_line(Value* args, int line) {
+    return Value(file_arg(args[0], "has_line", line).has_line() ? 1 : 0);
+}
+
+Value builtin_read_line(Value* args, int line) {
+    LineReader& reader = file_arg(args[0], "read_line", line);
+    if (!reader.has_line()) throw RuntimeError("read_line past the end of the file", line);
+    return reader.next_line();
+}
+
+// field(s, i) -- the i-th whitespace-separated field of s, or "" when there
+// are fewer; the result shares s's buffer instead of copying it
+Value builtin_field(Value* args, int line) {
+    Value& text = string_arg(args[0], "field", line);
+    int index = int_arg(args[1], "field", line);
+    const char* p = text.str_data();
+    size_t n = text.str_len, i = 0;
+    for (int f = 0;; ++f) {
+        while (i < n && std::isspace(static_cast<unsigned char>(p[i]))) ++i;
+        if (i == n) return Value(std::string());
+        size_t start = i;
+        while (i < n && !std::isspace(static_cast<unsigned char>(p[i]))) ++i;
+        if (f == index) {
+            Value result = text;
+            result.int_val = NO_SYMBOL;
+            result.str_off += start;
+            result.str_len = i - start;
+            return result;
+        }
+    }
+}
+
+// number(s) -- the integer written at the start of s
+Value builtin_number(Value* args, int line) {
+    Value& text = string_arg(args[0], "number", line);
+    const char* p = text.str_data();
+    size_t n = text.str_len, i = 0;
+    while (i < n && std::isspace(static_cast<unsigned char>(p[i]))) ++i;
+    bool negative = i < n && p[i] == '-';
+    if (negative || (i < n && p[i] == '+')) ++i;
+    if (i == n || !std::isdigit(static_cast<unsigned char>(p[i]))) {
+        throw RuntimeError("number needs a string starting with digits, got \"" + text.as_string() + "\"", line);
+    }
+    unsigned value = 0;
+    for (; i < n && std::isdigit(static_cast<unsigned char>(p[i])); ++i) value = value * 10 + (p[i] - '0');
+    return Value(static_cast<int>(negative ? 0u - value : value));
+}
+
+const Builtin BUILTINS[] = {
+    {"length", 1, builtin_length},
+    {"append", 2, builtin_append},
+    {"array", 2, builtin_array},
+    {"range", 1, builtin_range},
+    {"sum", 1, builtin_sum},
+    {"min", 1, builtin_min},
+    {"max", 1, builtin_max},
+    {"map", 3, builtin_map},
+    {"fill", 2, builtin_fill},
+    {"sort", 1, builtin_sort},
+    {"search", 2, builtin_search},
+    {"has", 2, builtin_has},
+    {"get", 3, builtin_get},
+    {"remove", 2, builtin_remove},
+    {"keys", 1, builtin_keys},
+    {"values", 1, builtin_values},
+    {"open_file", 1, builtin_open_file},
+    {"has_line", 1, builtin_has_line},
+    {"read_line", 1, builtin_read_line},
+    {"field", 2, builtin_field},
+    {"number", 1, builtin_number},
+};
+
+} // namespace
+
+const Builtin* find_builtin(Symbol name) {
+    static const std::unordered_map<Symbol, const Builtin*> table = [] {
+        std::unordered_map<Symbol, const Builtin*> t;
+        for (const Builtin& builtin : BUILTINS) t[SymbolTable::intern(builtin.name)] = &builtin;
+        return t;
+    }();
+    auto it = table.find(name);
+    return it == table.end() ? nullptr : it->second;
+}
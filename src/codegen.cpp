@@ -0,0 +1,510 @@
+#include "codegen.h"
+#include "builtins.h"
+#include "lazy.h"
+
+namespace {
+
+typedef InterpreterVisitor::RuntimeError RuntimeError;
+
+Value& slot_in(ExecutionContext& ctx, int slot) { return ctx.stack[ctx.frames.back().base + slot]; }
+
+bool same_text(const Value& left, const Value& right) {
+    return left.str_len == right.str_len &&
+           std::char_traits<char>::compare(left.str_data(), right.str_data(), left.str_len) == 0;
+}
+
+} // namespace
+
+// Turns one node into a closure. Statements leave `stmt` set; expressions
+// set `expr`, which a statement position wraps and discards.
+class ClosureEngine::Compiler : public ASTVisitor {
+public:
+    explicit Compiler(ClosureEngine& engine) : engine(engine), ctx(engine.ctx) {}
+
+    Expr expr;
+    Stmt stmt;
+
+    void visit(ProgramNode& node) override {
+        auto code = std::make_shared<Code>(engine.statements(node.statements));
+        const FrameLayout* layout = &node.layout;
+        ClosureEngine* e = &engine;
+        ExecutionContext* c = &ctx;
+        stmt = [e, c, code, layout] {
+            e->interpreter.push_frame(*layout, c->stack.size());
+            e->execute(*code);
+            e->interpreter.pop_frame();
+        };
+    }
+    void visit(VarDeclNode& node) override {
+        Expr init = engine.expression(*node.initializer);
+        ExecutionContext* c = &ctx;
+        int slot = node.slot;
+        if (node.type != "integer" || node.int_proven) {
+            stmt = [c, init, slot] { slot_in(*c, slot) = init(); };
+            return;
+        }
+        Symbol name = node.name;
+        int line = node.line;
+        stmt = [c, init, slot, name, line] {
+            Value value = init();
+            if (value.type != Value::Type::Int) throw RuntimeError("Expected integer for variable " + symbol_name(name), line);
+            slot_in(*c, slot) = std::move(value);
+        };
+    }
+    void visit(LetConstDeclNode& node) override {
+        Expr init = engine.expression(*node.initializer);
+        ExecutionContext* c = &ctx;
+        int slot = node.slot;
+        stmt = [c, init, slot] { slot_in(*c, slot) = init(); };
+    }
+    void visit(IfNode& node) override {
+        std::vector<Expr> conditions;
+        std::vector<Stmt> branches;
+        conditions.push_back(engine.expression(*node.condition));
+        branches.push_back(compile(*node.then_block));
+        for (auto& else_if : node.else_if_blocks) {
+            conditions.push_back(engine.expression(*else_if.first));
+            branches.push_back(compile(*else_if.second));
+        }
+        Stmt otherwise = node.else_block ? compile(*node.else_block) : Stmt();
+        InterpreterVisitor* i = &engine.interpreter;
+        stmt = [i, conditions, branches, otherwise] {
+            for (size_t k = 0; k < conditions.size(); ++k) {
+                if (i->to_bool(conditions[k]())) {
+                    branches[k]();
+                    return;
+                }
+            }
+            if (otherwise) otherwise();
+        };
+    }
+    void visit(ChooseNode& node) override {
+        Expr subject = engine.expression(*node.subject);
+        std::vector<Stmt> branches;
+        for (auto& body : node.cases) branches.push_back(compile(*body));
+        Stmt otherwise = node.otherwise ? compile(*node.otherwise) : Stmt();
+        const ChooseNode* n = &node;
+        stmt = [subject, branches, otherwise, n] {
+            Value value = subject();
+            int target = ChooseNode::NO_CASE;
+            if (value.type == Value::Type::Int) {
+                target = n->find(value.int_val);
+            } else if (value.type == Value::Type::String) {
+                target = n->find(value.str_data(), value.str_len, static_cast<Symbol>(value.int_val));
+            }
+            if (target != ChooseNode::NO_CASE) {
+                branches[target]();
+            } else if (otherwise) {
+                otherwise();
+            }
+        };
+    }
+    void visit(WhileNode& node) override {
+        Expr condition = engine.expression(*node.condition);
+        auto code = std::make_shared<Code>(engine.statements(node.body->statements));
+        ClosureEngine* e = &engine;
+        ExecutionContext* c = &ctx;
+        int line = node.line;
+        stmt = [e, c, condition, code, line] {
+            while (e->interpreter.to_bool(condition())) {
+                e->execute(*code);
+                if (c->returning) return;
+                if (c->yield_points) c->yield_points->safepoint();
+                e->interpreter.tick(line);
+            }
+        };
+    }
+    void visit(PrintNode& node) override {
+        Expr value = engine.expression(*node.expression);
+        ExecutionContext* c = &ctx;
+        stmt = [c, value] {
+            Value val = value();
+            if (val.type == Value::Type::String) {
+                c->out.write(val.str_data(), val.str_len) << "\n";
+            } else if (val.type == Value::Type::Array || val.type == Value::Type::Dict) {
+                c->out << val.as_string() << "\n";
+            } else {
+                c->out << val.as_int() << "\n";
+            }
+        };
+    }
+    void visit(YieldNode& node) override {
+        Expr value = engine.expression(*node.expression);
+        ExecutionContext* c = &ctx;
+        stmt = [c, value] {
+            c->return_value = value();
+            c->returning = true;
+        };
+    }
+    void visit(AssignmentNode& node) override {
+        Expr value = engine.expression(*node.value);
+        ExecutionContext* c = &ctx;
+        int slot = node.slot;
+        if (node.field < 0) {
+            stmt = [c, value, slot] { slot_in(*c, slot) = value(); };
+            return;
+        }
+        int field = node.field;
+        stmt = [c, value, slot, field] {
+            Value val = value();
+            if (c->self) {
+                val.own_text();
+                c->self->fields()[field] = std::move(val);
+            } else {
+                slot_in(*c, slot) = std::move(val);
+            }
+        };
+    }
+
+    void visit(NumberNode& node) override {
+        int n = node.value;
+        expr = [n] { return Value(n); };
+    }
+    void visit(StringNode& node) override {
+        Symbol symbol = node.value;
+        expr = [symbol] {
+            Value text(symbol_name(symbol));
+            text.int_val = symbol; // Dictionary keys hash literals through the symbol table
+            return text;
+        };
+    }
+    void visit(BooleanNode& node) override {
+        int n = node.value ? 1 : 0;
+        expr = [n] { return Value(n); };
+    }
+    void visit(IdentifierNode& node) override {
+        ExecutionContext* c = &ctx;
+        InterpreterVisitor* i = &engine.interpreter;
+        Symbol name = node.name;
+        int slot = node.slot, line = node.line;
+        Expr unqualified;
+        if (node.assigned) {
+            unqualified = [c, slot] { return slot_in(*c, slot); };
+        } else {
+            unqualified = [i, name, slot, line] {
+                Value* value = i->lookup(name, slot);
+                if (!value) throw RuntimeError("Undefined variable " + symbol_name(name), line);
+                return *value;
+            };
+        }
+        if (node.field < 0) {
+            expr = unqualified;
+            return;
+        }
+        // A blueprint field name: inside a method it reads the receiver.
+        int field = node.field;
+        expr = [c, field, unqualified] { return c->self ? c->self->fields()[field] : unqualified(); };
+    }
+    void visit(BinaryOpNode& node) override {
+        typedef BinaryOpNode::Kind Kind;
+        Expr l = engine.expression(*node.left);
+        Expr r = engine.expression(*node.right);
+        int line = node.line;
+        switch (node.kind) {
+            case Kind::IntAdd: expr = [l, r] { return Value(l().int_val + r().int_val); }; return;
+            case Kind::IntSub: expr = [l, r] { return Value(l().int_val - r().int_val); }; return;
+            case Kind::IntMul: expr = [l, r] { return Value(l().int_val * r().int_val); }; return;
+            case Kind::IntDiv:
+                expr = [l, r, line] {
+                    int a = l().int_val, b = r().int_val;
+                    if (b == 0) throw RuntimeError("Division by zero", line);
+                    return Value(a / b);
+                };
+                return;
+            case Kind::IntLessEqual: expr = [l, r] { return Value(l().int_val <= r().int_val ? 1 : 0); }; return;
+            case Kind::IntNotLess: expr = [l, r] { return Value(l().int_val >= r().int_val ? 1 : 0); }; return;
+            case Kind::IntGreater: expr = [l, r] { return Value(l().int_val > r().int_val ? 1 : 0); }; return;
+            case Kind::IntEqual: expr = [l, r] { return Value(l().int_val == r().int_val ? 1 : 0); }; return;
+            case Kind::Concat:
+                expr = [l, r] {
+                    Value a = l();
+                    return Value::concat(a, r());
+                };
+                return;
+            case Kind::StringEqual:
+                expr = [l, r] {
+                    Value a = l();
+                    return Value(same_text(a, r()) ? 1 : 0);
+                };
+                return;
+            case Kind::Generic: break;
+        }
+        // Operands evaluate left to right, as in InterpreterVisitor.
+        const std::string& op = node.op;
+        InterpreterVisitor* i = &engine.interpreter;
+        if (op == "+") {
+            expr = [l, r] {
+                Value a = l();
+                Value b = r();
+                if (a.type == Value::Type::String || b.type == Value::Type::String) return Value::concat(a, b);
+                return Value(a.as_int() + b.as_int());
+            };
+        } else if (op == "-") {
+            expr = [l, r] { Value a = l(); return Value(a.as_int() - r().as_int()); };
+        } else if (op == "<=") {
+            expr = [l, r] { Value a = l(); return Value(a.as_int() <= r().as_int() ? 1 : 0); };
+        } else if (op == "!<") {
+            expr = [l, r] { Value a = l(); return Value(a.as_int() >= r().as_int() ? 1 : 0); };
+        } else if (op == ">") {
+            expr = [l, r] { Value a = l(); return Value(a.as_int() > r().as_int() ? 1 : 0); };
+        } else if (op == "==") {
+            expr = [l, r] {
+                Value a = l();
+                Value b = r();
+                if (a.type == Value::Type::String && b.type == Value::Type::String) return Value(same_text(a, b) ? 1 : 0);
+                return Value(a.as_int() == b.as_int() ? 1 : 0);
+            };
+        } else if (op == "*") {
+            expr = [l, r] { Value a = l(); return Value(a.as_int() * r().as_int()); };
+        } else if (op == "/") {
+            expr = [l, r, line] {
+                Value a = l();
+                Value b = r();
+                if (b.as_int() == 0) throw RuntimeError("Division by zero", line);
+                return Value(a.as_int() / b.as_int());
+            };
+        } else if (op == "&&") {
+            expr = [i, l, r] {
+                Value a = l();
+                Value b = r();
+                return Value(i->to_bool(a) && i->to_bool(b) ? 1 : 0);
+            };
+        } else {
+            expr = [l, r, op, line]() -> Value {
+                l();
+                r();
+                throw RuntimeError("Invalid operation " + op, line);
+            };
+        }
+    }
+    void visit(CallNode& node) override {
+        auto arguments = std::make_shared<std::vector<Expr>>();
+        for (auto& arg : node.arguments) arguments->push_back(engine.expression(*arg));
+        if (node.receiver == NO_SYMBOL) {
+            plain_call(node, arguments);
+        } else {
+            method_call(node, arguments);
+        }
+    }
+    void visit(InlinedCallNode& node) override {
+        auto bindings = std::make_shared<std::vector<Stmt>>();
+        for (auto& binding : node.bindings) bindings->push_back(compile_statement(*binding));
+        Expr result = engine.expression(*node.result);
+        InterpreterVisitor* i = &engine.interpreter;
+        Symbol receiver = node.receiver;
+        int slot = node.receiver_slot, line = node.line;
+        expr = [i, receiver, slot, line, bindings, result] {
+            if (receiver != NO_SYMBOL) i->receiver(receiver, slot, line);
+            for (auto& binding : *bindings) binding();
+            return result();
+        };
+    }
+    void visit(FieldAccessNode& node) override {
+        InterpreterVisitor* i = &engine.interpreter;
+        Symbol receiver = node.receiver, field = node.field;
+        int slot = node.receiver_slot, offset = node.offset, line = node.line;
+        expr = [i, receiver, field, slot, offset, line] {
+            Instance& object = i->receiver(receiver, slot, line);
+            return object.fields()[i->field_offset(object, field, offset, line)];
+        };
+    }
+
+    // No compiled form: the tree interpreter runs these on the same context.
+    void visit(BlueprintNode& node) override { interpreted(node); }
+    void visit(FunctionNode& node) override { interpreted(node); }
+    void visit(ParallelForNode& node) override { interpreted(node); }
+    void visit(AccumulateNode& node) override { interpreted(node); }
+    void visit(InputNode& node) override { interpreted(node); }
+    void visit(InstanceNode& node) override { interpreted(node); }
+    void visit(ImportNode& node) override { interpreted(node); }
+    void visit(FieldAssignmentNode& node) override { interpreted(node); }
+    void visit(ArrayLiteralNode& node) override { interpreted(node); }
+    void visit(DictLiteralNode& node) override { interpreted(node); }
+    void visit(IndexNode& node) override { interpreted(node); }
+    void visit(IndexAssignmentNode& node) override { interpreted(node); }
+
+private:
+    ClosureEngine& engine;
+    ExecutionContext& ctx;
+
+    Stmt compile(ProgramNode& block) {
+        block.accept(*this);
+        return stmt;
+    }
+    Stmt compile_statement(ASTNode& node) {
+        Compiler compiler(engine);
+        node.accept(compiler);
+        return compiler.stmt;
+    }
+    void interpreted(ASTNode& node) {
+        InterpreterVisitor* i = &engine.interpreter;
+        ASTNode* n = &node;
+        expr = [i, n] { return i->evaluate(n); };
+    }
+
+    // Script functions shadow builtins once defined, so the function table
+    // is still consulted on every call; the compiled body of the function
+    // found last time is kept.
+    void plain_call(CallNode& node, std::shared_ptr<std::vector<Expr>> arguments) {
+        struct Site {
+            FunctionNode* function = nullptr;
+            const Code* code = nullptr;
+        };
+        auto site = std::make_shared<Site>();
+        ClosureEngine* e = &engine;
+        ExecutionContext* c = &ctx;
+        Symbol name = node.name;
+        int line = node.line;
+        const Builtin* builtin = find_builtin(name);
+        expr = [e, c, site, arguments, name, line, builtin] {
+            auto it = c->functions.find(name);
+            if (it != c->functions.end()) {
+                if (it->second != site->function) {
+                    site->function = it->second;
+                    site->code = &e->body(*it->second);
+                }
+                return e->call(*site->function, *site->code, *arguments, line, nullptr);
+            }
+            if (!builtin) throw RuntimeError("Undefined function " + symbol_name(name), line);
+            if (builtin->arity != arguments->size()) {
+                throw RuntimeError(std::string(builtin->name) + " expects " + std::to_string(builtin->arity) +
+                                   " arguments, got " + std::to_string(arguments->size()), line);
+            }
+            Value args[3];
+            for (size_t k = 0; k < arguments->size(); ++k) args[k] = (*arguments)[k]();
+            return builtin->call(args, line);
+        };
+    }
+
+    // The method is found by scanning the blueprint's body once per
+    // blueprint seen at this call site, not on every call.
+    void method_call(CallNode& node, std::shared_ptr<std::vector<Expr>> arguments) {
+        struct Site {
+            const BlueprintNode* blueprint = nullptr;
+            FunctionNode* method = nullptr;
+            const Code* code = nullptr;
+        };
+        auto site = std::make_shared<Site>();
+        ClosureEngine* e = &engine;
+        ExecutionContext* c = &ctx;
+        Symbol receiver = node.receiver, name = node.name;
+        int slot = node.receiver_slot, line = node.line;
+        expr = [e, c, site, arguments, receiver, name, slot, line] {
+            Instance& object = e->interpreter.receiver(receiver, slot, line);
+            auto it = c->blueprints.find(object.blueprint);
+            if (it == c->blueprints.end()) throw RuntimeError("Unknown blueprint " + symbol_name(object.blueprint), line);
+            if (it->second != site->blueprint) {
+                site->blueprint = it->second;
+                site->method = nullptr;
+                for (auto& stmt : it->second->body) {
+                    auto* method = dynamic_cast<FunctionNode*>(stmt.get());
+                    if (method && method->name == name) {
+                        site->method = method;
+                        site->code = &e->body(*method);
+                        break;
+                    }
+                }
+            }
+            if (!site->method) {
+                site->blueprint = nullptr;
+                throw RuntimeError("Method " + symbol_name(name) + " not found in " + symbol_name(object.blueprint), line);
+            }
+            return e->call(*site->method, *site->code, *arguments, line, &object);
+        };
+    }
+};
+
+ClosureEngine::ClosureEngine(ExecutionContext& context) : ctx(context), interpreter(context) {}
+ClosureEngine::~ClosureEngine() {}
+
+ClosureEngine::Expr ClosureEngine::expression(ASTNode& node) {
+    Compiler compiler(*this);
+    node.accept(compiler);
+    if (compiler.expr) return compiler.expr;
+    Stmt stmt = compiler.stmt;
+    return [stmt] {
+        stmt();
+        return Value();
+    };
+}
+
+ClosureEngine::Code ClosureEngine::statements(const std::vector<std::unique_ptr<ASTNode>>& nodes) {
+    Code code;
+    for (auto& node : nodes) {
+        Compiler compiler(*this);
+        node->accept(compiler);
+        if (compiler.stmt) {
+            code.stmts.push_back(compiler.stmt);
+        } else {
+            Expr expr = compiler.expr;
+            code.stmts.push_back([expr] { expr(); });
+        }
+        code.lines.push_back(node->line);
+    }
+    return code;
+}
+
+const ClosureEngine::Code& ClosureEngine::body(FunctionNode& function) {
+    std::unique_ptr<Code>& code = bodies[&function];
+    if (!code) {
+        ensure_parsed(function);
+        code.reset(new Code(statements(function.body)));
+    }
+    return *code;
+}
+
+// Runs statements in the current frame, stopping early once one of them yields.
+// A memory limit hit inside is reported at the innermost statement, as InterpreterVisitor::execute().
+void ClosureEngine::execute(const Code& code) {
+    size_t i = 0;
+    try {
+        for (; i < code.stmts.size(); ++i) {
+            code.stmts[i]();
+            if (ctx.returning) return;
+        }
+    } catch (const HeapQuota::Exceeded& e) {
+        throw RuntimeError(e.what(), code.lines[i]);
+    }
+}
+
+// As InterpreterVisitor::invoke(): arguments become the callee's first slots.
+Value ClosureEngine::call(FunctionNode& function, const Code& code, const std::vector<Expr>& arguments, int line,
+                          Instance* self) {
+    if (function.parameters.size() != arguments.size()) {
+        throw RuntimeError("Expected " + std::to_string(function.parameters.size()) + " arguments, got " +
+                           std::to_string(arguments.size()), line);
+    }
+    if (StackGuard::exhausted()) throw RuntimeError("Call depth limit exceeded", line);
+    size_t base = ctx.stack.size();
+    for (auto& arg : arguments) ctx.stack.push_back(arg());
+    if (ctx.yield_points) ctx.yield_points->safepoint();
+    interpreter.tick(line);
+    Symbol old_scope = ctx.current_scope;
+    Instance* old_self = ctx.self;
+    if (self) {
+        ctx.current_scope = self->blueprint;
+        ctx.self = self;
+    }
+    interpreter.push_frame(function.layout, base, self);
+    execute(code);
+    interpreter.pop_frame();
+    ctx.current_scope = old_scope;
+    ctx.self = old_self;
+    if (!ctx.returning) return Value();
+    ctx.returning = false;
+    return std::move(ctx.return_value);
+}
+
+void ClosureEngine::run(ProgramNode& program) {
+    Code code = statements(program.statements);
+    interpreter.push_frame(program.layout, ctx.stack.size());
+    execute(code);
+    interpreter.pop_frame();
+}
+
+void ClosureEngine::run_module(ProgramNode& module) {
+    Code code = statements(module.statements);
+    interpreter.push_frame(module.layout, ctx.stack.size());
+    execute(code);
+    ctx.returning = false;
+}
@@ -0,0 +1,130 @@
+#include "interpreter.h"
+
+#include <algorithm>
+
+namespace {
+
+const size_t NOT_FOUND = static_cast<size_t>(-1);
+const size_t MIN_BUCKETS = 8;
+
+// Keys compare by type first; interned strings compare by symbol, others by bytes.
+bool same_key(const Value& a, const Value& b) {
+    if (a.type != b.type) return false;
+    if (a.type == Value::Type::Int) return a.int_val == b.int_val;
+    if (a.int_val != NO_SYMBOL && b.int_val != NO_SYMBOL) return a.int_val == b.int_val;
+    return a.str_len == b.str_len && std::char_traits<char>::compare(a.str_data(), b.str_data(), a.str_len) == 0;
+}
+
+} // namespace
+
+// Interned strings reuse the hash stored with their symbol, which is the
+// same hash_bytes() value a built string with that text would get.
+uint32_t Dict::hash_key(const Value& key) {
+    uint64_t h;
+    if (key.type == Value::Type::Int) {
+        h = static_cast<uint32_t>(key.int_val) * 0x9e3779b97f4a7c15ull;
+        h ^= h >> 32;
+    } else if (key.int_val != NO_SYMBOL) {
+        h = SymbolTable::hash(static_cast<Symbol>(key.int_val));
+    } else {
+        h = hash_bytes(key.str_data(), key.str_len);
+    }
+    return static_cast<uint32_t>(h);
+}
+
+// Robin Hood keeps every probe run ordered by distance from the home bucket,
+// so a lookup can stop as soon as it passes a bucket closer to home than the
+// key would be.
+size_t Dict::find_bucket(const Value& key, uint32_t hash) const {
+    if (buckets.empty()) return NOT_FOUND;
+    size_t mask = buckets.size() - 1;
+    size_t pos = hash & mask;
+    for (size_t distance = 0;; ++distance) {
+        const Bucket& bucket = buckets[pos];
+        if (bucket.entry == EMPTY) return NOT_FOUND;
+        if (((pos - bucket.hash) & mask) < distance) return NOT_FOUND;
+        if (bucket.hash == hash && same_key(entries[bucket.entry].key, key)) return pos;
+        pos = (pos + 1) & mask;
+    }
+}
+
+void Dict::place(Bucket bucket) {
+    size_t mask = buckets.size() - 1;
+    size_t pos = bucket.hash & mask;
+    for (size_t distance = 0;; ++distance) {
+        Bucket& slot = buckets[pos];
+        if (slot.entry == EMPTY) {
+            slot = bucket;
+            return;
+        }
+        size_t slot_distance = (pos - slot.hash) & mask;
+        if (slot_distance < distance) {
+            std::swap(slot, bucket);
+            distance = slot_distance;
+        }
+        pos = (pos + 1) & mask;
+    }
+}
+
+// Drops deleted entries and rebuilds the buckets at the given capacity.
+void Dict::rehash(size_t capacity) {
+    size_t kept = 0;
+    for (size_t i = 0; i < entries.size(); ++i) {
+        if (entries[i].key.type == Value::Type::Unset) continue;
+        if (kept != i) entries[kept] = std::move(entries[i]);
+        ++kept;
+    }
+    entries.resize(kept);
+    entries.reserve(capacity / 8 * 7);
+    buckets.assign(capacity, Bucket{0, EMPTY});
+    for (size_t i = 0; i < entries.size(); ++i) place(Bucket{entries[i].hash, static_cast<uint32_t>(i)});
+}
+
+// Counts the entry and bucket capacity after it grew.
+void Dict::account() {
+    charged.update(entries.capacity() * sizeof(Entry) + buckets.capacity() * sizeof(Bucket));
+}
+
+Value* Dict::find(const Value& key) {
+    size_t pos = find_bucket(key, hash_key(key));
+    return pos == NOT_FOUND ? nullptr : &entries[buckets[pos].entry].value;
+}
+
+Value& Dict::insert(const Value& key) {
+    uint32_t hash = hash_key(key);
+    size_t pos = find_bucket(key, hash);
+    if (pos != NOT_FOUND) return entries[buckets[pos].entry].value;
+
+    // Grow past 7/8 full; compact in place when deleted entries pile up.
+    size_t capacity = std::max(buckets.size(), MIN_BUCKETS);
+    while ((live + 1) * 8 > capacity * 7) capacity *= 2;
+    if (capacity != buckets.size() || entries.size() >= 2 * live + MIN_BUCKETS) rehash(capacity);
+
+    entries.push_back(Entry{key, Value(), hash});
+    entries.back().key.own_text();
+    place(Bucket{hash, static_cast<uint32_t>(entries.size() - 1)});
+    ++live;
+    account();
+    return entries.back().value;
+}
+
+// Backward-shift deletion: later buckets of the probe run move one step
+// closer to home, so no tombstones are left in the bucket array.
+bool Dict::erase(const Value& key) {
+    size_t pos = find_bucket(key, hash_key(key));
+    if (pos == NOT_FOUND) return false;
+    Entry& entry = entries[buckets[pos].entry];
+    entry.key = Value::unset();
+    entry.value = Value();
+    --live;
+
+    size_t mask = buckets.size() - 1;
+    size_t next = (pos + 1) & mask;
+    while (buckets[next].entry != EMPTY && ((next - buckets[next].hash) & mask) != 0) {
+        buckets[pos] = buckets[next];
+        pos = next;
+        next = (next + 1) & mask;
+    }
+    buckets[pos].entry = EMPTY;
+    return true;
+}
@@ -0,0 +1,78 @@
+#include "files.h"
+
+#include <algorithm>
+#include <cstring>
+
+LineReader* LineReader::open(const std::string& path) {
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) return nullptr;
+    std::setvbuf(file, nullptr, _IONBF, 0); // Chunks are read straight into our buffer
+    return new LineReader(file);
+}
+
+LineReader::~LineReader() {
+    std::fclose(file);
+}
+
+bool LineReader::has_line() {
+    for (;;) {
+        if (line_end != NO_LINE) return true;
+        if (chunk) {
+            const char* data = chunk->data.data();
+            const void* newline = std::memchr(data + pos, '\n', end - pos);
+            if (newline) {
+                line_end = static_cast<const char*>(newline) - data;
+                return true;
+            }
+        }
+        if (eof) {
+            if (pos == end) return false;
+            line_end = end; // Last line without a newline
+            return true;
+        }
+        refill();
+    }
+}
+
+Value LineReader::next_line() {
+    Value line;
+    line.type = Value::Type::String;
+    line.str_buf = chunk;
+    line.str_off = pos;
+    line.str_len = line_end - pos;
+    if (line.str_len && chunk->data[line_end - 1] == '\r') --line.str_len;
+    pos = std::min(line_end + 1, end);
+    line_end = NO_LINE;
+    return line;
+}
+
+// Moves the unread tail of the chunk to the front of a buffer with room for
+// more, then reads as much as fits. The current chunk is reused when no line
+// still refers to it; a line longer than half a chunk doubles the size.
+void LineReader::refill() {
+    size_t left = end - pos;
+    size_t capacity = chunk ? chunk->data.size() : CHUNK_SIZE;
+    if (left > capacity / 2) capacity *= 2;
+
+    std::shared_ptr<StringBuffer> target;
+    if (chunk && chunk.use_count() == 1 && chunk->data.size() == capacity) {
+        target = chunk;
+        std::memmove(&target->data[0], target->data.data() + pos, left);
+    } else {
+        if (spare && spare.use_count() == 1 && spare->data.size() == capacity) {
+            target = spare;
+        } else {
+            target = std::make_shared<StringBuffer>();
+            target->data.resize(capacity);
+        }
+        if (left) std::memcpy(&target->data[0], chunk->data.data() + pos, left);
+        spare = chunk;
+        chunk = target;
+    }
+
+    size_t wanted = capacity - left;
+    size_t got = std::fread(&chunk->data[left], 1, wanted, file);
+    if (got < wanted) eof = true;
+    pos = 0;
+    end = left + got;
+}
@@ -0,0 +1,292 @@
+#include "green.h"
+#include "batch.h"
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+thread_local GreenScheduler* running_scheduler = nullptr;
+
+// Resident set size in bytes, or 0 where it cannot be read cheaply.
+size_t resident_bytes() {
+#ifdef __linux__
+    std::ifstream statm("/proc/self/statm");
+    size_t pages = 0, resident = 0;
+    if (statm >> pages >> resident) return resident * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+    return 0;
+}
+
+} // namespace
+
+GreenTask::GreenTask(GreenScheduler& owner, int task_id, std::shared_ptr<const Program> p)
+    : id(task_id), program(p), scheduler(owner), context(out, in) {
+    context.yield_points = this;
+    context.parallel_workers = 1; // A green task never blocks its thread on a pool
+}
+
+GreenTask::~GreenTask() {
+    scheduler.release_stack(*this);
+}
+
+bool GreenTask::input_ready() const {
+    return input_closed || inbox.find('\n') != std::string::npos;
+}
+
+void GreenTask::note_stack_depth() {
+#ifndef _WIN32
+    char marker;
+    size_t used = static_cast<size_t>((stack + stack_size) - &marker);
+    if (used > stack_high_water) stack_high_water = used;
+#endif
+}
+
+void GreenTask::suspend(State next) {
+    state = next;
+    switches++;
+    note_stack_depth();
+#ifdef _WIN32
+    SwitchToFiber(scheduler.main_fiber);
+#else
+    swapcontext(&uctx, &scheduler.main_uctx);
+#endif
+}
+
+void GreenTask::safepoint() {
+    if (slice_left > 1) {
+        slice_left--;
+        return;
+    }
+    suspend(State::Ready);
+}
+
+void GreenTask::wait_for_input() {
+    while (!input_ready()) suspend(State::WaitingInput);
+    size_t newline = inbox.find('\n');
+    size_t n = newline == std::string::npos ? inbox.size() : newline + 1;
+    in.clear();
+    in << inbox.substr(0, n);
+    inbox.erase(0, n);
+}
+
+void GreenTask::entry() {
+    GreenTask& task = *running_scheduler->current;
+#ifdef _WIN32
+    char marker; // A fiber's stack bounds are not exposed; it starts near the top of stack_bytes
+    task.stack_floor = StackGuard::floor_for(&marker - task.scheduler.stack_bytes, task.scheduler.stack_bytes);
+    StackGuard::floor = task.stack_floor;
+#endif
+    try {
+        task.program->run(task.context);
+    } catch (const std::exception& e) {
+        task.error = e.what();
+    }
+    task.state = State::Done;
+#ifdef _WIN32
+    SwitchToFiber(task.scheduler.main_fiber);
+#endif
+    // With ucontext, returning continues at uc_link, i.e. back in resume().
+}
+
+#ifdef _WIN32
+void CALLBACK GreenTask::fiber_entry(LPVOID) { entry(); }
+#endif
+
+GreenScheduler::GreenScheduler(size_t stack_size, unsigned slice)
+    : stack_bytes(stack_size), slice_steps(slice == 0 ? 1 : slice) {
+#ifdef _WIN32
+    main_fiber = ConvertThreadToFiber(nullptr);
+    if (!main_fiber) main_fiber = GetCurrentFiber();
+#endif
+}
+
+GreenScheduler::~GreenScheduler() {
+    all.clear();
+}
+
+GreenTask& GreenScheduler::spawn(std::shared_ptr<const Program> program) {
+    all.emplace_back(new GreenTask(*this, static_cast<int>(all.size()), program));
+    return *all.back();
+}
+
+void GreenScheduler::feed(GreenTask& task, const std::string& text) {
+    task.inbox += text;
+}
+
+void GreenScheduler::close_input(GreenTask& task) {
+    task.input_closed = true;
+}
+
+// Stacks are reserved on first resume and released as soon as a task ends,
+// so tasks that have not started or have finished cost no stack memory.
+void GreenScheduler::resume(GreenTask& task) {
+    current = &task;
+    task.slice_left = slice_steps;
+    task.state = GreenTask::State::Ready;
+    GreenScheduler* outer = running_scheduler;
+    running_scheduler = this;
+    // Runaway recursion fails the task with an error before it reaches the guard page.
+    uintptr_t outer_floor = StackGuard::floor;
+    StackGuard::floor = task.stack_floor;
+    // Each task charges its own heap budget, which its run sets current on this thread.
+    HeapBudget* outer_budget = HeapQuota::current;
+    HeapQuota::current = task.heap_budget;
+#ifdef _WIN32
+    if (!task.fiber) {
+        task.fiber = CreateFiber(stack_bytes, &GreenTask::fiber_entry, nullptr);
+        if (!task.fiber) throw std::runtime_error("Cannot create green task");
+    }
+    SwitchToFiber(task.fiber);
+#else
+    if (!task.stack) {
+        long page = sysconf(_SC_PAGESIZE);
+        size_t size = (stack_bytes + page - 1) / page * page + page;
+        void* mem = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (mem == MAP_FAILED) throw std::runtime_error("Cannot allocate green task stack");
+        mprotect(mem, page, PROT_NONE); // Guard page: overflow faults instead of corrupting memory
+        task.stack = static_cast<char*>(mem);
+        task.stack_size = size;
+        getcontext(&task.uctx);
+        task.uctx.uc_stack.ss_sp = task.stack + page;
+        task.uctx.uc_stack.ss_size = size - page;
+        task.stack_floor = StackGuard::floor_for(task.stack + page, size - page);
+        StackGuard::floor = task.stack_floor;
+        task.uctx.uc_link = &main_uctx;
+        makecontext(&task.uctx, &GreenTask::entry, 0);
+    }
+    swapcontext(&main_uctx, &task.uctx);
+#endif
+    StackGuard::floor = outer_floor;
+    task.heap_budget = HeapQuota::current;
+    HeapQuota::current = outer_budget;
+    running_scheduler = outer;
+    current = nullptr;
+    if (task.state == GreenTask::State::Done) release_stack(task);
+}
+
+void GreenScheduler::release_stack(GreenTask& task) {
+#ifdef _WIN32
+    if (task.fiber) DeleteFiber(task.fiber);
+    task.fiber = nullptr;
+#else
+    if (task.stack) munmap(task.stack, task.stack_size);
+    task.stack = nullptr;
+#endif
+}
+
+void GreenScheduler::run(const std::function<bool()>& poll) {
+    std::deque<GreenTask*> live;
+    for (auto& t : all) {
+        if (t->state != GreenTask::State::Done) live.push_back(t.get());
+    }
+    bool polling = static_cast<bool>(poll);
+    while (!live.empty()) {
+        if (polling) polling = poll();
+        bool progressed = false;
+        for (size_t n = live.size(); n > 0; --n) {
+            GreenTask* task = live.front();
+            live.pop_front();
+            if (task->state == GreenTask::State::Ready || task->input_ready()) {
+                resume(*task);
+                progressed = true;
+            }
+            if (task->state != GreenTask::State::Done) live.push_back(task);
+        }
+        rounds++;
+        if (!progressed && !polling) {
+            // No more input will ever arrive: let waiting readers see end of input.
+            for (auto* task : live) task->input_closed = true;
+        }
+    }
+}
+
+int run_green(const GreenOptions& options) {
+    std::vector<std::shared_ptr<const Program>> programs;
+    std::vector<std::vector<std::string>> inputs;
+    try {
+        for (auto& path : collect_scripts(options.target)) {
+            try {
+                programs.push_back(load_program(path, options.inline_small));
+            } catch (const std::exception& e) {
+                std::cerr << "Skipping " << path << ": " << e.what() << std::endl;
+                continue;
+            }
+            inputs.push_back(std::vector<std::string>());
+            std::ifstream in(path.substr(0, path.size() - 3) + ".in");
+            std::string line;
+            while (std::getline(in, line)) inputs.back().push_back(line + "\n");
+        }
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    if (programs.empty()) {
+        std::cerr << "No .as files in " << options.target << std::endl;
+        return 1;
+    }
+
+    size_t rss_before = resident_bytes();
+    GreenScheduler scheduler(options.stack_kb * 1024, options.slice);
+    std::vector<size_t> input_of;
+    for (int c = 0; c < std::max(options.copies, 1); ++c) {
+        for (size_t p = 0; p < programs.size(); ++p) {
+            scheduler.spawn(programs[p]);
+            input_of.push_back(p);
+        }
+    }
+
+    // Deliver one line of input per task per round, as if it were arriving over time.
+    size_t round = 0, rss_peak = rss_before;
+    auto poll = [&]() {
+        bool more = false;
+        for (auto& task : scheduler.tasks()) {
+            const std::vector<std::string>& lines = inputs[input_of[task->id]];
+            if (round < lines.size()) scheduler.feed(*task, lines[round]);
+            if (round + 1 < lines.size()) more = true;
+            else scheduler.close_input(*task);
+        }
+        rss_peak = std::max(rss_peak, resident_bytes());
+        round++;
+        return more;
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    scheduler.run(poll);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    size_t failed = 0, stack_max = 0, stack_total = 0;
+    unsigned long switches = 0;
+    for (auto& task : scheduler.tasks()) {
+        if (!task->error.empty()) failed++;
+        stack_max = std::max(stack_max, task->stack_high_water);
+        stack_total += task->stack_high_water;
+        switches += task->switches;
+        if (options.show_output) {
+            std::cout << "=== " << task->program->name << " (task " << task->id << ")\n" << task->out.str();
+            if (!task->error.empty()) std::cout << "error: " << task->error << "\n";
+        }
+    }
+
+    size_t count = scheduler.tasks().size();
+    char line[200];
+    std::snprintf(line, sizeof(line), "Green: %zu tasks (%zu failed) on 1 thread, %lu rounds, %lu switches in %.3f ms, %.1f tasks/s",
+                  count, failed, scheduler.rounds, switches, elapsed.count() * 1000.0, count / elapsed.count());
+    std::cout << line << std::endl;
+    std::snprintf(line, sizeof(line), "Memory: %zu KiB stack reserved per task, stack high-water max %zu / avg %zu bytes, task object %zu bytes",
+                  options.stack_kb, stack_max, stack_total / count, sizeof(GreenTask));
+    std::cout << line << std::endl;
+    if (rss_before) {
+        std::snprintf(line, sizeof(line), "        peak RSS +%zu KiB while running (%zu bytes per task)",
+                      (rss_peak - rss_before) / 1024, (rss_peak - rss_before) / count);
+        std::cout << line << std::endl;
+    }
+    return failed == 0 ? 0 : 2;
+}
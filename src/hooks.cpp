@@ -0,0 +1,126 @@
+#include "hooks.h"
+#include <algorithm>
+#include <sstream>
+#include <vector>
+
+namespace {
+
+const char* type_name(Value::Type type) {
+    switch (type) {
+        case Value::Type::String: return "string";
+        case Value::Type::Array: return "array";
+        case Value::Type::Dict: return "dict";
+        case Value::Type::Instance: return "instance";
+        default: return "other";
+    }
+}
+
+// Node kind as to_string() names it, e.g. "While" for While(""). Let and
+// const declarations are one node class, so they are counted together.
+std::string kind_name(const ASTNode& node) {
+    if (dynamic_cast<const LetConstDeclNode*>(&node)) return "LetConstDecl";
+    std::string text = to_string(node);
+    return text.substr(0, text.find('('));
+}
+
+std::string show(const Value& value) {
+    if (value.type == Value::Type::String) return "\"" + value.as_string() + "\"";
+    return value.as_string();
+}
+
+// The variable `name` resolves to, searching frames innermost first as
+// InterpreterVisitor::lookup() does.
+const Value* find_variable(ExecutionContext& ctx, Symbol name) {
+    for (size_t f = ctx.frames.size(); f-- > 0;) {
+        const Frame& frame = ctx.frames[f];
+        int slot = frame.layout->find(name);
+        if (slot >= 0 && ctx.stack[frame.base + slot].type != Value::Type::Unset) return &ctx.stack[frame.base + slot];
+        if (frame.self) {
+            int field = frame.self->layout->find(name);
+            if (field >= 0) return &frame.self->fields()[field];
+        }
+    }
+    return nullptr;
+}
+
+} // namespace
+
+void TraceHooks::before(ASTNode& node, ExecutionContext&) {
+    *out << std::string(2 * depth++, ' ') << to_string(node) << " @" << node.line << "\n";
+}
+
+void TraceHooks::call(Symbol name, int line, ExecutionContext&) {
+    *out << std::string(2 * depth, ' ') << "-> " << symbol_name(name) << " @" << line << "\n";
+}
+
+void TraceHooks::returned(Symbol name, ExecutionContext&) {
+    *out << std::string(2 * depth, ' ') << "<- " << symbol_name(name) << "\n";
+}
+
+void TraceHooks::allocate(Value::Type type, size_t bytes, int line) {
+    *out << std::string(2 * depth, ' ') << "+ " << type_name(type) << " " << bytes << " bytes @" << line << "\n";
+}
+
+void CountHooks::write_report(std::ostream& out) const {
+    std::map<std::string, long> visits;
+    for (auto& kind : by_kind) visits[kind_name(*kind.second.sample)] += kind.second.count;
+    std::map<std::string, long> named_calls;
+    for (auto& call : calls) named_calls[symbol_name(call.first)] = call.second;
+
+    out << "{\"visits\":{";
+    const char* sep = "";
+    for (auto& visit : visits) {
+        out << sep << "\"" << visit.first << "\":" << visit.second;
+        sep = ",";
+    }
+    out << "},\"calls\":{";
+    sep = "";
+    for (auto& call : named_calls) {
+        out << sep << "\"" << call.first << "\":" << call.second;
+        sep = ",";
+    }
+    out << "},\"allocations\":{";
+    sep = "";
+    for (auto& type : by_type) {
+        out << sep << "\"" << type_name(static_cast<Value::Type>(type.first)) << "\":{\"count\":" << type.second.count
+            << ",\"bytes\":" << type.second.bytes << "}";
+        sep = ",";
+    }
+    out << "}}" << std::endl;
+}
+
+void BreakpointHooks::stop(int line, ExecutionContext& ctx) {
+    stepping = false;
+    *out << "Breakpoint at line " << line << "\n";
+    if (!ctx.frames.empty()) {
+        const Frame& frame = ctx.frames.back();
+        for (size_t s = 0; s < frame.layout->slots.size(); ++s) {
+            const Value& value = ctx.stack[frame.base + s];
+            if (value.type != Value::Type::Unset) *out << "  " << symbol_name(frame.layout->slots[s]) << " = " << show(value) << "\n";
+        }
+        if (frame.self) {
+            for (uint32_t f = 0; f < frame.self->count; ++f) {
+                *out << "  " << symbol_name(frame.self->layout->slots[f]) << " = " << show(frame.self->fields()[f]) << "\n";
+            }
+        }
+    }
+    std::string command;
+    while (*out << "(break) " << std::flush, std::getline(*commands, command)) {
+        std::istringstream words(command);
+        std::string verb, name;
+        words >> verb >> name;
+        if (verb.empty() || verb == "c") return;
+        if (verb == "s") {
+            stepping = true;
+            return;
+        }
+        if (verb == "q") throw InterpreterBase::RuntimeError("Stopped at breakpoint", line);
+        if (verb == "p" && !name.empty()) {
+            const Value* value = find_variable(ctx, SymbolTable::intern(name));
+            *out << "  " << name << " = " << (value ? show(*value) : "undefined") << "\n";
+        } else {
+            *out << "Commands: c (continue), s (step), p NAME (print), q (quit)\n";
+        }
+    }
+    *out << "\n";
+}
@@ -0,0 +1,242 @@
+#include "incremental.h"
+#include "parser.h"
+#include <algorithm>
+#include <iterator>
+
+namespace {
+
+// Moves every node of a reused statement by `delta` lines, after an edit
+// above it added or removed newlines.
+class LineShifter : public ASTVisitor {
+public:
+    explicit LineShifter(int delta) : delta(delta) {}
+
+    void visit(ProgramNode& node) override { node.line += delta; each(node.statements); }
+    void visit(VarDeclNode& node) override { node.line += delta; shift(node.initializer.get()); }
+    void visit(BlueprintNode& node) override {
+        node.line += delta;
+        for (auto& field : node.fields) field->accept(*this);
+        each(node.body);
+    }
+    void visit(FunctionNode& node) override { node.line += delta; each(node.body); }
+    void visit(IfNode& node) override {
+        node.line += delta;
+        node.condition->accept(*this);
+        node.then_block->accept(*this);
+        for (auto& branch : node.else_if_blocks) {
+            branch.first->accept(*this);
+            branch.second->accept(*this);
+        }
+        shift(node.else_block.get());
+    }
+    void visit(ChooseNode& node) override {
+        node.line += delta;
+        node.subject->accept(*this);
+        for (auto& labels : node.labels) {
+            for (auto& label : labels) label.line += delta;
+        }
+        for (auto& body : node.cases) body->accept(*this);
+        shift(node.otherwise.get());
+    }
+    void visit(WhileNode& node) override {
+        node.line += delta;
+        node.condition->accept(*this);
+        node.body->accept(*this);
+    }
+    void visit(ParallelForNode& node) override {
+        node.line += delta;
+        node.start->accept(*this);
+        node.end->accept(*this);
+        node.body->accept(*this);
+    }
+    void visit(AccumulateNode& node) override { node.line += delta; node.expression->accept(*this); }
+    void visit(PrintNode& node) override { node.line += delta; node.expression->accept(*this); }
+    void visit(InputNode& node) override { node.line += delta; }
+    void visit(BinaryOpNode& node) override {
+        node.line += delta;
+        node.left->accept(*this);
+        node.right->accept(*this);
+    }
+    void visit(IdentifierNode& node) override { node.line += delta; }
+    void visit(NumberNode& node) override { node.line += delta; }
+    void visit(StringNode& node) override { node.line += delta; }
+    void visit(BooleanNode& node) override { node.line += delta; }
+    void visit(AssignmentNode& node) override { node.line += delta; node.value->accept(*this); }
+    void visit(CallNode& node) override { node.line += delta; each(node.arguments); }
+    void visit(YieldNode& node) override { node.line += delta; node.expression->accept(*this); }
+    void visit(InstanceNode& node) override { node.line += delta; }
+    void visit(ImportNode& node) override { node.line += delta; }
+    void visit(InlinedCallNode& node) override {
+        node.line += delta;
+        for (auto& binding : node.bindings) binding->accept(*this);
+        node.result->accept(*this);
+    }
+    void visit(LetConstDeclNode& node) override { node.line += delta; shift(node.initializer.get()); }
+    void visit(FieldAccessNode& node) override { node.line += delta; }
+    void visit(FieldAssignmentNode& node) override { node.line += delta; node.value->accept(*this); }
+    void visit(ArrayLiteralNode& node) override { node.line += delta; each(node.elements); }
+    void visit(DictLiteralNode& node) override {
+        node.line += delta;
+        each(node.keys);
+        each(node.values);
+    }
+    void visit(IndexNode& node) override { node.line += delta; node.index->accept(*this); }
+    void visit(IndexAssignmentNode& node) override {
+        node.line += delta;
+        node.index->accept(*this);
+        node.value->accept(*this);
+    }
+
+private:
+    int delta;
+
+    void shift(ASTNode* node) {
+        if (node) node->accept(*this);
+    }
+    void each(std::vector<std::unique_ptr<ASTNode>>& nodes) {
+        for (auto& node : nodes) node->accept(*this);
+    }
+};
+
+int count_newlines(const char* data, size_t n) {
+    return static_cast<int>(std::count(data, data + n, '\n'));
+}
+
+} // namespace
+
+Document::Document(std::string source) : text(std::move(source)), root(new ProgramNode(1)) {
+    toks = Lexer(text, true).tokenize();
+    Parser parser(&toks);
+    while (!parser.done()) {
+        Statement statement{parser.position(), 0, nullptr, std::string()};
+        auto node = parser.next_statement(statement.error);
+        statement.end = parser.position();
+        statement.node = node.get();
+        if (node) root->statements.push_back(std::move(node));
+        statements.push_back(std::move(statement));
+    }
+}
+
+// Replaces toks[first, old_end) with `fresh` and moves every later token by
+// `delta` bytes and `line_delta` lines, in a single pass over the tail.
+void Document::splice_tokens(size_t first, size_t old_end, std::vector<Token>& fresh, long delta, int line_delta) {
+    auto move = [&](Token& to, Token& from) {
+        if (&to != &from) to = std::move(from);
+        to.offset = static_cast<uint32_t>(to.offset + delta);
+        to.end = static_cast<uint32_t>(to.end + delta);
+        to.line += line_delta;
+    };
+    size_t new_end = first + fresh.size();
+    size_t size = toks.size();
+    if (new_end <= old_end) {
+        for (size_t i = old_end; i < size; ++i) move(toks[i - old_end + new_end], toks[i]);
+        toks.resize(size - (old_end - new_end));
+    } else {
+        toks.resize(size + (new_end - old_end));
+        for (size_t i = size; i-- > old_end;) move(toks[i - old_end + new_end], toks[i]);
+    }
+    std::move(fresh.begin(), fresh.end(), toks.begin() + first);
+}
+
+std::vector<std::string> Document::errors() const {
+    std::vector<std::string> result;
+    for (auto& statement : statements) {
+        if (!statement.node) result.push_back(statement.error);
+    }
+    return result;
+}
+
+void Document::apply(const TextEdit& edit) {
+    stats = EditStats();
+    size_t edit_end = edit.offset + edit.removed; // In the old text
+    long delta = static_cast<long>(edit.inserted.size()) - static_cast<long>(edit.removed);
+    int line_delta = count_newlines(edit.inserted.data(), edit.inserted.size()) -
+                     count_newlines(text.data() + edit.offset, edit.removed);
+    text.replace(edit.offset, edit.removed, edit.inserted);
+
+    // Relex. A token is only read up to one character past its end, so tokens
+    // ending before the edit offset are unchanged; lexing restarts where the
+    // last of them ends and stops at the first new token that starts where a
+    // token after the edit used to start, since from there on the lexer
+    // would see the same text in the same state.
+    size_t first = std::lower_bound(toks.begin(), toks.end(), edit.offset,
+                                    [](const Token& t, size_t offset) { return t.end < offset; }) - toks.begin();
+    Lexer lexer(text, true);
+    if (first > 0) lexer.seek(toks[first - 1].end, toks[first - 1].line);
+    std::vector<Token> fresh;
+    size_t old = first; // Old tokens [first, old) are replaced by `fresh`
+    for (;;) {
+        Token t = lexer.next();
+        if (t.type == TOK_EOF) {
+            fresh.push_back(t);
+            old = toks.size();
+            break;
+        }
+        while (old < toks.size() && toks[old].offset + delta < static_cast<long>(t.offset)) ++old;
+        if (old < toks.size() && toks[old].offset >= edit_end && toks[old].offset + delta == static_cast<long>(t.offset)) break;
+        fresh.push_back(t);
+    }
+    size_t old_end = old;
+    size_t new_end = first + fresh.size();
+    long shift = static_cast<long>(new_end) - static_cast<long>(old_end);
+    splice_tokens(first, old_end, fresh, delta, line_delta);
+    stats.tokens_relexed = fresh.size();
+
+    // Reparse from the first statement that read a changed token (the
+    // parser looks one token past a statement's end) until a statement
+    // boundary after the changed tokens lines up with an old one.
+    size_t s0 = std::lower_bound(statements.begin(), statements.end(), first,
+                                 [](const Statement& s, size_t token) { return s.end + 1 < token; }) - statements.begin();
+    size_t start = s0 < statements.size() ? statements[s0].first : (statements.empty() ? 0 : statements.back().end);
+    Parser parser(&toks);
+    parser.seek(start);
+    std::vector<Statement> reparsed;
+    std::vector<std::unique_ptr<ASTNode>> nodes;
+    size_t s1 = s0; // Old statements [s0, s1) are replaced by `reparsed`
+    bool synced = false;
+    while (!parser.done()) {
+        long p = static_cast<long>(parser.position());
+        if (p >= static_cast<long>(new_end)) {
+            while (s1 < statements.size() && static_cast<long>(statements[s1].first) + shift < p) ++s1;
+            if (s1 < statements.size() && statements[s1].first >= old_end && static_cast<long>(statements[s1].first) + shift == p) {
+                synced = true;
+                break;
+            }
+        }
+        Statement statement{parser.position(), 0, nullptr, std::string()};
+        auto node = parser.next_statement(statement.error);
+        statement.end = parser.position();
+        statement.node = node.get();
+        if (node) nodes.push_back(std::move(node));
+        reparsed.push_back(std::move(statement));
+    }
+    if (!synced) s1 = statements.size();
+
+    for (size_t i = s1; i < statements.size(); ++i) {
+        Statement& statement = statements[i];
+        statement.first += shift;
+        statement.end += shift;
+        if (line_delta == 0) continue;
+        if (statement.node) {
+            LineShifter shifter(line_delta);
+            statement.node->accept(shifter);
+        } else {
+            parser.seek(statement.first); // Refresh the line number in the message
+            statement.error.clear();
+            parser.next_statement(statement.error);
+        }
+    }
+
+    size_t index = 0, dropped = 0;
+    for (size_t i = 0; i < s0; ++i) index += statements[i].node != nullptr;
+    for (size_t i = s0; i < s1; ++i) dropped += statements[i].node != nullptr;
+    auto& program = root->statements;
+    program.erase(program.begin() + index, program.begin() + index + dropped);
+    program.insert(program.begin() + index, std::make_move_iterator(nodes.begin()), std::make_move_iterator(nodes.end()));
+    statements.erase(statements.begin() + s0, statements.begin() + s1);
+    statements.insert(statements.begin() + s0, std::make_move_iterator(reparsed.begin()),
+                      std::make_move_iterator(reparsed.end()));
+
+    stats.statements_reparsed = reparsed.size();
+    stats.statements_reused = statements.size() - reparsed.size();
+}
@@ -0,0 +1,256 @@
+#include "inliner.h"
+#include <unordered_set>
+
+namespace {
+
+// What the program defines and writes, which decides whether a call site
+// always reaches the same callee.
+struct Definitions {
+    std::unordered_map<Symbol, int> functions;                // Plain (non-method) definitions per name
+    std::unordered_map<Symbol, FunctionNode*> top_functions;  // Defined directly in the program
+    std::unordered_map<Symbol, int> blueprints;               // Definitions per name, nested ones included
+    std::unordered_map<Symbol, BlueprintNode*> top_blueprints;
+    std::unordered_map<Symbol, int> instances;                // Declarations per instance name
+    std::unordered_map<Symbol, Symbol> instance_blueprints;
+    std::unordered_set<Symbol> written; // Names written other than by an instance declaration, and field names
+    bool imports = false;
+};
+
+void collect(std::vector<std::unique_ptr<ASTNode>>& statements, bool top, bool methods, Definitions& defs);
+
+void collect(ASTNode& node, bool top, bool method, Definitions& defs) {
+    if (auto* function = dynamic_cast<FunctionNode*>(&node)) {
+        if (!method) {
+            ++defs.functions[function->name];
+            if (top) defs.top_functions[function->name] = function;
+        }
+        for (Symbol param : function->parameters) defs.written.insert(param);
+        collect(function->body, false, false, defs);
+    } else if (auto* blueprint = dynamic_cast<BlueprintNode*>(&node)) {
+        ++defs.blueprints[blueprint->name];
+        if (top) defs.top_blueprints[blueprint->name] = blueprint;
+        for (Symbol field : blueprint->field_layout.slots) defs.written.insert(field);
+        collect(blueprint->body, false, true, defs);
+    } else if (auto* program = dynamic_cast<ProgramNode*>(&node)) {
+        collect(program->statements, false, false, defs);
+    } else if (auto* decl = dynamic_cast<VarDeclNode*>(&node)) {
+        defs.written.insert(decl->name);
+    } else if (auto* let = dynamic_cast<LetConstDeclNode*>(&node)) {
+        defs.written.insert(let->name);
+    } else if (auto* assign = dynamic_cast<AssignmentNode*>(&node)) {
+        defs.written.insert(assign->name);
+    } else if (auto* instance = dynamic_cast<InstanceNode*>(&node)) {
+        ++defs.instances[instance->instance_name];
+        defs.instance_blueprints[instance->instance_name] = instance->blueprint_name;
+    } else if (auto* branch = dynamic_cast<IfNode*>(&node)) {
+        collect(*branch->then_block, false, false, defs);
+        for (auto& else_if : branch->else_if_blocks) collect(*else_if.second, false, false, defs);
+        if (branch->else_block) collect(*branch->else_block, false, false, defs);
+    } else if (auto* choose = dynamic_cast<ChooseNode*>(&node)) {
+        for (auto& body : choose->cases) collect(*body, false, false, defs);
+        if (choose->otherwise) collect(*choose->otherwise, false, false, defs);
+    } else if (auto* loop = dynamic_cast<WhileNode*>(&node)) {
+        collect(*loop->body, false, false, defs);
+    } else if (auto* parallel = dynamic_cast<ParallelForNode*>(&node)) {
+        defs.written.insert(parallel->counter);
+        if (parallel->accumulator != NO_SYMBOL) defs.written.insert(parallel->accumulator);
+        collect(*parallel->body, false, false, defs);
+    } else if (dynamic_cast<ImportNode*>(&node)) {
+        defs.imports = true;
+    }
+}
+
+void collect(std::vector<std::unique_ptr<ASTNode>>& statements, bool top, bool methods, Definitions& defs) {
+    for (auto& stmt : statements) collect(*stmt, top, methods, defs);
+}
+
+class Inliner {
+public:
+    explicit Inliner(const Definitions& defs) : defs(defs) {}
+
+    std::vector<InlinedSite> sites;
+
+    void walk(std::vector<std::unique_ptr<ASTNode>>& nodes) {
+        for (auto& node : nodes) walk(node);
+    }
+
+    // Inlines inside-out, so arguments are rewritten before their call.
+    void walk(std::unique_ptr<ASTNode>& slot) {
+        ASTNode* node = slot.get();
+        if (auto* program = dynamic_cast<ProgramNode*>(node)) {
+            walk(program->statements);
+        } else if (auto* blueprint = dynamic_cast<BlueprintNode*>(node)) {
+            walk(blueprint->body); // Field initializers run in a frame with no slots to bind into
+        } else if (auto* function = dynamic_cast<FunctionNode*>(node)) {
+            walk(function->body);
+        } else if (auto* decl = dynamic_cast<VarDeclNode*>(node)) {
+            walk(decl->initializer);
+        } else if (auto* let = dynamic_cast<LetConstDeclNode*>(node)) {
+            walk(let->initializer);
+        } else if (auto* branch = dynamic_cast<IfNode*>(node)) {
+            walk(branch->condition);
+            walk(branch->then_block->statements);
+            for (auto& else_if : branch->else_if_blocks) {
+                walk(else_if.first);
+                walk(else_if.second->statements);
+            }
+            if (branch->else_block) walk(branch->else_block->statements);
+        } else if (auto* choose = dynamic_cast<ChooseNode*>(node)) {
+            walk(choose->subject);
+            for (auto& body : choose->cases) walk(body->statements);
+            if (choose->otherwise) walk(choose->otherwise->statements);
+        } else if (auto* loop = dynamic_cast<WhileNode*>(node)) {
+            walk(loop->condition);
+            walk(loop->body->statements);
+        } else if (auto* parallel = dynamic_cast<ParallelForNode*>(node)) {
+            walk(parallel->start);
+            walk(parallel->end);
+            walk(parallel->body->statements);
+        } else if (auto* accumulate = dynamic_cast<AccumulateNode*>(node)) {
+            walk(accumulate->expression);
+        } else if (auto* print = dynamic_cast<PrintNode*>(node)) {
+            walk(print->expression);
+        } else if (auto* yield = dynamic_cast<YieldNode*>(node)) {
+            walk(yield->expression);
+        } else if (auto* assign = dynamic_cast<AssignmentNode*>(node)) {
+            walk(assign->value);
+        } else if (auto* field = dynamic_cast<FieldAssignmentNode*>(node)) {
+            walk(field->value);
+        } else if (auto* store = dynamic_cast<IndexAssignmentNode*>(node)) {
+            walk(store->index);
+            walk(store->value);
+        } else if (auto* binary = dynamic_cast<BinaryOpNode*>(node)) {
+            walk(binary->left);
+            walk(binary->right);
+        } else if (auto* array = dynamic_cast<ArrayLiteralNode*>(node)) {
+            walk(array->elements);
+        } else if (auto* dict = dynamic_cast<DictLiteralNode*>(node)) {
+            walk(dict->keys);
+            walk(dict->values);
+        } else if (auto* index = dynamic_cast<IndexNode*>(node)) {
+            walk(index->index);
+        } else if (auto* call = dynamic_cast<CallNode*>(node)) {
+            walk(call->arguments);
+            inline_call(slot, *call);
+        }
+    }
+
+private:
+    const Definitions& defs;
+
+    static int count(const std::unordered_map<Symbol, int>& counts, Symbol name) {
+        auto it = counts.find(name);
+        return it == counts.end() ? 0 : it->second;
+    }
+
+    // The function or method `call` reaches on every run, if it can be known.
+    const FunctionNode* callee(const CallNode& call, const BlueprintNode*& blueprint) const {
+        blueprint = nullptr;
+        if (call.receiver == NO_SYMBOL) {
+            auto it = defs.top_functions.find(call.name);
+            if (it == defs.top_functions.end() || count(defs.functions, call.name) != 1) return nullptr;
+            return it->second->line < call.line ? it->second : nullptr; // Registered before the call runs
+        }
+        if (count(defs.instances, call.receiver) != 1 || defs.written.count(call.receiver)) return nullptr;
+        Symbol name = defs.instance_blueprints.at(call.receiver);
+        auto it = defs.top_blueprints.find(name);
+        if (it == defs.top_blueprints.end() || count(defs.blueprints, name) != 1) return nullptr;
+        blueprint = it->second;
+        for (auto& stmt : blueprint->body) { // The first match, as the interpreter's method search
+            auto* method = dynamic_cast<const FunctionNode*>(stmt.get());
+            if (method && method->name == call.name) return method;
+        }
+        return nullptr;
+    }
+
+    static bool is_parameter(const FunctionNode& function, Symbol name) {
+        for (Symbol param : function.parameters) {
+            if (param == name) return true;
+        }
+        return false;
+    }
+
+    // Whether `node` reads only parameters and receiver fields; counts its nodes.
+    bool substitutable(const ASTNode& node, const FunctionNode& function, const BlueprintNode* blueprint,
+                       int& size) const {
+        ++size;
+        if (dynamic_cast<const NumberNode*>(&node) || dynamic_cast<const StringNode*>(&node) ||
+            dynamic_cast<const BooleanNode*>(&node)) {
+            return true;
+        }
+        if (auto* id = dynamic_cast<const IdentifierNode*>(&node)) {
+            return is_parameter(function, id->name) || (blueprint && blueprint->field_layout.find(id->name) >= 0);
+        }
+        if (auto* binary = dynamic_cast<const BinaryOpNode*>(&node)) {
+            return substitutable(*binary->left, function, blueprint, size) &&
+                   substitutable(*binary->right, function, blueprint, size);
+        }
+        if (auto* field = dynamic_cast<const FieldAccessNode*>(&node)) return is_parameter(function, field->receiver);
+        return false;
+    }
+
+    // A copy of the callee's expression with parameters renamed and bare
+    // receiver fields turned into field accesses on the call's receiver.
+    std::unique_ptr<ASTNode> substitute(const ASTNode& node, const std::unordered_map<Symbol, Symbol>& renamed,
+                                        Symbol receiver) const {
+        if (auto* number = dynamic_cast<const NumberNode*>(&node)) {
+            return std::unique_ptr<ASTNode>(new NumberNode(std::to_string(number->value), node.line));
+        }
+        if (auto* text = dynamic_cast<const StringNode*>(&node)) {
+            return std::unique_ptr<ASTNode>(new StringNode(text->value, node.line));
+        }
+        if (auto* boolean = dynamic_cast<const BooleanNode*>(&node)) {
+            return std::unique_ptr<ASTNode>(new BooleanNode(boolean->value, node.line));
+        }
+        if (auto* id = dynamic_cast<const IdentifierNode*>(&node)) {
+            auto it = renamed.find(id->name);
+            if (it != renamed.end()) return std::unique_ptr<ASTNode>(new IdentifierNode(it->second, node.line));
+            return std::unique_ptr<ASTNode>(new FieldAccessNode(receiver, id->name, node.line));
+        }
+        if (auto* binary = dynamic_cast<const BinaryOpNode*>(&node)) {
+            std::unique_ptr<BinaryOpNode> copy(new BinaryOpNode(binary->op, node.line));
+            copy->left = substitute(*binary->left, renamed, receiver);
+            copy->right = substitute(*binary->right, renamed, receiver);
+            return std::move(copy);
+        }
+        auto& field = static_cast<const FieldAccessNode&>(node);
+        return std::unique_ptr<ASTNode>(new FieldAccessNode(renamed.at(field.receiver), field.field, node.line));
+    }
+
+    void inline_call(std::unique_ptr<ASTNode>& slot, CallNode& call) {
+        const BlueprintNode* blueprint;
+        const FunctionNode* function = callee(call, blueprint);
+        if (!function || function->parameters.size() != call.arguments.size() || function->body.size() != 1) return;
+        std::unordered_set<Symbol> distinct(function->parameters.begin(), function->parameters.end());
+        if (distinct.size() != function->parameters.size()) return;
+        auto* yield = dynamic_cast<const YieldNode*>(function->body[0].get());
+        int size = 0;
+        if (!yield || !substitutable(*yield->expression, *function, blueprint, size) || size > INLINE_BUDGET) return;
+
+        std::string suffix = "@" + std::to_string(sites.size() + 1);
+        std::unordered_map<Symbol, Symbol> renamed;
+        std::unique_ptr<InlinedCallNode> inlined(new InlinedCallNode(call.receiver, call.name, call.line));
+        for (size_t i = 0; i < call.arguments.size(); ++i) {
+            Symbol param = function->parameters[i];
+            Symbol name = SymbolTable::intern(symbol_name(param) + suffix);
+            renamed[param] = name;
+            std::unique_ptr<LetConstDeclNode> binding(new LetConstDeclNode(false, name, call.line));
+            binding->initializer = std::move(call.arguments[i]);
+            inlined->bindings.push_back(std::move(binding));
+        }
+        inlined->result = substitute(*yield->expression, renamed, call.receiver);
+        sites.push_back(InlinedSite{call.line, call.receiver, call.name, size});
+        slot = std::move(inlined);
+    }
+};
+
+} // namespace
+
+std::vector<InlinedSite> inline_calls(ProgramNode& program) {
+    Definitions defs;
+    collect(program.statements, true, false, defs);
+    if (defs.imports) return std::vector<InlinedSite>();
+    Inliner inliner(defs);
+    inliner.walk(program.statements);
+    return inliner.sites;
+}
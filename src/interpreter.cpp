@@ -1,115 +1,393 @@
 #include "interpreter.h"
+#include "builtins.h"
+#include "hooks.h"
+#include "lazy.h"
+#include "profiler.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <atomic>
+#include <exception>
 #include <iostream>
+#include <sstream>
 #include <stdexcept>
 
-Value InterpreterVisitor::evaluate(ASTNode* node) {
-    node->accept(*this);
-    return scopes.back().find("__temp__") != scopes.back().end() ? scopes.back()["__temp__"] : Value();
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+namespace {
+
+// Name of a function or blueprint declared inside blueprint `scope`.
+Symbol qualify(Symbol scope, Symbol name) {
+    if (scope == NO_SYMBOL) return name;
+    return SymbolTable::intern(symbol_name(scope) + "." + symbol_name(name));
 }
 
-bool InterpreterVisitor::to_bool(const Value& value) {
-    if (value.type == Value::Type::Int) return value.as_int() != 0;
-    if (value.type == Value::Type::String) return !value.as_string().empty();
-    return false;
+// `+` on values: string concatenation if either side is a string.
+Value add_values(const Value& left, const Value& right) {
+    if (left.type == Value::Type::String || right.type == Value::Type::String) {
+        return Value::concat(left, right);
+    }
+    return Value(left.as_int() + right.as_int());
+}
+
+typedef BinaryOpNode::Kind Kind;
+
+// The kernel of a specialized operator; the operand types are known to fit.
+Value apply_kernel(Kind kind, const Value& left, const Value& right, int line) {
+    switch (kind) {
+        case Kind::IntAdd: return Value(left.int_val + right.int_val);
+        case Kind::IntSub: return Value(left.int_val - right.int_val);
+        case Kind::IntMul: return Value(left.int_val * right.int_val);
+        case Kind::IntDiv:
+            if (right.int_val == 0) throw InterpreterBase::RuntimeError("Division by zero", line);
+            return Value(left.int_val / right.int_val);
+        case Kind::IntLessEqual: return Value(left.int_val <= right.int_val ? 1 : 0);
+        case Kind::IntNotLess: return Value(left.int_val >= right.int_val ? 1 : 0);
+        case Kind::IntGreater: return Value(left.int_val > right.int_val ? 1 : 0);
+        case Kind::IntEqual: return Value(left.int_val == right.int_val ? 1 : 0);
+        case Kind::Concat: return Value::concat(left, right);
+        case Kind::StringEqual:
+            return Value(left.str_len == right.str_len &&
+                         std::char_traits<char>::compare(left.str_data(), right.str_data(), left.str_len) == 0 ? 1 : 0);
+        case Kind::Generic: break;
+    }
+    return Value();
 }
 
-Value InterpreterVisitor::call_function(const std::string& name, const std::vector<Value>& args) {
-    auto it = functions.find(name);
-    if (it == functions.end()) throw RuntimeError("Undefined function " + name, 0);
-    if (it->second->parameters.size() != args.size()) {
-        throw RuntimeError("Expected " + std::to_string(it->second->parameters.size()) + 
-                          " arguments, got " + std::to_string(args.size()), 0);
+// The guard of a quickened operator: the operands still have the types
+// its kernel was chosen for.
+bool kernel_fits(Kind kind, const Value& left, const Value& right) {
+    switch (kind) {
+        case Kind::Concat: return left.type == Value::Type::String;
+        case Kind::StringEqual: return left.type == Value::Type::String && right.type == Value::Type::String;
+        case Kind::Generic: return false;
+        default: return left.type == Value::Type::Int && right.type == Value::Type::Int;
     }
-    scopes.emplace_back();
-    for (size_t i = 0; i < args.size(); ++i) {
-        scopes.back()[it->second->parameters[i]] = args[i];
+}
+
+// The kernel that gives the generic result of `op` on these operands, or
+// Generic when none does.
+Kind kernel_for(const std::string& op, const Value& left, const Value& right) {
+    bool ints = left.type == Value::Type::Int && right.type == Value::Type::Int;
+    if (op == "+") return ints ? Kind::IntAdd : left.type == Value::Type::String ? Kind::Concat : Kind::Generic;
+    if (op == "==") {
+        if (ints) return Kind::IntEqual;
+        return left.type == Value::Type::String && right.type == Value::Type::String ? Kind::StringEqual : Kind::Generic;
     }
+    if (!ints) return Kind::Generic;
+    if (op == "-") return Kind::IntSub;
+    if (op == "<=") return Kind::IntLessEqual;
+    if (op == "!<") return Kind::IntNotLess;
+    if (op == ">") return Kind::IntGreater;
+    if (op == "*") return Kind::IntMul;
+    if (op == "/") return Kind::IntDiv;
+    return Kind::Generic;
+}
+
+// One pool worker's private execution state for a parallel_repeat.
+struct ParallelWorker {
+    std::ostringstream out;
+    std::istringstream in;
+    ExecutionContext context;
+    InterpreterVisitor interpreter;
+    ParallelWorker() : context(out, in), interpreter(context) {}
+};
+
+struct ParallelChunk {
+    long begin;
+    std::string output;
+    Value partial;
+    std::exception_ptr error;
+};
+
+} // namespace
+
+thread_local HeapBudget* HeapQuota::current = nullptr;
+
+void Object::release(Object* object) {
+    static thread_local std::vector<Object*>* queued = nullptr;
+    if (queued) {
+        queued->push_back(object);
+        return;
+    }
+    std::vector<Object*> queue;
+    queued = &queue;
+    delete object;
+    while (!queue.empty()) {
+        Object* next = queue.back();
+        queue.pop_back();
+        delete next;
+    }
+    queued = nullptr;
+}
+
+const size_t StackGuard::RESERVE;
+thread_local uintptr_t StackGuard::floor = 0;
+
+uintptr_t StackGuard::thread_floor() {
+#ifdef _WIN32
+    ULONG_PTR low, high;
+    GetCurrentThreadStackLimits(&low, &high);
+    return floor_for(reinterpret_cast<const char*>(low), high - low);
+#else
+    pthread_attr_t attr;
+    void* bottom = nullptr;
+    size_t size = 0;
+    if (pthread_getattr_np(pthread_self(), &attr) == 0) {
+        pthread_attr_getstack(&attr, &bottom, &size);
+        pthread_attr_destroy(&attr);
+    }
+    return bottom ? floor_for(static_cast<const char*>(bottom), size) : 1;
+#endif
+}
+
+QuickeningCounters& quickening_counters() {
+    static QuickeningCounters counters;
+    return counters;
+}
+
+template <class Hooks>
+BasicInterpreter<Hooks>::BasicInterpreter() : owned_context(new ExecutionContext()), ctx(*owned_context) {}
+template <class Hooks>
+BasicInterpreter<Hooks>::BasicInterpreter(ExecutionContext& context, Hooks hooks) : ctx(context), hooks(hooks) {}
+
+// Runs one statement, counting its line when profiling. A memory limit hit
+// anywhere inside is reported at the innermost statement.
+template <class Hooks>
+void BasicInterpreter<Hooks>::execute(ASTNode& stmt) {
+    if (ctx.profiler) ctx.profiler->count_line(stmt.line);
+    hooks.before(stmt, ctx);
     try {
-        for (auto& stmt : it->second->body) {
-            stmt->accept(*this);
-        }
-    } catch (const ReturnValue& rv) {
-        scopes.pop_back();
-        return rv.value;
+        stmt.accept(*this);
+    } catch (const HeapQuota::Exceeded& e) {
+        throw RuntimeError(e.what(), stmt.line);
     }
-    scopes.pop_back();
-    return Value();
+    hooks.after(stmt, ctx);
 }
 
-Value InterpreterVisitor::call_method(const Value& instance, const std::string& method_name, const std::vector<Value>& args) {
-    if (instance.type != Value::Type::Instance) throw RuntimeError("Cannot call method on non-instance", 0);
-    auto blueprint_it = blueprints.find(instance.blueprint_name);
-    if (blueprint_it == blueprints.end()) throw RuntimeError("Unknown blueprint " + instance.blueprint_name, 0);
-    for (auto& stmt : blueprint_it->second->body) {
-        if (auto* func = dynamic_cast<FunctionNode*>(stmt.get())) {
-            if (func->name == method_name) {
-                if (func->parameters.size() != args.size()) {
-                    throw RuntimeError("Expected " + std::to_string(func->parameters.size()) + 
-                                      " arguments, got " + std::to_string(args.size()), 0);
-                }
-                scopes.emplace_back(instance.instance_fields ? *instance.instance_fields : std::unordered_map<std::string, Value>());
-                for (size_t i = 0; i < args.size(); ++i) {
-                    scopes.back()[func->parameters[i]] = args[i];
-                }
-                std::string old_scope = current_scope;
-                current_scope = instance.blueprint_name;
-                try {
-                    for (auto& body_stmt : func->body) {
-                        body_stmt->accept(*this);
-                    }
-                } catch (const ReturnValue& rv) {
-                    current_scope = old_scope;
-                    scopes.pop_back();
-                    return rv.value;
-                }
-                current_scope = old_scope;
-                scopes.pop_back();
-                return Value();
+// Called when the countdown of steps runs out.
+template <class Hooks>
+void BasicInterpreter<Hooks>::check_limits(int line) {
+    ctx.steps += ctx.chunk;
+    if (ctx.limits.steps && ctx.steps > ctx.limits.steps) {
+        throw RuntimeError("Step limit of " + std::to_string(ctx.limits.steps) + " exceeded", line);
+    }
+    if (ctx.limits.timeout_ms && std::chrono::steady_clock::now() >= ctx.deadline) {
+        throw RuntimeError("Time limit of " + std::to_string(ctx.limits.timeout_ms) + " ms exceeded", line);
+    }
+    ctx.rearm();
+}
+
+// Runs statements in the current frame, stopping early once one of them yields.
+template <class Hooks>
+void BasicInterpreter<Hooks>::run_block(const std::vector<std::unique_ptr<ASTNode>>& statements) {
+    for (auto& stmt : statements) {
+        execute(*stmt);
+        if (ctx.returning) return;
+    }
+}
+
+template <class Hooks>
+Value BasicInterpreter<Hooks>::evaluate(ASTNode* node) {
+    hooks.before(*node, ctx);
+    node->accept(*this);
+    hooks.after(*node, ctx);
+    return std::move(ctx.result);
+}
+
+template <class Hooks>
+bool BasicInterpreter<Hooks>::to_bool(const Value& value) {
+    if (value.type == Value::Type::Int) return value.as_int() != 0;
+    if (value.type == Value::Type::String) return value.str_len != 0;
+    if (value.type == Value::Type::Array) return value.array().size() != 0;
+    if (value.type == Value::Type::Dict) return value.dict().size() != 0;
+    return false;
+}
+
+// Slots below `base` that are already on the stack (call arguments) become
+// the frame's first slots; the rest start unset.
+template <class Hooks>
+void BasicInterpreter<Hooks>::push_frame(const FrameLayout& layout, size_t base, Instance* self) {
+    MemoryReport::Tag tag(MemoryCategory::Scopes);
+    ctx.stack.resize(base + layout.slots.size(), Value::unset());
+    ctx.frames.push_back(Frame{base, &layout, self});
+}
+
+template <class Hooks>
+void BasicInterpreter<Hooks>::pop_frame() {
+    ctx.stack.erase(ctx.stack.begin() + ctx.frames.back().base, ctx.stack.end());
+    ctx.frames.pop_back();
+}
+
+// The resolved slot in the current frame if it has been written; otherwise
+// the name is searched in the enclosing frames, innermost first. Scoping is
+// dynamic, so a callee sees its callers' variables.
+template <class Hooks>
+Value* BasicInterpreter<Hooks>::lookup(Symbol name, int slot) {
+    size_t depth = ctx.frames.size();
+    if (slot >= 0) {
+        Value& value = ctx.stack[ctx.frames[depth - 1].base + slot];
+        if (value.type != Value::Type::Unset) return &value;
+    }
+    for (size_t i = depth; i-- > 0;) {
+        const Frame& frame = ctx.frames[i];
+        if (i + 1 < depth) {
+            int s = frame.layout->find(name);
+            if (s >= 0) {
+                Value& value = ctx.stack[frame.base + s];
+                if (value.type != Value::Type::Unset) return &value;
             }
         }
+        if (frame.self) {
+            int offset = frame.self->layout->find(name);
+            if (offset >= 0) return &frame.self->fields()[offset];
+        }
+    }
+    return nullptr;
+}
+
+template <class Hooks>
+Instance& BasicInterpreter<Hooks>::receiver(Symbol name, int slot, int line) {
+    Value* value = lookup(name, slot);
+    if (!value || value->type != Value::Type::Instance) {
+        throw RuntimeError("Instance " + symbol_name(name) + " not found", line);
     }
-    throw RuntimeError("Method " + method_name + " not found in " + instance.blueprint_name, 0);
+    return *value->instance;
 }
 
-void InterpreterVisitor::visit(ProgramNode& node) {
-    scopes.emplace_back();
-    current_scope.clear();
-    for (size_t i = 0; i < node.statements.size(); ++i) {
-        node.statements[i]->accept(*this);
+// `guess` is the resolver's offset for the field name; it holds for every
+// blueprint that agrees on it, so the layout search is normally skipped.
+template <class Hooks>
+int BasicInterpreter<Hooks>::field_offset(const Instance& object, Symbol field, int guess, int line) {
+    if (guess >= 0 && static_cast<uint32_t>(guess) < object.count && object.layout->slots[guess] == field) return guess;
+    int offset = object.layout->find(field);
+    if (offset < 0) {
+        throw RuntimeError("No field " + symbol_name(field) + " in " + symbol_name(object.blueprint), line);
     }
-    scopes.pop_back();
+    return offset;
 }
 
-void InterpreterVisitor::visit(BlueprintNode& node) {
-    std::string full_name = current_scope.empty() ? node.name : current_scope + "." + node.name;
-    blueprints[full_name] = &node;
-    std::string old_scope = current_scope;
-    current_scope = full_name;
+// Calls a function, or a method when `self` is set. Arguments are evaluated
+// straight onto the top of the stack, where they become the callee's
+// parameter slots. Instances live on the heap, so `self` stays valid however
+// the stack grows during the call.
+template <class Hooks>
+Value BasicInterpreter<Hooks>::invoke(FunctionNode& function, CallNode& call, Instance* self) {
+    if (function.parameters.size() != call.arguments.size()) {
+        throw RuntimeError("Expected " + std::to_string(function.parameters.size()) +
+                          " arguments, got " + std::to_string(call.arguments.size()), call.line);
+    }
+    if (StackGuard::exhausted()) throw RuntimeError("Call depth limit exceeded", call.line);
+    ensure_parsed(function);
+    size_t base = ctx.stack.size();
+    for (auto& arg : call.arguments) {
+        ctx.stack.push_back(evaluate(arg.get()));
+    }
+    if (ctx.yield_points) ctx.yield_points->safepoint();
+    tick(call.line);
+    ProfileScope profile(ctx.profiler, &function, self ? self->blueprint : NO_SYMBOL, call.name);
+    Symbol old_scope = ctx.current_scope;
+    Instance* old_self = ctx.self;
+    if (self) {
+        ctx.current_scope = self->blueprint;
+        ctx.self = self;
+    }
+    push_frame(function.layout, base, self);
+    hooks.call(call.name, call.line, ctx);
+    run_block(function.body);
+    hooks.returned(call.name, ctx);
+    pop_frame();
+    ctx.current_scope = old_scope;
+    ctx.self = old_self;
+    if (!ctx.returning) return Value();
+    ctx.returning = false;
+    return std::move(ctx.return_value);
+}
+
+template <class Hooks>
+void BasicInterpreter<Hooks>::visit(ProgramNode& node) {
+    push_frame(node.layout, ctx.stack.size());
+    run_block(node.statements);
+    pop_frame();
+}
+
+template <class Hooks>
+void BasicInterpreter<Hooks>::enter_globals(const FrameLayout& layout) {
+    if (ctx.frames.empty()) {
+        push_frame(layout, 0);
+        return;
+    }
+    ctx.frames.resize(1);
+    ctx.frames[0].layout = &layout;
+    ctx.stack.resize(layout.slots.size(), Value::unset());
+    ctx.returning = false;
+    ctx.self = nullptr;
+    ctx.current_scope = NO_SYMBOL;
+}
+
+template <class Hooks>
+void BasicInterpreter<Hooks>::run_module(ProgramNode& module) {
+    push_frame(module.layout, ctx.stack.size());
+    run_block(module.statements);
+    ctx.returning = false;
+}
+
+// Imports are resolved by the module loader before anything runs.
+template <class Hooks>
+void BasicInterpreter<Hooks>::visit(ImportNode&) {}
+
+template <class Hooks>
+void BasicInterpreter<Hooks>::visit(InlinedCallNode& node) {
+    if (node.receiver != NO_SYMBOL) receiver(node.receiver, node.receiver_slot, node.line); // Fails as the call would
+    for (auto& binding : node.bindings) binding->accept(*this);
+    node.result->accept(*this);
+}
+
+template <class Hooks>
+void BasicInterpreter<Hooks>::visit(BlueprintNode& node) {
+    Symbol full_name = qualify(ctx.current_scope, node.name);
+    BlueprintNode*& entry = ctx.blueprints[full_name];
+    if (entry != &node) {
+        entry = &node;
+        ++ctx.definitions;
+    }
+    Symbol old_scope = ctx.current_scope;
+    ctx.current_scope = full_name;
     for (auto& stmt : node.body) {
         stmt->accept(*this);
     }
-    current_scope = old_scope;
+    ctx.current_scope = old_scope;
 }
 
-void InterpreterVisitor::visit(VarDeclNode& node) {
+template <class Hooks>
+void BasicInterpreter<Hooks>::visit(VarDeclNode& node) {
     Value val = evaluate(node.initializer.get());
-    if (node.type == "integer" && val.type != Value::Type::Int) {
-        throw RuntimeError("Expected integer for variable " + node.name, node.line);
+    if (node.type == "integer" && !node.int_proven && val.type != Value::Type::Int) {
+        throw RuntimeError("Expected integer for variable " + symbol_name(node.name), node.line);
     }
-    scopes.back()[node.name] = val;
+    local(node.slot) = std::move(val);
 }
 
-void InterpreterVisitor::visit(LetConstDeclNode& node) {
+template <class Hooks>
+void BasicInterpreter<Hooks>::visit(LetConstDeclNode& node) {
     Value val = evaluate(node.initializer.get());
-    scopes.back()[node.name] = val;
+    local(node.slot) = std::move(val);
 }
 
-void InterpreterVisitor::visit(FunctionNode& node) {
-    std::string full_name = current_scope.empty() ? node.name : current_scope + "." + node.name;
-    functions[full_name] = &node;
+template <class Hooks>
+void BasicInterpreter<Hooks>::visit(FunctionNode& node) {
+    FunctionNode*& entry = ctx.functions[qualify(ctx.current_scope, node.name)];
+    if (entry != &node) {
+        entry = &node;
+        ++ctx.definitions;
+    }
 }
 
-void InterpreterVisitor::visit(IfNode& node) {
+template <class Hooks>
+void BasicInterpreter<Hooks>::visit(IfNode& node) {
     Value cond = evaluate(node.condition.get());
     if (to_bool(cond)) {
         node.then_block->accept(*this);
@@ -131,54 +409,242 @@ void InterpreterVisitor::visit(IfNode& node) {
     }
 }
 
-void InterpreterVisitor::visit(WhileNode& node) {
+// One lookup picks the case, however many there are.
+template <class Hooks>
+void BasicInterpreter<Hooks>::visit(ChooseNode& node) {
+    Value subject = evaluate(node.subject.get());
+    int target = ChooseNode::NO_CASE;
+    if (subject.type == Value::Type::Int) {
+        target = node.find(subject.int_val);
+    } else if (subject.type == Value::Type::String) {
+        target = node.find(subject.str_data(), subject.str_len, static_cast<Symbol>(subject.int_val));
+    }
+    ProgramNode* body = target == ChooseNode::NO_CASE ? node.otherwise.get() : node.cases[target].get();
+    if (body) body->accept(*this);
+}
+
+template <class Hooks>
+void BasicInterpreter<Hooks>::visit(WhileNode& node) {
     while (true) {
         Value cond = evaluate(node.condition.get());
         if (!to_bool(cond)) break;
-        for (auto& stmt : node.body->statements) {
-            stmt->accept(*this);
+        run_block(node.body->statements);
+        if (ctx.returning) return;
+        if (ctx.yield_points) ctx.yield_points->safepoint();
+        tick(node.line);
+    }
+}
+
+template <class Hooks>
+void BasicInterpreter<Hooks>::run_iterations(ParallelForNode& node, long begin, long end, Value& partial) {
+    Value* saved = ctx.accumulator;
+    size_t depth = ctx.frames.size();
+    size_t base = ctx.stack.size();
+    ctx.accumulator = node.accumulator == NO_SYMBOL ? nullptr : &partial;
+    try {
+        for (long i = begin; i < end; ++i) {
+            tick(node.line);
+            push_frame(node.layout, base);
+            local(0) = Value(static_cast<int>(i));
+            run_block(node.body->statements);
+            pop_frame();
+            if (ctx.returning) {
+                ctx.returning = false;
+                throw RuntimeError("yield inside parallel_repeat", node.line);
+            }
+        }
+    } catch (...) {
+        ctx.frames.erase(ctx.frames.begin() + depth, ctx.frames.end());
+        ctx.stack.erase(ctx.stack.begin() + base, ctx.stack.end());
+        ctx.accumulator = saved;
+        throw;
+    }
+    ctx.accumulator = saved;
+}
+
+template <class Hooks>
+void BasicInterpreter<Hooks>::visit(ParallelForNode& node) {
+    long begin = evaluate(node.start.get()).as_int();
+    long end = evaluate(node.end.get()).as_int();
+    if (node.accumulator != NO_SYMBOL && !lookup(node.accumulator, node.accumulator_slot)) {
+        throw RuntimeError("Undefined variable " + symbol_name(node.accumulator), node.line);
+    }
+
+    Value total;
+    if (end > begin && (Hooks::enabled || ctx.parallel_depth > 0 || ctx.parallel_workers == 1)) {
+        run_iterations(node, begin, end, total);
+    } else if (end > begin) {
+        std::unique_lock<std::mutex> pool_lock;
+        WorkStealingPool& pool = WorkStealingPool::shared(ctx.parallel_workers, pool_lock);
+        long grain = ctx.parallel_grain > 0 ? ctx.parallel_grain : std::max(1L, (end - begin) / (8L * pool.size()));
+
+        // Every worker sees a flattened copy of the enclosing variables as its
+        // bottom frame and writes only to its per-iteration frames, so workers
+        // share nothing. Inner frames shadow outer ones, as in lookup().
+        std::unordered_map<Symbol, Value> visible;
+        for (auto& frame : ctx.frames) {
+            if (frame.self) {
+                for (uint32_t f = 0; f < frame.self->count; ++f) {
+                    visible[frame.self->layout->slots[f]] = frame.self->fields()[f];
+                }
+            }
+            for (size_t s = 0; s < frame.layout->slots.size(); ++s) {
+                const Value& value = ctx.stack[frame.base + s];
+                if (value.type != Value::Type::Unset) visible[frame.layout->slots[s]] = value;
+            }
+        }
+        FrameLayout snapshot;
+        std::vector<Value> snapshot_values;
+        for (auto& var : visible) {
+            snapshot.add(var.first);
+            snapshot_values.push_back(var.second);
+        }
+        std::vector<std::unique_ptr<ParallelWorker>> workers;
+        std::vector<std::vector<ParallelChunk>> chunks(pool.size());
+        for (unsigned w = 0; w < pool.size(); ++w) {
+            workers.emplace_back(new ParallelWorker());
+            ExecutionContext& wc = workers.back()->context;
+            wc.stack.insert(wc.stack.end(), snapshot_values.begin(), snapshot_values.end());
+            for (auto& value : wc.stack) value.detach();
+            wc.frames.push_back(Frame{0, &snapshot, nullptr});
+            wc.functions = ctx.functions;
+            wc.blueprints = ctx.blueprints;
+            wc.current_scope = ctx.current_scope;
+            wc.parallel_depth = ctx.parallel_depth + 1;
+            wc.quicken = ctx.quicken;
+            wc.limits = ctx.limits; // Each worker may take the steps left
+            wc.deadline = ctx.deadline;
+            wc.steps = ctx.steps_taken();
+            wc.rearm();
+        }
+
+        std::atomic<bool> failed(false);
+        HeapBudget* budget = HeapQuota::current; // Workers draw on what the script has left
+        pool.parallel_for(begin, end, grain, [&](unsigned w, long b, long e) {
+            if (failed.load()) return;
+            ParallelChunk chunk;
+            chunk.begin = b;
+            try {
+                HeapQuota::Scope quota(budget);
+                workers[w]->interpreter.run_iterations(node, b, e, chunk.partial);
+            } catch (...) {
+                chunk.error = std::current_exception();
+                failed.store(true);
+            }
+            chunk.output = workers[w]->out.str();
+            workers[w]->out.str("");
+            chunks[w].push_back(chunk);
+        });
+        pool_lock.unlock();
+
+        // Combine in index order so output and string accumulation match a serial run.
+        std::vector<ParallelChunk> ordered;
+        for (auto& list : chunks) ordered.insert(ordered.end(), list.begin(), list.end());
+        std::sort(ordered.begin(), ordered.end(),
+                  [](const ParallelChunk& a, const ParallelChunk& b) { return a.begin < b.begin; });
+        for (auto& chunk : ordered) {
+            ctx.out << chunk.output;
+            if (chunk.error) std::rethrow_exception(chunk.error);
+            if (chunk.partial.type == Value::Type::None) continue;
+            total = total.type == Value::Type::None ? chunk.partial : add_values(total, chunk.partial);
         }
     }
+
+    if (node.accumulator != NO_SYMBOL && total.type != Value::Type::None) {
+        Value* target = lookup(node.accumulator, node.accumulator_slot);
+        *target = add_values(*target, total);
+    }
 }
 
-void InterpreterVisitor::visit(PrintNode& node) {
+template <class Hooks>
+void BasicInterpreter<Hooks>::visit(AccumulateNode& node) {
+    if (!ctx.accumulator) throw RuntimeError("accumulate outside a parallel_repeat with an accumulate clause", node.line);
+    Value val = evaluate(node.expression.get());
+    *ctx.accumulator = ctx.accumulator->type == Value::Type::None ? val : add_values(*ctx.accumulator, val);
+}
+
+template <class Hooks>
+void BasicInterpreter<Hooks>::visit(PrintNode& node) {
     Value val = evaluate(node.expression.get());
     if (val.type == Value::Type::String) {
-        std::cout << val.as_string() << "\n";
+        ctx.out.write(val.str_data(), val.str_len) << "\n";
+    } else if (val.type == Value::Type::Array || val.type == Value::Type::Dict) {
+        ctx.out << val.as_string() << "\n";
     } else {
-        std::cout << val.as_int() << "\n";
+        ctx.out << val.as_int() << "\n";
     }
 }
 
-void InterpreterVisitor::visit(InputNode& node) {
-    std::cout << "Enter " << node.type << ": ";
+template <class Hooks>
+void BasicInterpreter<Hooks>::visit(InputNode& node) {
+    if (ctx.parallel_depth > 0) throw RuntimeError("scanning_user_input inside parallel_repeat", node.line);
+    if (ctx.yield_points) ctx.yield_points->wait_for_input();
+    ctx.out << "Enter " << node.type << ": ";
     if (node.type == "integer") {
         int value;
-        std::cin >> value;
-        if (std::cin.fail()) {
-            std::cin.clear();
-            std::cin.ignore(10000, '\n');
+        ctx.in >> value;
+        if (ctx.in.fail()) {
+            ctx.in.clear();
+            ctx.in.ignore(10000, '\n');
             throw RuntimeError("Invalid integer input", node.line);
         }
-        std::cin.ignore(10000, '\n');
-        scopes.back()["__temp__"] = Value(value);
+        ctx.in.ignore(10000, '\n');
+        ctx.result = Value(value);
     } else {
         std::string input;
-        std::getline(std::cin, input);
-        scopes.back()["__temp__"] = Value(input);
+        std::getline(ctx.in, input);
+        ctx.result = Value(input);
     }
 }
 
-void InterpreterVisitor::visit(BinaryOpNode& node) {
+// Goes back to the generic path for good; counted once however many
+// contexts see the guard fail.
+template <class Hooks>
+void BasicInterpreter<Hooks>::deopt(std::atomic<Feedback>& feedback) {
+    Feedback expected = Feedback::Quick;
+    if (feedback.compare_exchange_strong(expected, Feedback::Generic)) quickening_counters().deopted++;
+}
+
+// Rewrites a Generic node into the kernel its first operands call for; a
+// node no kernel fits stays generic. Only the context that moves the node
+// out of Unseen writes its kernel.
+template <class Hooks>
+void BasicInterpreter<Hooks>::quicken(BinaryOpNode& node, const Value& left, const Value& right) {
+    Kind kind = kernel_for(node.op, left, right);
+    Feedback expected = Feedback::Unseen;
+    if (!node.feedback.compare_exchange_strong(expected, Feedback::Generic) || kind == Kind::Generic) return;
+    node.quick.store(kind, std::memory_order_relaxed);
+    node.feedback.store(Feedback::Quick, std::memory_order_release);
+    quickening_counters().quickened++;
+}
+
+template <class Hooks>
+void BasicInterpreter<Hooks>::visit(BinaryOpNode& node) {
+    // Operand types proven by infer_types(): no checks and no conversions.
+    if (node.kind != Kind::Generic) {
+        Value left = evaluate(node.left.get());
+        Value right = evaluate(node.right.get());
+        ctx.result = apply_kernel(node.kind, left, right, node.line);
+        built_string(node.line);
+        return;
+    }
     Value left = evaluate(node.left.get());
     Value right = evaluate(node.right.get());
+    Feedback feedback = node.feedback.load(std::memory_order_acquire);
+    if (feedback == Feedback::Quick) {
+        Kind quick = node.quick.load(std::memory_order_relaxed);
+        if (kernel_fits(quick, left, right)) {
+            ctx.result = apply_kernel(quick, left, right, node.line);
+            built_string(node.line);
+            return;
+        }
+        deopt(node.feedback);
+    } else if (feedback == Feedback::Unseen && ctx.quicken) {
+        quicken(node, left, right);
+    }
     Value result;
     if (node.op == "+") {
-        if (left.type == Value::Type::String || right.type == Value::Type::String) {
-            result = Value(left.as_string() + right.as_string());
-        } else {
-            result = Value(left.as_int() + right.as_int());
-        }
+        result = add_values(left, right);
     } else if (node.op == "-") {
         result = Value(left.as_int() - right.as_int());
     } else if (node.op == "<=") {
@@ -189,7 +655,13 @@ void InterpreterVisitor::visit(BinaryOpNode& node) {
         result = Value(left.as_int() > right.as_int() ? 1 : 0);
     } 
     else if (node.op == "==") {
-    result = Value(left.as_int() == right.as_int() ? 1 : 0);
+        if (left.type == Value::Type::String && right.type == Value::Type::String) {
+            bool same = left.str_len == right.str_len &&
+                        std::char_traits<char>::compare(left.str_data(), right.str_data(), left.str_len) == 0;
+            result = Value(same ? 1 : 0);
+        } else {
+            result = Value(left.as_int() == right.as_int() ? 1 : 0);
+        }
     }
 
     else if (node.op == "*") {
@@ -208,76 +680,300 @@ void InterpreterVisitor::visit(BinaryOpNode& node) {
     else {
         throw RuntimeError("Invalid operation " + node.op, node.line);
     }
-    scopes.back()["__temp__"] = result;
+    ctx.result = std::move(result);
+    built_string(node.line);
 }
 
-void InterpreterVisitor::visit(IdentifierNode& node) {
-    for (auto it = scopes.rbegin(); it != scopes.rend(); ++it) {
-        auto var_it = it->find(node.name);
-        if (var_it != it->end()) {
-            scopes.back()["__temp__"] = var_it->second;
+template <class Hooks>
+void BasicInterpreter<Hooks>::visit(IdentifierNode& node) {
+    if (node.field >= 0 && ctx.self) {
+        ctx.result = ctx.self->fields()[node.field];
+        return;
+    }
+    if (node.assigned) {
+        ctx.result = local(node.slot);
+        return;
+    }
+    // Quickened: the first read found the current frame's slot set, so
+    // later reads go straight to it while it stays set.
+    Feedback feedback = node.feedback.load(std::memory_order_relaxed);
+    if (feedback == Feedback::Quick) {
+        const Value& value = local(node.slot);
+        if (value.type != Value::Type::Unset) {
+            ctx.result = value;
             return;
         }
+        deopt(node.feedback);
     }
-    throw RuntimeError("Undefined variable " + node.name, node.line);
+    Value* value = lookup(node.name, node.slot);
+    if (!value) throw RuntimeError("Undefined variable " + symbol_name(node.name), node.line);
+    if (feedback == Feedback::Unseen && ctx.quicken) {
+        bool in_frame = node.slot >= 0 && value == &local(node.slot);
+        Feedback expected = Feedback::Unseen;
+        if (node.feedback.compare_exchange_strong(expected, in_frame ? Feedback::Quick : Feedback::Generic) && in_frame) {
+            quickening_counters().quickened++;
+        }
+    }
+    ctx.result = *value;
 }
 
-void InterpreterVisitor::visit(NumberNode& node) {
-    scopes.back()["__temp__"] = Value(node.value);
+template <class Hooks>
+void BasicInterpreter<Hooks>::visit(NumberNode& node) {
+    ctx.result = Value(node.value);
 }
 
-void InterpreterVisitor::visit(StringNode& node) {
-    scopes.back()["__temp__"] = Value(node.value);
+template <class Hooks>
+void BasicInterpreter<Hooks>::visit(StringNode& node) {
+    ctx.result = Value(node.text());
+    ctx.result.int_val = node.value; // Dictionary keys hash literals through the symbol table
 }
 
-void InterpreterVisitor::visit(BooleanNode& node) {
-    scopes.back()["__temp__"] = Value(node.value ? 1 : 0);
+template <class Hooks>
+void BasicInterpreter<Hooks>::visit(BooleanNode& node) {
+    ctx.result = Value(node.value ? 1 : 0);
 }
 
-void InterpreterVisitor::visit(AssignmentNode& node) {
+template <class Hooks>
+void BasicInterpreter<Hooks>::visit(AssignmentNode& node) {
     Value val = evaluate(node.value.get());
-    scopes.back()[node.name] = val;
-}
-
-void InterpreterVisitor::visit(CallNode& node) {
-    std::vector<Value> args;
-    for (auto& arg : node.arguments) {
-        args.push_back(evaluate(arg.get()));
-    }
-    std::string call_name = node.name;
-    size_t dot_pos = call_name.find('.');
-    if (dot_pos != std::string::npos) {
-        std::string inst_name = call_name.substr(0, dot_pos);
-        std::string method_name = call_name.substr(dot_pos + 1);
-        for (auto it = scopes.rbegin(); it != scopes.rend(); ++it) {
-            auto inst_it = it->find(inst_name);
-            if (inst_it != it->end() && inst_it->second.type == Value::Type::Instance) {
-                Value result = call_method(inst_it->second, method_name, args);
-                scopes.back()["__temp__"] = result; // Store return value
-                return;
-            }
+    if (node.field >= 0 && ctx.self) {
+        val.own_text();
+        ctx.self->fields()[node.field] = std::move(val);
+        return;
+    }
+    local(node.slot) = std::move(val);
+}
+
+template <class Hooks>
+void BasicInterpreter<Hooks>::visit(FieldAccessNode& node) {
+    Instance& object = receiver(node.receiver, node.receiver_slot, node.line);
+    ctx.result = object.fields()[field_offset(object, node.field, node.offset, node.line)];
+}
+
+template <class Hooks>
+void BasicInterpreter<Hooks>::visit(FieldAssignmentNode& node) {
+    Value val = evaluate(node.value.get());
+    val.own_text();
+    Instance& object = receiver(node.receiver, node.receiver_slot, node.line);
+    object.fields()[field_offset(object, node.field, node.offset, node.line)] = std::move(val);
+}
+
+template <class Hooks>
+Value BasicInterpreter<Hooks>::call_builtin(const Builtin& builtin, CallNode& node) {
+    Value args[3];
+    for (size_t i = 0; i < node.arguments.size(); ++i) args[i] = evaluate(node.arguments[i].get());
+    ProfileScope profile(ctx.profiler, &builtin, NO_SYMBOL, node.name);
+    hooks.call(node.name, node.line, ctx);
+    Value result = builtin.call(args, node.line);
+    hooks.returned(node.name, ctx);
+    return result;
+}
+
+// Records the target a call site resolved to. Only one context owns a site's
+// cache, the first to fill it, so a cache valid for a context's stamp was
+// written by that context. A site whose name now resolves to something else
+// than its cache goes generic.
+template <class Hooks>
+void BasicInterpreter<Hooks>::cache_call(CallNode& node, Symbol blueprint, FunctionNode* target, const Builtin* builtin) {
+    uint64_t stamp = node.stamp.load();
+    if (stamp != 0 && (stamp == CallNode::STAMP_BUSY || stamp >> 32 != ctx.definitions >> 32)) return;
+    if (!node.stamp.compare_exchange_strong(stamp, CallNode::STAMP_BUSY)) return;
+    Feedback feedback = node.feedback.load();
+    if (feedback == Feedback::Quick &&
+        (node.blueprint.load() != blueprint || node.target.load() != target || node.builtin.load() != builtin)) {
+        deopt(node.feedback);
+        feedback = Feedback::Generic;
+    }
+    if (feedback == Feedback::Generic) {
+        node.stamp.store(0);
+        return;
+    }
+    node.blueprint.store(blueprint);
+    node.target.store(target);
+    node.builtin.store(builtin);
+    node.stamp.store(ctx.definitions);
+    if (feedback == Feedback::Unseen) {
+        node.feedback.store(Feedback::Quick);
+        quickening_counters().quickened++;
+    }
+}
+
+// A quickened call site whose cache is valid for this context's
+// definitions: no function table or builtin search, no scan of the
+// blueprint for the method. A method site whose receiver changes blueprint
+// goes generic. Returns false when the generic path must run.
+template <class Hooks>
+bool BasicInterpreter<Hooks>::quick_call(CallNode& node) {
+    if (node.stamp.load() != ctx.definitions) return false;
+    FunctionNode* target = node.target.load(std::memory_order_relaxed);
+    if (const Builtin* builtin = node.builtin.load(std::memory_order_relaxed)) {
+        ctx.result = call_builtin(*builtin, node);
+        return true;
+    }
+    if (node.receiver == NO_SYMBOL) {
+        ctx.result = invoke(*target, node, nullptr);
+        return true;
+    }
+    Instance& object = receiver(node.receiver, node.receiver_slot, node.line);
+    if (object.blueprint != node.blueprint.load(std::memory_order_relaxed)) {
+        deopt(node.feedback);
+        return false;
+    }
+    ctx.result = invoke(*target, node, &object);
+    return true;
+}
+
+template <class Hooks>
+void BasicInterpreter<Hooks>::visit(CallNode& node) {
+    Feedback feedback = node.feedback.load(std::memory_order_acquire);
+    if (feedback == Feedback::Quick && quick_call(node)) return;
+    bool learn = ctx.quicken && feedback != Feedback::Generic;
+    if (node.receiver == NO_SYMBOL) {
+        auto it = ctx.functions.find(node.name);
+        if (it != ctx.functions.end()) {
+            if (learn) cache_call(node, NO_SYMBOL, it->second, nullptr);
+            ctx.result = invoke(*it->second, node, nullptr);
+            return;
         }
-        throw RuntimeError("Instance " + inst_name + " not found", node.line);
+        const Builtin* builtin = find_builtin(node.name);
+        if (!builtin) throw RuntimeError("Undefined function " + symbol_name(node.name), node.line);
+        if (builtin->arity != node.arguments.size()) {
+            throw RuntimeError(std::string(builtin->name) + " expects " + std::to_string(builtin->arity) +
+                              " arguments, got " + std::to_string(node.arguments.size()), node.line);
+        }
+        if (learn) cache_call(node, NO_SYMBOL, nullptr, builtin);
+        ctx.result = call_builtin(*builtin, node);
+        return;
     }
-    Value result = call_function(call_name, args);
-    scopes.back()["__temp__"] = result; // Store return value
+    Instance& object = receiver(node.receiver, node.receiver_slot, node.line);
+    Symbol blueprint = object.blueprint;
+    auto blueprint_it = ctx.blueprints.find(blueprint);
+    if (blueprint_it == ctx.blueprints.end()) throw RuntimeError("Unknown blueprint " + symbol_name(blueprint), node.line);
+    for (auto& stmt : blueprint_it->second->body) {
+        auto* method = dynamic_cast<FunctionNode*>(stmt.get());
+        if (method && method->name == node.name) {
+            if (learn) cache_call(node, blueprint, method, nullptr);
+            ctx.result = invoke(*method, node, &object);
+            return;
+        }
+    }
+    throw RuntimeError("Method " + symbol_name(node.name) + " not found in " + symbol_name(blueprint), node.line);
 }
 
-void InterpreterVisitor::visit(YieldNode& node) {
-    Value val = evaluate(node.expression.get());
-    throw ReturnValue(val);
+template <class Hooks>
+Value& BasicInterpreter<Hooks>::container_named(Symbol name, int slot, int line) {
+    Value* value = lookup(name, slot);
+    if (!value) throw RuntimeError("Undefined variable " + symbol_name(name), line);
+    if (value->type != Value::Type::Array && value->type != Value::Type::Dict) {
+        throw RuntimeError(symbol_name(name) + " is not an array or a dictionary", line);
+    }
+    return *value;
 }
 
-void InterpreterVisitor::visit(InstanceNode& node) {
-    std::string blueprint_name = node.blueprint_name;
-    std::string scoped_name = current_scope.empty() ? blueprint_name : current_scope + "." + blueprint_name;
-    auto it = blueprints.find(scoped_name);
-    if (it == blueprints.end()) {
-        it = blueprints.find(blueprint_name);
-        if (it == blueprints.end()) {
-            throw RuntimeError("Blueprint " + blueprint_name + " not defined", node.line);
+template <class Hooks>
+size_t BasicInterpreter<Hooks>::array_index(const Array& array, const Value& index, int line) {
+    if (index.type != Value::Type::Int) throw RuntimeError("Array index must be an integer", line);
+    if (index.int_val < 0 || static_cast<size_t>(index.int_val) >= array.size()) {
+        throw RuntimeError("Index " + std::to_string(index.int_val) + " out of range for array of length " +
+                          std::to_string(array.size()), line);
+    }
+    return static_cast<size_t>(index.int_val);
+}
+
+template <class Hooks>
+void BasicInterpreter<Hooks>::visit(ArrayLiteralNode& node) {
+    Array* array = new Array();
+    Value result(array);
+    hooks.allocate(Value::Type::Array, sizeof(Array) + node.elements.size() * sizeof(Value), node.line);
+    for (auto& element : node.elements) array->push(evaluate(element.get()));
+    ctx.result = std::move(result);
+}
+
+template <class Hooks>
+void BasicInterpreter<Hooks>::visit(DictLiteralNode& node) {
+    Dict* dict = new Dict();
+    Value result(dict);
+    hooks.allocate(Value::Type::Dict, sizeof(Dict) + node.keys.size() * 2 * sizeof(Value), node.line);
+    for (size_t i = 0; i < node.keys.size(); ++i) {
+        Value key = evaluate(node.keys[i].get());
+        if (!Dict::valid_key(key)) throw RuntimeError("Dictionary keys must be integers or strings", node.line);
+        Value value = evaluate(node.values[i].get());
+        value.own_text();
+        dict->insert(key) = std::move(value);
+    }
+    ctx.result = std::move(result);
+}
+
+template <class Hooks>
+void BasicInterpreter<Hooks>::visit(IndexNode& node) {
+    Value index = evaluate(node.index.get());
+    Value& container = container_named(node.name, node.slot, node.line);
+    if (container.type == Value::Type::Dict) {
+        if (!Dict::valid_key(index)) throw RuntimeError("Dictionary keys must be integers or strings", node.line);
+        Value* value = container.dict().find(index);
+        if (!value) throw RuntimeError("Key " + index.as_string() + " not found in " + symbol_name(node.name), node.line);
+        ctx.result = *value;
+        return;
+    }
+    Array& array = container.array();
+    ctx.result = array.get(array_index(array, index, node.line));
+}
+
+template <class Hooks>
+void BasicInterpreter<Hooks>::visit(IndexAssignmentNode& node) {
+    Value index = evaluate(node.index.get());
+    Value val = evaluate(node.value.get());
+    Value& container = container_named(node.name, node.slot, node.line);
+    if (container.type == Value::Type::Dict) {
+        if (!Dict::valid_key(index)) throw RuntimeError("Dictionary keys must be integers or strings", node.line);
+        check_no_cycle(container.dict(), val, "a dictionary", node.line);
+        val.own_text();
+        container.dict().insert(index) = std::move(val);
+        return;
+    }
+    Array& array = container.array();
+    check_no_cycle(array, val, "an array", node.line);
+    array.set(array_index(array, index, node.line), std::move(val));
+}
+
+template <class Hooks>
+void BasicInterpreter<Hooks>::visit(YieldNode& node) {
+    ctx.return_value = evaluate(node.expression.get());
+    ctx.returning = true;
+}
+
+template <class Hooks>
+void BasicInterpreter<Hooks>::visit(InstanceNode& node) {
+    Symbol blueprint_name = node.blueprint_name;
+    auto it = ctx.blueprints.find(qualify(ctx.current_scope, blueprint_name));
+    if (it == ctx.blueprints.end()) {
+        it = ctx.blueprints.find(blueprint_name);
+        if (it == ctx.blueprints.end()) {
+            throw RuntimeError("Blueprint " + symbol_name(blueprint_name) + " not defined", node.line);
         }
     }
-    std::unordered_map<std::string, Value> fields;
-    scopes.back()[node.instance_name] = Value(it->first, fields);
-}
\ No newline at end of file
+    // Field initializers run in a frame of their own, so they see the
+    // enclosing variables but cannot declare any.
+    BlueprintNode& blueprint = *it->second;
+    Value object(Instance::create(it->first, blueprint.field_layout));
+    hooks.allocate(Value::Type::Instance, sizeof(Instance) + object.instance->count * sizeof(Value), node.line);
+    if (!blueprint.fields.empty()) {
+        static const FrameLayout no_slots;
+        push_frame(no_slots, ctx.stack.size());
+        for (size_t i = 0; i < blueprint.fields.size(); ++i) {
+            VarDeclNode& field = *blueprint.fields[i];
+            Value val = evaluate(field.initializer.get());
+            if (field.type == "integer" && !field.int_proven && val.type != Value::Type::Int) {
+                throw RuntimeError("Expected integer for field " + symbol_name(field.name), field.line);
+            }
+            object.instance->fields()[i] = std::move(val);
+        }
+        pop_frame();
+    }
+    local(node.slot) = std::move(object);
+}
+
+template class BasicInterpreter<NoHooks>;
+template class BasicInterpreter<TraceHooks>;
+template class BasicInterpreter<CountHooks>;
+template class BasicInterpreter<BreakpointHooks>;
@@ -0,0 +1,15 @@
+#include "lazy.h"
+#include "parser.h"
+#include "resolver.h"
+#include "semantic.h"
+
+void parse_body(FunctionNode& function) {
+    LazyBody& lazy = *function.lazy;
+    std::lock_guard<std::mutex> lock(lazy.mutex);
+    if (lazy.parsed.load(std::memory_order_relaxed)) return;
+    Parser parser(lazy.tokens, true);
+    function.body = parser.skipped_body(lazy);
+    resolve_slots(function, lazy.fields);
+    check_types(function);
+    lazy.parsed.store(true, std::memory_order_release);
+}
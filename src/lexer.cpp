@@ -1,8 +1,8 @@
 #include "lexer.h"
-#include <iostream>
+#include "memory_report.h"
 #include <stdexcept>
 
-Lexer::Lexer(const std::string& src) : source(src), pos(0), line(1) {}
+Lexer::Lexer(const std::string& src, bool recover) : source(src), pos(0), line(1), recover(recover) {}
 
 char Lexer::peek() { return pos < source.size() ? source[pos] : '\0'; }
 char Lexer::advance() { return pos < source.size() ? source[pos++] : '\0'; }
@@ -47,6 +47,12 @@ std::string Lexer::scan_identifier() {
     if (value == "true") return "true";            // Added
     if (value == "false") return "false";          // Added
     if (value == "else_when") return "else_when";  // Added
+    if (value == "parallel_repeat") return "parallel_repeat";
+    if (value == "until") return "until";
+    if (value == "import") return "import";
+    if (value == "accumulate") return "accumulate";
+    if (value == "choose") return "choose";
+    if (value == "when") return "when";
     return value;
 }
 
@@ -70,7 +76,6 @@ std::string Lexer::scan_string() {
 Token Lexer::next_token() {
     skip_whitespace();
     if (at_end()) return {TOK_EOF, "", line};
-    size_t start_pos = pos; // Capture start position
     char c = advance();
     switch (c) {
         case '+': return {TOK_PLUS, "+", line};
@@ -79,6 +84,8 @@ Token Lexer::next_token() {
         case ')': return {TOK_RPAREN, ")", line};
         case '{': return {TOK_LBRACE, "{", line};
         case '}': return {TOK_RBRACE, "}", line};
+        case '[': return {TOK_LBRACKET, "[", line};
+        case ']': return {TOK_RBRACKET, "]", line};
         case ';': return {TOK_SEMICOLON, ";", line};
         case ',': return {TOK_COMMA, ",", line};
         case '.': return {TOK_DOT, ".", line};
@@ -95,7 +102,7 @@ Token Lexer::next_token() {
                 advance();
                 return {TOK_ASSIGN, ":=", line};
             }
-            break;
+            return {TOK_COLON, ":", line};
         case '<':
             if (peek() == '=') {
                 advance();
@@ -109,7 +116,10 @@ Token Lexer::next_token() {
             }
             break;
         case '>': return {TOK_GT, ">", line};
-        case '"': return {TOK_STRING, scan_string(), line};
+        case '"': {
+            std::string text = scan_string();
+            return {TOK_STRING, text, line, SymbolTable::intern(text)};
+        }
         default:
             if (is_alpha(c)) {
                 std::string id = scan_identifier();
@@ -130,7 +140,13 @@ Token Lexer::next_token() {
                 if (id == "true") return {TOK_TRUE, id, line};            // Added
                 if (id == "false") return {TOK_FALSE, id, line};          // Added
                 if (id == "else_when") return {TOK_ELSE_WHEN, id, line};  // Added
-                return {TOK_IDENTIFIER, id, line};
+                if (id == "parallel_repeat") return {TOK_PARALLEL_REPEAT, id, line};
+                if (id == "until") return {TOK_UNTIL, id, line};
+                if (id == "accumulate") return {TOK_ACCUMULATE, id, line};
+                if (id == "import") return {TOK_IMPORT, id, line};
+                if (id == "choose") return {TOK_CHOOSE, id, line};
+                if (id == "when") return {TOK_WHEN, id, line};
+                return {TOK_IDENTIFIER, id, line, SymbolTable::intern(id)};
             }
             if (is_digit(c)) return {TOK_NUMBER, scan_number(), line};
             throw std::runtime_error("Unexpected character '" + std::string(1, c) + "' at line " + std::to_string(line));
@@ -138,14 +154,27 @@ Token Lexer::next_token() {
     throw std::runtime_error("Unhandled token at line " + std::to_string(line)); // Catch unhandled cases
 }
 
+Token Lexer::next() {
+    skip_whitespace();
+    size_t start = pos;
+    Token t;
+    try {
+        t = next_token();
+    } catch (const std::runtime_error& e) {
+        if (!recover) throw;
+        t = Token{TOK_ERROR, e.what(), line};
+    }
+    t.offset = static_cast<uint32_t>(start);
+    t.end = static_cast<uint32_t>(pos);
+    return t;
+}
+
 std::vector<Token> Lexer::tokenize() {
+    MemoryReport::Tag tag(MemoryCategory::Tokens);
     std::vector<Token> tokens;
-    while (!at_end()) {
-        Token t = next_token();
-        if (t.type == TOK_EOF) break;
-        std::cout << "Advancing to pos " << pos - t.value.size() << ", token: " << t.value << "\n"; // Fix pos
-        tokens.push_back(t);
+    for (;;) {
+        tokens.push_back(next());
+        if (tokens.back().type == TOK_EOF) break;
     }
-    tokens.push_back({TOK_EOF, "", line});
     return tokens;
 }
\ No newline at end of file
@@ -1,8 +1,27 @@
 #include "lexer.h"
 #include "parser.h"
 #include "interpreter.h"
+#include "batch.h"
+#include "codegen.h"
+#include "green.h"
+#include "hooks.h"
+#include "inliner.h"
+#include "memory_report.h"
+#include "modules.h"
+#include "profiler.h"
+#include "repl.h"
+#include "resolver.h"
+#include "semantic.h"
+#include "snapshot.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <iostream>
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
 
 class PrintVisitor : public ASTVisitor {
 private:
@@ -22,8 +41,9 @@ public:
         indent--;
     }
     void visit(BlueprintNode& node) override {
-        print_node("Blueprint", node.name);
+        print_node("Blueprint", symbol_name(node.name));
         indent++;
+        for (auto& field : node.fields) field->accept(*this);
         for (auto& stmt : node.body) stmt->accept(*this);
         indent--;
     }
@@ -32,13 +52,13 @@ public:
         indent++;
         if (node.initializer) {
             print_indent();
-            std::cout << "Identifier(\"" << node.name << "\")" << std::endl;
+            std::cout << "Identifier(\"" << symbol_name(node.name) << "\")" << std::endl;
             node.initializer->accept(*this);
         }
         indent--;
     }
     void visit(LetConstDeclNode& node) override {
-        print_node(node.is_const ? "ConstDecl" : "LetDecl", node.name);
+        print_node(node.is_const ? "ConstDecl" : "LetDecl", symbol_name(node.name));
         indent++;
         if (node.initializer) {
             node.initializer->accept(*this);
@@ -46,7 +66,7 @@ public:
         indent--;
     }
     void visit(FunctionNode& node) override {
-        print_node("Function", node.name);
+        print_node("Function", symbol_name(node.name) + (node.lazy && !node.lazy->parsed ? " (body not parsed)" : ""));
         indent++;
         for (auto& stmt : node.body) stmt->accept(*this);
         indent--;
@@ -80,6 +100,29 @@ public:
         }
         indent--;
     }
+    void visit(ChooseNode& node) override {
+        print_node("Choose");
+        indent++;
+        node.subject->accept(*this);
+        for (size_t c = 0; c < node.cases.size(); ++c) {
+            std::string labels;
+            for (auto& label : node.labels[c]) {
+                if (!labels.empty()) labels += ", ";
+                labels += label.is_string ? "\"" + symbol_name(label.text) + "\"" : std::to_string(label.number);
+            }
+            print_node("When", labels);
+            indent++;
+            node.cases[c]->accept(*this);
+            indent--;
+        }
+        if (node.otherwise) {
+            print_node("Otherwise");
+            indent++;
+            node.otherwise->accept(*this);
+            indent--;
+        }
+        indent--;
+    }
     void visit(WhileNode& node) override {
         print_node("While");
         indent++;
@@ -87,6 +130,21 @@ public:
         node.body->accept(*this);
         indent--;
     }
+    void visit(ParallelForNode& node) override {
+        print_node("ParallelFor", symbol_name(node.counter) +
+                   (node.accumulator == NO_SYMBOL ? "" : " -> " + symbol_name(node.accumulator)));
+        indent++;
+        node.start->accept(*this);
+        node.end->accept(*this);
+        node.body->accept(*this);
+        indent--;
+    }
+    void visit(AccumulateNode& node) override {
+        print_node("Accumulate");
+        indent++;
+        node.expression->accept(*this);
+        indent--;
+    }
     void visit(PrintNode& node) override {
         print_node("Print");
         indent++;
@@ -104,25 +162,26 @@ public:
         indent--;
     }
     void visit(IdentifierNode& node) override {
-        print_node("Identifier", node.name);
+        print_node("Identifier", symbol_name(node.name));
     }
     void visit(NumberNode& node) override {
         print_node("Number", std::to_string(node.value));
     }
     void visit(StringNode& node) override {
-        print_node("String", node.value);
+        print_node("String", node.text());
     }
     void visit(BooleanNode& node) override {
         print_node("Boolean", node.value ? "true" : "false");
     }
     void visit(AssignmentNode& node) override {
-        print_node("Assignment", node.name);
+        print_node("Assignment", symbol_name(node.name));
         indent++;
         node.value->accept(*this);
         indent--;
     }
     void visit(CallNode& node) override {
-        print_node("Call", node.name);
+        print_node("Call", node.receiver == NO_SYMBOL ? symbol_name(node.name)
+                                                     : symbol_name(node.receiver) + "." + symbol_name(node.name));
         indent++;
         for (auto& arg : node.arguments) {
             arg->accept(*this);
@@ -136,41 +195,337 @@ public:
         indent--;
     }
     void visit(InstanceNode& node) override {
-        print_node("Instance", node.blueprint_name + " " + node.instance_name);
+        print_node("Instance", symbol_name(node.blueprint_name) + " " + symbol_name(node.instance_name));
+    }
+    void visit(ImportNode& node) override { print_node("Import", node.path); }
+    void visit(InlinedCallNode& node) override {
+        print_node("Inlined", node.receiver == NO_SYMBOL ? symbol_name(node.callee)
+                                                        : symbol_name(node.receiver) + "." + symbol_name(node.callee));
+        indent++;
+        for (auto& binding : node.bindings) binding->accept(*this);
+        node.result->accept(*this);
+        indent--;
+    }
+    void visit(FieldAccessNode& node) override {
+        print_node("Field", symbol_name(node.receiver) + "." + symbol_name(node.field));
+    }
+    void visit(FieldAssignmentNode& node) override {
+        print_node("FieldAssignment", symbol_name(node.receiver) + "." + symbol_name(node.field));
+        indent++;
+        node.value->accept(*this);
+        indent--;
+    }
+    void visit(ArrayLiteralNode& node) override {
+        print_node("Array");
+        indent++;
+        for (auto& element : node.elements) element->accept(*this);
+        indent--;
+    }
+    void visit(DictLiteralNode& node) override {
+        print_node("Dict");
+        indent++;
+        for (size_t i = 0; i < node.keys.size(); ++i) {
+            node.keys[i]->accept(*this);
+            node.values[i]->accept(*this);
+        }
+        indent--;
+    }
+    void visit(IndexNode& node) override {
+        print_node("Index", symbol_name(node.name));
+        indent++;
+        node.index->accept(*this);
+        indent--;
+    }
+    void visit(IndexAssignmentNode& node) override {
+        print_node("IndexAssignment", symbol_name(node.name));
+        indent++;
+        node.index->accept(*this);
+        node.value->accept(*this);
+        indent--;
     }
 };
 
+static double elapsed_ms(std::chrono::steady_clock::time_point since) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - since).count();
+}
+
+static long peak_rss_kb() {
+#ifndef _WIN32
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#ifdef __APPLE__
+        return usage.ru_maxrss / 1024;
+#else
+        return usage.ru_maxrss;
+#endif
+    }
+#endif
+    return 0;
+}
+
+// Runs the imported modules, then the program, on a tree interpreter.
+template <class Hooks>
+static void run_tree(BasicInterpreter<Hooks>& interpreter, const std::vector<std::shared_ptr<const Module>>& imports,
+                     ASTNode& ast) {
+    for (auto& module : imports) interpreter.run_module(*module->ast);
+    ast.accept(interpreter);
+}
+
+static int usage(const char* argv0) {
+    std::cerr << "Usage: " << argv0 << " [--quiet] [--stats] [--workers N] [--grain N] [--profile] [--profile-out FILE] [--module-report]"
+              << " [--engine tree|closure]\n"
+              << "       " << std::string(std::strlen(argv0), ' ') << " [--no-quicken] [--no-inline] [--inline-report] [--lazy-parse]\n"
+              << "       " << std::string(std::strlen(argv0), ' ') << " [--max-steps N] [--max-heap-mb N] [--timeout-ms N]\n"
+              << "       " << std::string(std::strlen(argv0), ' ') << " [--hooks none|trace|count|break] [--break LINE] [--mem-report]\n"
+              << "       " << std::string(std::strlen(argv0), ' ') << " [--snapshot-out FILE | --snapshot FILE] <filename>\n"
+              << "       " << argv0 << " --batch <dir|file> [--copies N] [--threads N] [--scaling] [--show-output] [--no-inline]\n"
+              << "       " << argv0 << " --green <dir|file> [--copies N] [--slice N] [--stack-kb N] [--show-output] [--no-inline]\n"
+              << "       " << argv0 << " --repl [--time] [--workers N] [--grain N]"
+              << std::endl;
+    return 1;
+}
+
+static int batch_main(int argc, char** argv) {
+    BatchOptions options;
+    for (int i = 1; i < argc; ++i) {
+        if (!std::strcmp(argv[i], "--batch") && i + 1 < argc) options.target = argv[++i];
+        else if (!std::strcmp(argv[i], "--copies") && i + 1 < argc) options.copies = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--threads") && i + 1 < argc) options.threads = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--scaling")) options.scaling = true;
+        else if (!std::strcmp(argv[i], "--show-output")) options.show_output = true;
+        else if (!std::strcmp(argv[i], "--no-inline")) options.inline_small = false;
+        else return usage(argv[0]);
+    }
+    if (options.target.empty()) return usage(argv[0]);
+    return run_batch(options);
+}
+
+static int green_main(int argc, char** argv) {
+    GreenOptions options;
+    for (int i = 1; i < argc; ++i) {
+        if (!std::strcmp(argv[i], "--green") && i + 1 < argc) options.target = argv[++i];
+        else if (!std::strcmp(argv[i], "--copies") && i + 1 < argc) options.copies = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--slice") && i + 1 < argc) options.slice = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--stack-kb") && i + 1 < argc) options.stack_kb = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--show-output")) options.show_output = true;
+        else if (!std::strcmp(argv[i], "--no-inline")) options.inline_small = false;
+        else return usage(argv[0]);
+    }
+    if (options.target.empty()) return usage(argv[0]);
+    return run_green(options);
+}
+
+static int repl_main(int argc, char** argv) {
+    ReplOptions options;
+    for (int i = 2; i < argc; ++i) {
+        if (!std::strcmp(argv[i], "--time")) options.timing = true;
+        else if (!std::strcmp(argv[i], "--workers") && i + 1 < argc) options.workers = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--grain") && i + 1 < argc) options.grain = std::atol(argv[++i]);
+        else return usage(argv[0]);
+    }
+    return run_repl(options);
+}
+
 int main(int argc, char** argv) {
-    if (argc != 2) {
-        std::cerr << "Usage: " << argv[0] << " <filename>" << std::endl;
-        return 1;
+    if (argc > 1 && !std::strcmp(argv[1], "--batch")) return batch_main(argc, argv);
+    if (argc > 1 && !std::strcmp(argv[1], "--green")) return green_main(argc, argv);
+    if (argc > 1 && !std::strcmp(argv[1], "--repl")) return repl_main(argc, argv);
+
+    const char* filename = nullptr;
+    const char* profile_out = "profile.folded";
+    bool profile = false;
+    bool quiet = false;
+    bool stats = false;
+    bool module_report = false;
+    bool closures = false;
+    bool inline_small = true;
+    bool inline_report = false;
+    std::string hooks = "none";
+    bool mem_report = false;
+    const char* snapshot_out = nullptr;
+    const char* snapshot_in = nullptr;
+    bool lazy_parse = false;
+    std::set<int> breakpoints;
+    ExecutionContext context;
+    for (int i = 1; i < argc; ++i) {
+        if (!std::strcmp(argv[i], "--quiet")) quiet = true;
+        else if (!std::strcmp(argv[i], "--stats")) stats = true;
+        else if (!std::strcmp(argv[i], "--profile")) profile = true;
+        else if (!std::strcmp(argv[i], "--module-report")) module_report = true;
+        else if (!std::strcmp(argv[i], "--no-quicken")) context.quicken = false;
+        else if (!std::strcmp(argv[i], "--no-inline")) inline_small = false;
+        else if (!std::strcmp(argv[i], "--inline-report")) inline_report = true;
+        else if (!std::strcmp(argv[i], "--lazy-parse")) lazy_parse = true;
+        else if (!std::strcmp(argv[i], "--engine") && i + 1 < argc && !std::strcmp(argv[i + 1], "tree")) ++i, closures = false;
+        else if (!std::strcmp(argv[i], "--engine") && i + 1 < argc && !std::strcmp(argv[i + 1], "closure")) ++i, closures = true;
+        else if (!std::strcmp(argv[i], "--profile-out") && i + 1 < argc) profile = true, profile_out = argv[++i];
+        else if (!std::strcmp(argv[i], "--workers") && i + 1 < argc) context.parallel_workers = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--grain") && i + 1 < argc) context.parallel_grain = std::atol(argv[++i]);
+        else if (!std::strcmp(argv[i], "--max-steps") && i + 1 < argc) context.limits.steps = std::atoll(argv[++i]);
+        else if (!std::strcmp(argv[i], "--max-heap-mb") && i + 1 < argc) context.limits.heap_bytes = std::atoll(argv[++i]) << 20;
+        else if (!std::strcmp(argv[i], "--timeout-ms") && i + 1 < argc) context.limits.timeout_ms = std::atoll(argv[++i]);
+        else if (!std::strcmp(argv[i], "--hooks") && i + 1 < argc) hooks = argv[++i];
+        else if (!std::strcmp(argv[i], "--mem-report")) mem_report = true;
+        else if (!std::strcmp(argv[i], "--snapshot-out") && i + 1 < argc) snapshot_out = argv[++i];
+        else if (!std::strcmp(argv[i], "--snapshot") && i + 1 < argc) snapshot_in = argv[++i];
+        else if (!std::strcmp(argv[i], "--break") && i + 1 < argc) hooks = "break", breakpoints.insert(std::atoi(argv[++i]));
+        else if (argv[i][0] != '-' && !filename) filename = argv[i];
+        else return usage(argv[0]);
     }
+    if (!filename) return usage(argv[0]);
+    if (hooks != "none" && hooks != "trace" && hooks != "count" && hooks != "break") return usage(argv[0]);
+    if (snapshot_out && snapshot_in) return usage(argv[0]);
+    // A snapshot's script runs as a module, and a program run after one is
+    // not the whole program, so neither is inlined.
+    if (snapshot_out || snapshot_in) inline_small = false;
+    // Unparsed bodies hide what they write from the inliner; a snapshot
+    // saves every body, so its script is parsed up front.
+    if (snapshot_out) lazy_parse = false;
+    if (lazy_parse) inline_small = false;
+    // Profiles and hooks report calls and lines as written, so inlined
+    // calls would vanish from them.
+    if (profile || hooks != "none") inline_small = false;
+    if (mem_report) MemoryReport::enable();
 
-    std::ifstream file(argv[1]);
+    std::ifstream file(filename);
     if (!file.is_open()) {
-        std::cerr << "Error opening file: " << argv[1] << std::endl;
+        std::cerr << "Error opening file: " << filename << std::endl;
         return 1;
     }
 
     std::string source((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
     file.close();
 
-    std::cout << "Reading file: " << argv[1] << "\n"; // Add this
-    std::cout << "Raw source:\n" << source << "\n";   // Add this
+    if (!quiet) {
+        std::cout << "Reading file: " << filename << "\n"; // Add this
+        std::cout << "Raw source:\n" << source << "\n";   // Add this
+    }
 
-    Lexer lexer(source);
-    auto tokens = lexer.tokenize();
+    double lex_ms = 0, parse_ms = 0, import_ms = 0, exec_ms = 0;
+    std::unique_ptr<ASTNode> ast;
+    std::vector<std::shared_ptr<const Module>> imports;
+    std::shared_ptr<const Snapshot> snapshot;
+    try {
+        auto start = std::chrono::steady_clock::now();
+        MemoryReport::enter(MemoryPhase::Lex);
+        Lexer lexer(source, true); // Bad characters become parse errors, reported together
+        auto tokens = lexer.tokenize();
+        lex_ms = elapsed_ms(start);
 
-    Parser parser(tokens);
-    auto ast = parser.parse();
+        start = std::chrono::steady_clock::now();
+        MemoryReport::enter(MemoryPhase::Parse); // Imports and checks count as parsing too
+        Parser parser(std::make_shared<const std::vector<Token>>(std::move(tokens)), lazy_parse);
+        ast = parser.parse();
+        std::vector<InlinedSite> inlined;
+        if (inline_small) inlined = inline_calls(static_cast<ProgramNode&>(*ast));
+        resolve_slots(*ast);
+        parse_ms = elapsed_ms(start);
+        if (inline_report) {
+            // One JSON object per inlined call site on stderr, innermost calls first.
+            for (auto& site : inlined) {
+                std::string call = site.receiver == NO_SYMBOL ? "" : symbol_name(site.receiver) + ".";
+                std::cerr << "{\"line\":" << site.line << ",\"call\":\"" << call << symbol_name(site.callee)
+                          << "\",\"nodes\":" << site.size << "}" << std::endl;
+            }
+        }
 
-    PrintVisitor printer;
-    std::cout << "AST:" << std::endl;
-    ast->accept(printer);
+        start = std::chrono::steady_clock::now();
+        ModuleLoader& loader = ModuleLoader::shared();
+        std::string path = module_path(".", filename);
+        imports = loader.load_imports(static_cast<ProgramNode&>(*ast), directory_of(path), path);
+        if (snapshot_out && !imports.empty()) throw std::runtime_error("A script saved with --snapshot-out cannot import modules");
+        if (snapshot_in) snapshot = Snapshot::load(snapshot_in);
+        import_ms = elapsed_ms(start);
 
-    std::cout << "\nExecution:" << std::endl;
-    InterpreterVisitor interpreter;
-    ast->accept(interpreter);
+        start = std::chrono::steady_clock::now();
+        check_types(static_cast<ProgramNode&>(*ast), imports.empty() && !snapshot_out && !snapshot_in && !lazy_parse);
+        parse_ms += elapsed_ms(start);
+        if (module_report) {
+            // One JSON object per imported module on stderr, in run order.
+            for (auto& module : loader.last_report()) {
+                char line[64];
+                std::snprintf(line, sizeof(line), "\"compile_ms\":%.3f,\"reused\":%s}", module.compile_ms,
+                              module.reused ? "true" : "false");
+                std::cerr << "{\"module\":\"" << module.path << "\"," << line << std::endl;
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
 
-    return 0;
+    if (!quiet) {
+        PrintVisitor printer;
+        std::cout << "AST:" << std::endl;
+        ast->accept(printer);
+        std::cout << "\nExecution:" << std::endl;
+    }
+
+    Profiler profiler;
+    if (profile) context.profiler = &profiler;
+    int status = 0;
+    InterpreterVisitor interpreter(context);
+    ClosureEngine engine(context);
+    // Instrumented instantiations of the tree interpreter, for --hooks.
+    BasicInterpreter<TraceHooks> tracer(context);
+    BasicInterpreter<CountHooks> counter(context);
+    BasicInterpreter<BreakpointHooks> debugger(context, BreakpointHooks(breakpoints));
+    auto start = std::chrono::steady_clock::now();
+    MemoryReport::enter(MemoryPhase::Exec);
+    try {
+        HeapQuota::Scope quota(context.heap_budget());
+        context.start_limits();
+        if (snapshot) snapshot->restore(context);
+        // The profiler and hook policies live in the tree interpreter, so
+        // --profile and --hooks keep the tree engine.
+        if (snapshot_out) {
+            interpreter.run_module(static_cast<ProgramNode&>(*ast));
+            write_snapshot(snapshot_out, static_cast<ProgramNode&>(*ast), context);
+            std::ifstream image(snapshot_out, std::ios::binary | std::ios::ate);
+            std::cerr << "Snapshot written to " << snapshot_out << " (" << image.tellg() << " bytes)" << std::endl;
+        } else if (hooks == "trace") {
+            run_tree(tracer, imports, *ast);
+        } else if (hooks == "count") {
+            run_tree(counter, imports, *ast);
+        } else if (hooks == "break") {
+            run_tree(debugger, imports, *ast);
+        } else if (closures && !profile) {
+            for (auto& module : imports) engine.run_module(*module->ast);
+            engine.run(static_cast<ProgramNode&>(*ast));
+        } else {
+            run_tree(interpreter, imports, *ast);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        status = 1;
+    }
+    std::cout.flush();
+    exec_ms = elapsed_ms(start);
+    if (hooks == "count") counter.policy().write_report(std::cerr);
+    if (mem_report) {
+        std::cerr << "\nMemory:\n";
+        MemoryReport::write_report(std::cerr);
+    }
+
+    if (stats) {
+        // One JSON object on stderr, consumed by bench/run.sh.
+        char line[320];
+        QuickeningCounters& quickening = quickening_counters();
+        std::snprintf(line, sizeof(line),
+                      "{\"lex_ms\":%.3f,\"parse_ms\":%.3f,\"import_ms\":%.3f,\"exec_ms\":%.3f,\"peak_rss_kb\":%ld,"
+                      "\"quickened\":%ld,\"deopted\":%ld,\"status\":%d}",
+                      lex_ms, parse_ms, import_ms, exec_ms, peak_rss_kb(), quickening.quickened.load(),
+                      quickening.deopted.load(), status);
+        std::cerr << line << std::endl;
+    }
+
+    if (profile) {
+        profiler.finish();
+        std::cerr << "\nProfile:\n";
+        profiler.write_report(std::cerr, source);
+        std::ofstream folded(profile_out);
+        profiler.write_collapsed(folded);
+        std::cerr << "Collapsed stacks written to " << profile_out << std::endl;
+    }
+    return status;
 }
\ No newline at end of file
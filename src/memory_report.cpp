@@ -0,0 +1,178 @@
+#include "memory_report.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <unordered_map>
+#include <vector>
+#if defined(__GLIBC__)
+#include <malloc.h>
+#define HAVE_USABLE_SIZE 1
+#endif
+
+namespace {
+
+struct Counter {
+    std::atomic<long long> count{0};
+    std::atomic<long long> bytes{0};
+
+    void add(size_t n) {
+        count.fetch_add(1, std::memory_order_relaxed);
+        bytes.fetch_add(static_cast<long long>(n), std::memory_order_relaxed);
+    }
+};
+
+struct LiveInstances {
+    long long count = 0;
+    long long bytes = 0;
+    long long peak_count = 0; // At the moment bytes peaked
+    long long peak_bytes = 0;
+};
+
+Counter phases[MEMORY_PHASES];
+Counter categories[MEMORY_CATEGORIES];
+std::atomic<long long> live_bytes(0);
+std::atomic<long long> peak_bytes(0);
+std::mutex instances_mutex;
+std::unordered_map<Symbol, LiveInstances>* live_instances; // Allocated on enable, never freed
+
+const char* const PHASE_NAMES[MEMORY_PHASES] = {"startup", "lex", "parse", "exec"};
+const char* const CATEGORY_NAMES[MEMORY_CATEGORIES] = {"other", "tokens", "ast", "scopes", "strings", "instances"};
+
+void* allocate(size_t size) {
+    for (;;) {
+        void* memory = std::malloc(size ? size : 1);
+        if (memory) {
+            if (MemoryReport::enabled) MemoryReport::allocated(memory, size);
+            return memory;
+        }
+        std::new_handler handler = std::get_new_handler();
+        if (!handler) throw std::bad_alloc();
+        handler();
+    }
+}
+
+void release(void* memory) {
+    if (memory && MemoryReport::enabled) MemoryReport::freed(memory);
+    std::free(memory);
+}
+
+} // namespace
+
+bool MemoryReport::enabled = false;
+std::atomic<int> MemoryReport::phase(static_cast<int>(MemoryPhase::Startup));
+thread_local MemoryCategory MemoryReport::tag = MemoryCategory::Other;
+
+void MemoryReport::allocated(void* memory, size_t bytes) {
+    phases[phase.load(std::memory_order_relaxed)].add(bytes);
+    if (tag != MemoryCategory::Other) categories[static_cast<int>(tag)].add(bytes);
+#ifdef HAVE_USABLE_SIZE
+    long long usable = static_cast<long long>(malloc_usable_size(memory));
+    long long live = live_bytes.fetch_add(usable, std::memory_order_relaxed) + usable;
+    long long peak = peak_bytes.load(std::memory_order_relaxed);
+    while (live > peak && !peak_bytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {}
+#else
+    (void)memory;
+#endif
+}
+
+void MemoryReport::freed(void* memory) {
+#ifdef HAVE_USABLE_SIZE
+    live_bytes.fetch_sub(static_cast<long long>(malloc_usable_size(memory)), std::memory_order_relaxed);
+#else
+    (void)memory;
+#endif
+}
+
+void MemoryReport::record(MemoryCategory category, size_t bytes) {
+    categories[static_cast<int>(category)].add(bytes);
+}
+
+void MemoryReport::instance_created(Symbol blueprint, size_t bytes) {
+    record(MemoryCategory::Instances, bytes);
+    std::lock_guard<std::mutex> lock(instances_mutex);
+    if (!live_instances) live_instances = new std::unordered_map<Symbol, LiveInstances>();
+    LiveInstances& live = (*live_instances)[blueprint];
+    ++live.count;
+    live.bytes += static_cast<long long>(bytes);
+    if (live.bytes > live.peak_bytes) {
+        live.peak_bytes = live.bytes;
+        live.peak_count = live.count;
+    }
+}
+
+void MemoryReport::instance_destroyed(Symbol blueprint, size_t bytes) {
+    std::lock_guard<std::mutex> lock(instances_mutex);
+    if (!live_instances) return;
+    LiveInstances& live = (*live_instances)[blueprint];
+    --live.count;
+    live.bytes -= static_cast<long long>(bytes);
+}
+
+void MemoryReport::write_report(std::ostream& out, size_t max_blueprints) {
+    char line[256];
+    out << "Allocations by phase:\n";
+    std::snprintf(line, sizeof(line), "  %10s %12s %14s\n", "phase", "allocs", "bytes");
+    out << line;
+    for (int p = 0; p < MEMORY_PHASES; ++p) {
+        std::snprintf(line, sizeof(line), "  %10s %12lld %14lld\n", PHASE_NAMES[p], phases[p].count.load(),
+                      phases[p].bytes.load());
+        out << line;
+    }
+    out << "Allocations by category:\n";
+    std::snprintf(line, sizeof(line), "  %10s %12s %14s\n", "category", "allocs", "bytes");
+    out << line;
+    for (int c = 1; c < MEMORY_CATEGORIES; ++c) {
+        std::snprintf(line, sizeof(line), "  %10s %12lld %14lld\n", CATEGORY_NAMES[c], categories[c].count.load(),
+                      categories[c].bytes.load());
+        out << line;
+    }
+#ifdef HAVE_USABLE_SIZE
+    std::snprintf(line, sizeof(line), "Peak live heap: %lld bytes, live at exit: %lld bytes\n", peak_bytes.load(),
+                  live_bytes.load());
+    out << line;
+#else
+    out << "Peak live heap: not tracked on this platform\n";
+#endif
+
+    std::vector<std::pair<Symbol, LiveInstances>> blueprints;
+    {
+        std::lock_guard<std::mutex> lock(instances_mutex);
+        if (live_instances) {
+            blueprints.assign(live_instances->begin(), live_instances->end());
+        }
+    }
+    std::sort(blueprints.begin(), blueprints.end(),
+              [](const std::pair<Symbol, LiveInstances>& a, const std::pair<Symbol, LiveInstances>& b) {
+                  return a.second.peak_bytes > b.second.peak_bytes;
+              });
+    if (blueprints.size() > max_blueprints) blueprints.resize(max_blueprints);
+    out << "Live instances by blueprint (by peak bytes):\n";
+    std::snprintf(line, sizeof(line), "  %10s %14s %10s %14s  %s\n", "peak", "peak bytes", "at exit", "bytes",
+                  "blueprint");
+    out << line;
+    for (auto& entry : blueprints) {
+        const LiveInstances& live = entry.second;
+        std::snprintf(line, sizeof(line), "  %10lld %14lld %10lld %14lld  %s\n", live.peak_count, live.peak_bytes,
+                      live.count, live.bytes, symbol_name(entry.first).c_str());
+        out << line;
+    }
+}
+
+// Replacements for the global allocation functions, so every allocation in
+// the program can be counted while the report is enabled.
+void* operator new(std::size_t size) { return allocate(size); }
+void* operator new[](std::size_t size) { return allocate(size); }
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    try {
+        return allocate(size);
+    } catch (...) {
+        return nullptr;
+    }
+}
+void* operator new[](std::size_t size, const std::nothrow_t& tag) noexcept { return operator new(size, tag); }
+void operator delete(void* memory) noexcept { release(memory); }
+void operator delete[](void* memory) noexcept { release(memory); }
+void operator delete(void* memory, const std::nothrow_t&) noexcept { release(memory); }
+void operator delete[](void* memory, const std::nothrow_t&) noexcept { release(memory); }
@@ -0,0 +1,189 @@
+#include "modules.h"
+#include "lexer.h"
+#include "parser.h"
+#include "resolver.h"
+#include "semantic.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <stdexcept>
+#include <sys/stat.h>
+
+namespace {
+
+double ms_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool stat_file(const std::string& path, long long& mtime_ns, long long& size) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) return false;
+#if defined(__APPLE__)
+    mtime_ns = st.st_mtimespec.tv_sec * 1000000000LL + st.st_mtimespec.tv_nsec;
+#elif defined(_WIN32)
+    mtime_ns = st.st_mtime * 1000000000LL;
+#else
+    mtime_ns = st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+#endif
+    size = st.st_size;
+    return true;
+}
+
+// A module's place in the dependency-order walk.
+enum class Visit { New, Active, Done };
+
+} // namespace
+
+std::string directory_of(const std::string& path) {
+    size_t slash = path.find_last_of('/');
+    if (slash == std::string::npos) return ".";
+    return slash == 0 ? "/" : path.substr(0, slash);
+}
+
+std::string module_path(const std::string& dir, const std::string& path) {
+    std::string joined = !path.empty() && path[0] == '/' ? path : dir + "/" + path;
+#ifndef _WIN32
+    char resolved[PATH_MAX];
+    if (realpath(joined.c_str(), resolved)) return resolved;
+#endif
+    return joined; // Missing files keep the joined path for the error message
+}
+
+ModuleLoader::ModuleLoader(unsigned threads) : threads(threads) {}
+ModuleLoader::~ModuleLoader() {}
+
+ModuleLoader& ModuleLoader::shared() {
+    static ModuleLoader loader;
+    return loader;
+}
+
+// The cached module while the file is unchanged, else a fresh parse of it.
+std::shared_ptr<const Module> ModuleLoader::fetch(const std::string& path, bool& reused) {
+    long long mtime_ns, size;
+    if (!stat_file(path, mtime_ns, size)) throw std::runtime_error("Cannot open module " + path);
+    {
+        std::lock_guard<std::mutex> lock(cache_mutex);
+        auto it = cache.find(path);
+        if (it != cache.end() && it->second->mtime_ns == mtime_ns && it->second->size == size) {
+            reused = true;
+            return it->second;
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::ifstream file(path);
+    if (!file.is_open()) throw std::runtime_error("Cannot open module " + path);
+    std::string source((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    std::shared_ptr<Module> module(new Module());
+    module->path = path;
+    module->mtime_ns = mtime_ns;
+    module->size = size;
+    try {
+        Lexer lexer(source, true);
+        Parser parser(lexer.tokenize());
+        module->ast.reset(static_cast<ProgramNode*>(parser.parse().release()));
+        resolve_slots(*module->ast);
+        check_types(*module->ast, false);
+    } catch (const std::exception& e) {
+        throw std::runtime_error(path + ": " + e.what());
+    }
+    std::string dir = directory_of(path);
+    for (auto& stmt : module->ast->statements) {
+        if (auto* import = dynamic_cast<ImportNode*>(stmt.get())) module->imports.push_back(module_path(dir, import->path));
+    }
+    module->compile_ms = ms_since(start);
+
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    cache[path] = module;
+    reused = false;
+    return module;
+}
+
+std::vector<std::shared_ptr<const Module>> ModuleLoader::load_imports(const ProgramNode& program, const std::string& dir,
+                                                                      const std::string& importer) {
+    std::vector<std::string> roots;
+    for (auto& stmt : program.statements) {
+        if (auto* import = dynamic_cast<ImportNode*>(stmt.get())) roots.push_back(module_path(dir, import->path));
+    }
+    std::lock_guard<std::mutex> load_lock(load_mutex);
+    report.clear();
+    if (roots.empty()) return std::vector<std::shared_ptr<const Module>>();
+    if (!pool) pool.reset(new ThreadPool(threads ? threads : ThreadPool::hardware_threads()));
+
+    // Discover the graph: each module is submitted the first time any
+    // importer names it, and submits its own imports once it has parsed.
+    struct Loaded {
+        std::shared_ptr<const Module> module;
+        bool reused = false;
+        std::string error;
+    };
+    std::mutex found_mutex;
+    std::unordered_map<std::string, Loaded> found;
+    std::function<void(const std::string&)> discover = [&](const std::string& path) {
+        {
+            std::lock_guard<std::mutex> lock(found_mutex);
+            if (path == importer || !found.insert(std::make_pair(path, Loaded())).second) return;
+        }
+        pool->submit([&, path] {
+            Loaded loaded;
+            try {
+                loaded.module = fetch(path, loaded.reused);
+            } catch (const std::exception& e) {
+                loaded.error = e.what();
+            }
+            {
+                std::lock_guard<std::mutex> lock(found_mutex);
+                found[path] = loaded;
+            }
+            if (loaded.module) {
+                for (auto& next : loaded.module->imports) discover(next);
+            }
+        });
+    };
+    for (auto& root : roots) discover(root);
+    pool->wait();
+
+    std::vector<std::string> errors;
+    for (auto& entry : found) {
+        if (!entry.second.module) errors.push_back(entry.second.error);
+    }
+    if (!errors.empty()) {
+        std::sort(errors.begin(), errors.end());
+        std::string message;
+        for (auto& error : errors) message += (message.empty() ? "" : "\n") + error;
+        throw std::runtime_error(message);
+    }
+
+    // Dependency order is the post-order of a walk in import order; meeting
+    // a module that is still on the walk's path is a cycle.
+    std::vector<std::shared_ptr<const Module>> order;
+    std::unordered_map<std::string, Visit> state;
+    std::vector<std::string> path;
+    if (!importer.empty()) {
+        state[importer] = Visit::Active;
+        path.push_back(importer);
+    }
+    std::function<void(const std::string&)> walk = [&](const std::string& name) {
+        Visit& visit = state[name];
+        if (visit == Visit::Done) return;
+        if (visit == Visit::Active) {
+            std::string cycle;
+            for (auto it = std::find(path.begin(), path.end(), name); it != path.end(); ++it) cycle += *it + " -> ";
+            throw std::runtime_error("Import cycle: " + cycle + name);
+        }
+        visit = Visit::Active;
+        path.push_back(name);
+        const Loaded& loaded = found[name];
+        for (auto& next : loaded.module->imports) walk(next);
+        path.pop_back();
+        state[name] = Visit::Done;
+        order.push_back(loaded.module);
+        report.push_back(Report{name, loaded.reused ? 0 : loaded.module->compile_ms, loaded.reused});
+    };
+    for (auto& root : roots) walk(root);
+    return order;
+}
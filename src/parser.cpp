@@ -1,31 +1,87 @@
 #include "parser.h"
+#include "memory_report.h"
 #include <stdexcept>
 
-Parser::Parser(const std::vector<Token>& t) : tokens(t), pos(0) {}
+namespace {
+const Token END_OF_INPUT = {TOK_EOF, "", 0};
+}
+
+Parser::Parser(std::vector<Token> t) : owned(std::move(t)), tokens(&owned), pos(0) {}
+Parser::Parser(const std::vector<Token>* t) : tokens(t), pos(0) {}
+Parser::Parser(std::shared_ptr<const std::vector<Token>> t, bool lazy_bodies)
+    : shared(std::move(t)), tokens(shared.get()), pos(0), lazy_bodies(lazy_bodies) {}
 
-Token Parser::peek()                         { return pos < tokens.size() ? tokens[pos] : Token{TOK_EOF, "", 0};         }
-Token Parser::advance()                      { return pos++ < tokens.size() ? tokens[pos - 1] : Token{TOK_EOF, "", 0};   }
-bool  Parser::match(TokenType type)          { return peek().type == type;                                               }
-bool  Parser::at_end()                       { return match(TOK_EOF);                                                    }
-Token Parser::peek_next()                    { return pos + 1 < tokens.size() ? tokens[pos + 1] : Token{TOK_EOF, "", 0}; }
-int   Parser::get_precedence(TokenType type) { return 0;                                                                 }
+const Token& Parser::peek()                  { return pos < tokens->size() ? (*tokens)[pos] : END_OF_INPUT;         }
+const Token& Parser::advance()               { return pos++ < tokens->size() ? (*tokens)[pos - 1] : END_OF_INPUT;   }
+bool  Parser::match(TokenType type)          { return peek().type == type;                                          }
+bool  Parser::at_end()                       { return match(TOK_EOF);                                               }
+const Token& Parser::peek_next()             { return pos + 1 < tokens->size() ? (*tokens)[pos + 1] : END_OF_INPUT; }
+int   Parser::get_precedence(TokenType type) { return 0;                                                            }
 
 Token Parser::expect(TokenType type, const std::string& msg) {
     if (!match(type)) {
-        Token t = peek();
+        const Token& t = peek();
+        if (t.type == TOK_ERROR) throw std::runtime_error(t.value);
         throw std::runtime_error(msg + " but got '" + t.value + "' at line " + std::to_string(t.line));
     }
     return advance();
 }
 
 std::unique_ptr<ASTNode> Parser::parse() {
+    MemoryReport::Tag tag(MemoryCategory::Ast);
     auto root = std::unique_ptr<ProgramNode>(new ProgramNode(1));
+    std::string errors;
     while (!match(TOK_EOF)) {
-        root->statements.push_back(statement());
+        std::string error;
+        auto stmt = next_statement(error);
+        if (stmt) {
+            root->statements.push_back(std::move(stmt));
+        } else {
+            errors += (errors.empty() ? "" : "\n") + error;
+        }
     }
+    if (!errors.empty()) throw std::runtime_error(errors);
     return root;
 }
 
+std::unique_ptr<ASTNode> Parser::next_statement(std::string& error) {
+    if (match(TOK_ERROR)) {
+        error = advance().value;
+        return nullptr;
+    }
+    size_t start = pos;
+    try {
+        if (match(TOK_IMPORT)) return import_stmt();
+        return statement();
+    } catch (const std::exception& e) {
+        error = e.what();
+        pos = start;
+        synchronize();
+        return nullptr;
+    }
+}
+
+// Skips the statement starting at the current token: through its ';' or
+// its closing '}' (and any else_when/otherwise branches after it). It stops
+// early before a define or blueprint that cannot belong to the statement:
+// one at the same depth, or any at all unless the statement is a blueprint,
+// so a missing '}' in one function does not swallow the functions after it.
+void Parser::synchronize() {
+    bool in_blueprint = match(TOK_BLUEPRINT);
+    int depth = 0;
+    do {
+        TokenType type = advance().type;
+        if (type == TOK_LBRACE) {
+            ++depth;
+        } else if (type == TOK_RBRACE && --depth <= 0) {
+            if (!match(TOK_ELSE_WHEN) && !match(TOK_OTHERWISE)) break;
+            depth = 0;
+        } else if (type == TOK_SEMICOLON && depth == 0) {
+            break;
+        }
+    } while (!at_end() && !((depth == 0 || !in_blueprint) && (match(TOK_BLUEPRINT) || match(TOK_DEFINE))));
+}
+
 std::unique_ptr<ASTNode> Parser::statement() {
     if (match(TOK_BLUEPRINT))                 return blueprint();
     if (match(TOK_VAR) || match(TOK_INTEGER)) return var_decl();
@@ -33,25 +89,47 @@ std::unique_ptr<ASTNode> Parser::statement() {
     if (match(TOK_DEFINE))                    return function();
     if (match(TOK_CHECK_IF) || match(TOK_IF)) return if_stmt();
     if (match(TOK_REPEAT_WHILE))              return while_stmt();
+    if (match(TOK_CHOOSE))                    return choose_stmt();
+    if (match(TOK_PARALLEL_REPEAT))           return parallel_repeat_stmt();
+    if (match(TOK_ACCUMULATE))                return accumulate_stmt();
     if (match(TOK_LETS_PRINT))                return print_stmt();
     if (match(TOK_SCANNING_USER_INPUT))       return input_stmt();
     if (match(TOK_YIELD))                     return yield_stmt();
     if (match(TOK_INSTANCE))                  return instance_stmt();
+    if (match(TOK_IMPORT)) {
+        throw std::runtime_error("import is only allowed at the top level, at line " + std::to_string(peek().line));
+    }
     if (match(TOK_IDENTIFIER)) {
         Token id = advance();
         if (match(TOK_ASSIGN)) {
             return parse_assignment(id);
+        } else if (match(TOK_LBRACKET)) {
+            advance();
+            auto node = std::unique_ptr<IndexAssignmentNode>(new IndexAssignmentNode(id.symbol, id.line));
+            node->index = expression();
+            expect(TOK_RBRACKET, "Expected ']' after index");
+            expect(TOK_ASSIGN, "Expected ':=' after indexed element");
+            node->value = expression();
+            expect(TOK_SEMICOLON, "Expected ';' after assignment");
+            return node;
         } else if (match(TOK_DOT)) {
             advance();
             Token method = expect(
                 TOK_IDENTIFIER, 
                 "Expected method name after '.'"
             );
+            if (match(TOK_ASSIGN)) {
+                advance();
+                auto node = std::unique_ptr<FieldAssignmentNode>(new FieldAssignmentNode(id.symbol, method.symbol, id.line));
+                node->value = expression();
+                expect(TOK_SEMICOLON, "Expected ';' after assignment");
+                return node;
+            }
             expect(
                 TOK_LPAREN, 
                 "Expected '(' after method name"
             );
-            auto call = std::unique_ptr<CallNode>(new CallNode(id.value + "." + method.value, id.line));
+            auto call = std::unique_ptr<CallNode>(new CallNode(id.symbol, method.symbol, id.line));
             if (!match(TOK_RPAREN)) {
                 do {
                     call->arguments.push_back(expression());
@@ -71,7 +149,7 @@ std::unique_ptr<ASTNode> Parser::statement() {
             return call;
         } else if (match(TOK_LPAREN)) {
             advance();
-            auto call = std::unique_ptr<CallNode>(new CallNode(id.value, id.line));
+            auto call = std::unique_ptr<CallNode>(new CallNode(NO_SYMBOL, id.symbol, id.line));
             if (!match(TOK_RPAREN)) {
                 do {
                     call->arguments.push_back(expression());
@@ -90,7 +168,7 @@ std::unique_ptr<ASTNode> Parser::statement() {
             );
             return call;
         } else {
-            auto expr = std::unique_ptr<IdentifierNode>(new IdentifierNode(id.value, id.line));
+            auto expr = std::unique_ptr<IdentifierNode>(new IdentifierNode(id.symbol, id.line));
             if (match(TOK_SEMICOLON)) advance();
             return expr;
         }
@@ -104,14 +182,28 @@ std::unique_ptr<ASTNode> Parser::blueprint() {
     int line = expect(TOK_BLUEPRINT, "Expected 'blueprint'").line;
     Token name = expect(TOK_IDENTIFIER, "Expected blueprint name");
     expect(TOK_LBRACE, "Expected '{'");
-    auto node = std::unique_ptr<BlueprintNode>(new BlueprintNode(name.value, line));
+    auto node = std::unique_ptr<BlueprintNode>(new BlueprintNode(name.symbol, line));
     while (!match(TOK_RBRACE)) {
         if (match(TOK_DEFINE)) {
             node->body.push_back(function());
+            auto& method = static_cast<FunctionNode&>(*node->body.back());
+            if (method.lazy) method.lazy->fields = &node->field_layout;
         } else if (match(TOK_BLUEPRINT)) {
             node->body.push_back(blueprint());
+        } else if (match(TOK_VAR) || match(TOK_INTEGER) || match(TOK_LET) || match(TOK_CONST)) {
+            Token decl = advance();
+            Token id = expect(TOK_IDENTIFIER, "Expected field name");
+            if (node->field_layout.find(id.symbol) >= 0) {
+                throw std::runtime_error("Duplicate field '" + id.value + "' at line " + std::to_string(id.line));
+            }
+            expect(TOK_ASSIGN, "Expected ':='");
+            auto field = std::unique_ptr<VarDeclNode>(new VarDeclNode(decl.value, id.symbol, decl.line));
+            field->initializer = expression();
+            expect(TOK_SEMICOLON, "Expected ';'");
+            node->field_layout.add(id.symbol);
+            node->fields.push_back(std::move(field));
         } else {
-            throw std::runtime_error("Expected function or blueprint definition in blueprint at line " + std::to_string(peek().line));
+            throw std::runtime_error("Expected field, function or blueprint definition in blueprint at line " + std::to_string(peek().line));
         }
     }
     expect(TOK_RBRACE, "Expected '}'");
@@ -124,7 +216,7 @@ std::unique_ptr<ASTNode> Parser::var_decl() {
     expect(TOK_ASSIGN, "Expected ':='");
     auto expr = expression();
     expect(TOK_SEMICOLON, "Expected ';'");
-    auto node = std::unique_ptr<VarDeclNode>(new VarDeclNode(decl.value, id.value, decl.line));
+    auto node = std::unique_ptr<VarDeclNode>(new VarDeclNode(decl.value, id.symbol, decl.line));
     node->initializer = std::move(expr);
     return node;
 }
@@ -136,7 +228,7 @@ std::unique_ptr<ASTNode> Parser::let_const_decl() {
     expect(TOK_ASSIGN, "Expected ':='");
     auto expr = expression();
     expect(TOK_SEMICOLON, "Expected ';'");
-    auto node = std::unique_ptr<LetConstDeclNode>(new LetConstDeclNode(is_const, id.value, line));
+    auto node = std::unique_ptr<LetConstDeclNode>(new LetConstDeclNode(is_const, id.symbol, line));
     node->initializer = std::move(expr);
     return node;
 }
@@ -144,12 +236,12 @@ std::unique_ptr<ASTNode> Parser::let_const_decl() {
 std::unique_ptr<ASTNode> Parser::function() {
     int line = expect(TOK_DEFINE, "Expected 'define'").line;
     Token name = expect(TOK_IDENTIFIER, "Expected function name");
-    auto node = std::unique_ptr<FunctionNode>(new FunctionNode(name.value, line));
+    auto node = std::unique_ptr<FunctionNode>(new FunctionNode(name.symbol, line));
     expect(TOK_LPAREN, "Expected '(' after function name");
     if (!match(TOK_RPAREN)) {
         do {
             Token param = expect(TOK_IDENTIFIER, "Expected parameter name");
-            node->parameters.push_back(param.value);
+            node->parameters.push_back(param.symbol);
             if (match(TOK_COMMA)) advance();
         } while (!match(TOK_RPAREN));
         expect(TOK_RPAREN, "Expected ')' after parameters");
@@ -157,6 +249,10 @@ std::unique_ptr<ASTNode> Parser::function() {
         advance();
     }
     expect(TOK_LBRACE, "Expected '{' after function definition");
+    if (lazy_bodies) {
+        skip_body(*node);
+        return node;
+    }
     while (!match(TOK_RBRACE)) {
         node->body.push_back(statement());
     }
@@ -164,6 +260,33 @@ std::unique_ptr<ASTNode> Parser::function() {
     return node;
 }
 
+// Steps over the body after its '{' and records where it was.
+void Parser::skip_body(FunctionNode& function) {
+    std::unique_ptr<LazyBody> body(new LazyBody());
+    body->tokens = shared;
+    body->begin = pos;
+    body->fields = nullptr;
+    for (int depth = 0; depth > 0 || !match(TOK_RBRACE); advance()) {
+        if (at_end()) break;
+        if (match(TOK_LBRACE)) ++depth;
+        if (match(TOK_RBRACE)) --depth;
+    }
+    body->end = pos;
+    expect(TOK_RBRACE, "Expected '}'");
+    function.lazy = std::move(body);
+}
+
+std::vector<std::unique_ptr<ASTNode>> Parser::skipped_body(const LazyBody& body) {
+    MemoryReport::Tag tag(MemoryCategory::Ast);
+    std::vector<std::unique_ptr<ASTNode>> statements;
+    seek(body.begin);
+    while (position() < body.end) statements.push_back(statement());
+    if (position() != body.end) { // A statement ran past the closing '}'
+        throw std::runtime_error("Expected '}' at line " + std::to_string((*tokens)[body.end].line));
+    }
+    return statements;
+}
+
 std::unique_ptr<ASTNode> Parser::if_stmt() {
     int line = (match(TOK_CHECK_IF) ? expect(TOK_CHECK_IF, "Expected 'check_if'") : expect(TOK_IF, "Expected 'if'")).line;
     expect(TOK_LPAREN, "Expected '(' before condition");
@@ -210,6 +333,51 @@ std::unique_ptr<ASTNode> Parser::if_stmt() {
     return node;
 }
 
+std::unique_ptr<ASTNode> Parser::choose_stmt() {
+    int line = expect(TOK_CHOOSE, "Expected 'choose'").line;
+    expect(TOK_LPAREN, "Expected '(' before choose subject");
+    auto node = std::unique_ptr<ChooseNode>(new ChooseNode(line));
+    node->subject = expression();
+    expect(TOK_RPAREN, "Expected ')' after choose subject");
+    expect(TOK_LBRACE, "Expected '{'");
+    while (match(TOK_WHEN)) {
+        int case_line = advance().line;
+        std::vector<ChooseNode::Label> labels;
+        do {
+            if (!labels.empty()) advance(); // Consume ','
+            bool negative = match(TOK_MINUS);
+            if (negative) advance();
+            if (match(TOK_STRING) && !negative) {
+                Token text = advance();
+                labels.push_back(ChooseNode::Label{true, 0, text.symbol, text.line});
+            } else {
+                Token number = expect(TOK_NUMBER, "Expected integer or string case label");
+                labels.push_back(ChooseNode::Label{false, std::stoi((negative ? "-" : "") + number.value), NO_SYMBOL, number.line});
+            }
+        } while (match(TOK_COMMA));
+        expect(TOK_LBRACE, "Expected '{' after case labels");
+        auto body = std::unique_ptr<ProgramNode>(new ProgramNode(case_line));
+        while (!match(TOK_RBRACE)) {
+            body->statements.push_back(statement());
+        }
+        expect(TOK_RBRACE, "Expected '}'");
+        node->labels.push_back(std::move(labels));
+        node->cases.push_back(std::move(body));
+    }
+    if (match(TOK_OTHERWISE)) {
+        int otherwise_line = advance().line;
+        expect(TOK_LBRACE, "Expected '{'");
+        node->otherwise.reset(new ProgramNode(otherwise_line));
+        while (!match(TOK_RBRACE)) {
+            node->otherwise->statements.push_back(statement());
+        }
+        expect(TOK_RBRACE, "Expected '}'");
+    }
+    expect(TOK_RBRACE, "Expected 'when', 'otherwise' or '}' in choose");
+    node->build_dispatch();
+    return node;
+}
+
 std::unique_ptr<ASTNode> Parser::while_stmt() {
     int line = expect(TOK_REPEAT_WHILE, "Expected 'repeat_while'").line;
     expect(TOK_LPAREN, "Expected '(' before condition");
@@ -227,6 +395,37 @@ std::unique_ptr<ASTNode> Parser::while_stmt() {
     return node;
 }
 
+std::unique_ptr<ASTNode> Parser::parallel_repeat_stmt() {
+    int line = expect(TOK_PARALLEL_REPEAT, "Expected 'parallel_repeat'").line;
+    auto node = std::unique_ptr<ParallelForNode>(new ParallelForNode(line));
+    expect(TOK_LPAREN, "Expected '(' after 'parallel_repeat'");
+    node->counter = expect(TOK_IDENTIFIER, "Expected loop counter name").symbol;
+    expect(TOK_ASSIGN, "Expected ':=' after loop counter");
+    node->start = expression();
+    expect(TOK_UNTIL, "Expected 'until'");
+    node->end = expression();
+    expect(TOK_RPAREN, "Expected ')' after range");
+    if (match(TOK_ACCUMULATE)) {
+        advance();
+        node->accumulator = expect(TOK_IDENTIFIER, "Expected accumulator name").symbol;
+    }
+    expect(TOK_LBRACE, "Expected '{'");
+    node->body = std::unique_ptr<ProgramNode>(new ProgramNode(line));
+    while (!match(TOK_RBRACE)) {
+        node->body->statements.push_back(statement());
+    }
+    expect(TOK_RBRACE, "Expected '}'");
+    return node;
+}
+
+std::unique_ptr<ASTNode> Parser::accumulate_stmt() {
+    int line = expect(TOK_ACCUMULATE, "Expected 'accumulate'").line;
+    auto node = std::unique_ptr<AccumulateNode>(new AccumulateNode(line));
+    node->expression = expression();
+    expect(TOK_SEMICOLON, "Expected ';' after accumulate");
+    return node;
+}
+
 std::unique_ptr<ASTNode> Parser::print_stmt() {
     int line = expect(TOK_LETS_PRINT, "Expected 'lets_print'").line;
     expect(TOK_LBRACE, "Expected '{' before expression");
@@ -266,7 +465,14 @@ std::unique_ptr<ASTNode> Parser::instance_stmt() {
     Token blueprint = expect(TOK_IDENTIFIER, "Expected blueprint name");
     Token name = expect(TOK_IDENTIFIER, "Expected instance name");
     expect(TOK_SEMICOLON, "Expected ';'");
-    return std::unique_ptr<InstanceNode>(new InstanceNode(blueprint.value, name.value, line));
+    return std::unique_ptr<InstanceNode>(new InstanceNode(blueprint.symbol, name.symbol, line));
+}
+
+std::unique_ptr<ASTNode> Parser::import_stmt() {
+    int line = expect(TOK_IMPORT, "Expected 'import'").line;
+    Token path = expect(TOK_STRING, "Expected a module path string after 'import'");
+    expect(TOK_SEMICOLON, "Expected ';' after import");
+    return std::unique_ptr<ImportNode>(new ImportNode(path.value, line));
 }
 
 std::unique_ptr<ASTNode> Parser::assignment() {
@@ -274,7 +480,7 @@ std::unique_ptr<ASTNode> Parser::assignment() {
     expect(TOK_ASSIGN, "Expected ':='");
     auto value = expression();
     expect(TOK_SEMICOLON, "Expected ';'");
-    auto node = std::unique_ptr<AssignmentNode>(new AssignmentNode(id.value, id.line));
+    auto node = std::unique_ptr<AssignmentNode>(new AssignmentNode(id.symbol, id.line));
     node->value = std::move(value);
     return node;
 }
@@ -283,7 +489,7 @@ std::unique_ptr<ASTNode> Parser::parse_assignment(const Token& id) {
     expect(TOK_ASSIGN, "Expected ':=' after identifier");
     auto value = expression();
     expect(TOK_SEMICOLON, "Expected ';' after assignment");
-    auto node = std::unique_ptr<AssignmentNode>(new AssignmentNode(id.value, id.line));
+    auto node = std::unique_ptr<AssignmentNode>(new AssignmentNode(id.symbol, id.line));
     node->value = std::move(value);
     return node;
 }
@@ -312,7 +518,7 @@ std::unique_ptr<ASTNode> Parser::factor() {
     }
     if (match(TOK_STRING)) {
         Token t = advance();
-        return std::unique_ptr<StringNode>(new StringNode(t.value, t.line));
+        return std::unique_ptr<StringNode>(new StringNode(t.symbol, t.line));
     }
     if (match(TOK_TRUE) || match(TOK_FALSE)) {
         Token t = advance();
@@ -324,13 +530,47 @@ std::unique_ptr<ASTNode> Parser::factor() {
         expect(TOK_RPAREN, "Expected ')' after expression");
         return expr;
     }
+    if (match(TOK_LBRACKET)) {
+        int line = advance().line;
+        auto array = std::unique_ptr<ArrayLiteralNode>(new ArrayLiteralNode(line));
+        while (!match(TOK_RBRACKET)) {
+            array->elements.push_back(expression());
+            if (!match(TOK_COMMA)) break;
+            advance();
+        }
+        expect(TOK_RBRACKET, "Expected ']' after array elements");
+        return array;
+    }
+    if (match(TOK_LBRACE)) {
+        int line = advance().line;
+        auto dict = std::unique_ptr<DictLiteralNode>(new DictLiteralNode(line));
+        while (!match(TOK_RBRACE)) {
+            dict->keys.push_back(expression());
+            expect(TOK_COLON, "Expected ':' after dictionary key");
+            dict->values.push_back(expression());
+            if (!match(TOK_COMMA)) break;
+            advance();
+        }
+        expect(TOK_RBRACE, "Expected '}' after dictionary entries");
+        return dict;
+    }
     if (match(TOK_IDENTIFIER)) {
         Token id = advance();
+        if (match(TOK_LBRACKET)) {
+            advance();
+            auto node = std::unique_ptr<IndexNode>(new IndexNode(id.symbol, id.line));
+            node->index = expression();
+            expect(TOK_RBRACKET, "Expected ']' after index");
+            return node;
+        }
         if (match(TOK_DOT)) {
             advance();
-            Token method = expect(TOK_IDENTIFIER, "Expected method name after '.'");
+            Token method = expect(TOK_IDENTIFIER, "Expected field or method name after '.'");
+            if (!match(TOK_LPAREN)) {
+                return std::unique_ptr<FieldAccessNode>(new FieldAccessNode(id.symbol, method.symbol, id.line));
+            }
             expect(TOK_LPAREN, "Expected '(' after method name");
-            auto call = std::unique_ptr<CallNode>(new CallNode(id.value + "." + method.value, id.line));
+            auto call = std::unique_ptr<CallNode>(new CallNode(id.symbol, method.symbol, id.line));
             if (!match(TOK_RPAREN)) {
                 do {
                     call->arguments.push_back(expression());
@@ -341,7 +581,7 @@ std::unique_ptr<ASTNode> Parser::factor() {
             return call;
         } else if (match(TOK_LPAREN)) {
             advance();
-            auto call = std::unique_ptr<CallNode>(new CallNode(id.value, id.line));
+            auto call = std::unique_ptr<CallNode>(new CallNode(NO_SYMBOL, id.symbol, id.line));
             if (!match(TOK_RPAREN)) {
                 do {
                     call->arguments.push_back(expression());
@@ -351,7 +591,7 @@ std::unique_ptr<ASTNode> Parser::factor() {
             expect(TOK_RPAREN, "Expected ')' after arguments");
             return call;
         }
-        return std::unique_ptr<IdentifierNode>(new IdentifierNode(id.value, id.line));
+        return std::unique_ptr<IdentifierNode>(new IdentifierNode(id.symbol, id.line));
     }
     if (match(TOK_SCANNING_USER_INPUT)) {
         int line = expect(TOK_SCANNING_USER_INPUT, "Expected 'scanning_user_input'").line;
@@ -366,5 +606,6 @@ std::unique_ptr<ASTNode> Parser::factor() {
         return std::unique_ptr<InputNode>(new InputNode(type.value, line));
     }
     
+    if (match(TOK_ERROR)) throw std::runtime_error(peek().value);
     throw std::runtime_error("Unexpected token '" + peek().value + "' at line " + std::to_string(peek().line));
 }
\ No newline at end of file
@@ -0,0 +1,124 @@
+#include "profiler.h"
+#include <algorithm>
+#include <cstdio>
+#include <sstream>
+
+Profiler::Profiler() {
+    FunctionStats root;
+    root.name = "<main>";
+    root.calls = 1;
+    functions.push_back(root);
+    TreeNode node;
+    node.function = 0;
+    tree.push_back(node);
+    stack.push_back(Frame{0, 0, Clock::now(), 0, false});
+}
+
+void Profiler::enter(const void* callee, Symbol owner, Symbol name) {
+    auto it = function_index.find(callee);
+    size_t index;
+    if (it == function_index.end()) {
+        index = functions.size();
+        function_index[callee] = index;
+        FunctionStats stats;
+        stats.name = owner == NO_SYMBOL ? symbol_name(name) : symbol_name(owner) + "." + symbol_name(name);
+        functions.push_back(stats);
+    } else {
+        index = it->second;
+    }
+    functions[index].calls++;
+
+    TreeNode& parent = tree[stack.back().tree_node];
+    auto child = parent.children.find(index);
+    size_t node;
+    if (child == parent.children.end()) {
+        node = tree.size();
+        tree[stack.back().tree_node].children[index] = node;
+        TreeNode fresh;
+        fresh.function = index;
+        tree.push_back(fresh);
+    } else {
+        node = child->second;
+    }
+
+    bool recursive = false;
+    for (auto& frame : stack) {
+        if (frame.function == index) recursive = true;
+    }
+    stack.push_back(Frame{index, node, Clock::now(), 0, recursive});
+}
+
+void Profiler::leave() {
+    if (stack.size() <= 1) return;
+    Frame frame = stack.back();
+    stack.pop_back();
+    uint64_t inclusive = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - frame.start).count();
+    uint64_t exclusive = inclusive > frame.child_ns ? inclusive - frame.child_ns : 0;
+    FunctionStats& stats = functions[frame.function];
+    if (!frame.recursive) stats.inclusive_ns += inclusive;
+    stats.exclusive_ns += exclusive;
+    tree[frame.tree_node].self_ns += exclusive;
+    stack.back().child_ns += inclusive;
+}
+
+void Profiler::finish() {
+    while (stack.size() > 1) leave();
+    Frame& root = stack.back();
+    uint64_t inclusive = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - root.start).count();
+    uint64_t exclusive = inclusive > root.child_ns ? inclusive - root.child_ns : 0;
+    functions[0].inclusive_ns = inclusive;
+    functions[0].exclusive_ns = exclusive;
+    tree[0].self_ns = exclusive;
+}
+
+void Profiler::write_tree(std::ostream& out, size_t node, std::string& path) const {
+    size_t length = path.size();
+    if (!path.empty()) path += ';';
+    path += functions[tree[node].function].name;
+    uint64_t us = tree[node].self_ns / 1000;
+    if (us > 0) out << path << ' ' << us << '\n';
+    for (auto& child : tree[node].children) write_tree(out, child.second, path);
+    path.resize(length);
+}
+
+void Profiler::write_collapsed(std::ostream& out) const {
+    std::string path;
+    write_tree(out, 0, path);
+}
+
+void Profiler::write_report(std::ostream& out, const std::string& source, size_t max_lines) const {
+    std::vector<const FunctionStats*> sorted;
+    for (auto& f : functions) sorted.push_back(&f);
+    std::sort(sorted.begin(), sorted.end(), [](const FunctionStats* a, const FunctionStats* b) {
+        return a->exclusive_ns > b->exclusive_ns;
+    });
+
+    char line[256];
+    out << "Functions (by exclusive time):\n";
+    std::snprintf(line, sizeof(line), "  %10s %12s %12s  %s\n", "calls", "incl ms", "excl ms", "name");
+    out << line;
+    for (auto* f : sorted) {
+        std::snprintf(line, sizeof(line), "  %10llu %12.3f %12.3f  %s\n", static_cast<unsigned long long>(f->calls),
+                      f->inclusive_ns / 1e6, f->exclusive_ns / 1e6, f->name.c_str());
+        out << line;
+    }
+
+    std::vector<std::string> text;
+    std::istringstream lines(source);
+    for (std::string l; std::getline(lines, l);) text.push_back(l);
+
+    std::vector<int> hot;
+    for (size_t i = 0; i < line_counts.size(); ++i) {
+        if (line_counts[i]) hot.push_back(static_cast<int>(i));
+    }
+    std::stable_sort(hot.begin(), hot.end(), [this](int a, int b) { return line_counts[a] > line_counts[b]; });
+    if (hot.size() > max_lines) hot.resize(max_lines);
+
+    out << "Lines (by execution count):\n";
+    for (int l : hot) {
+        std::string code = l >= 1 && l <= static_cast<int>(text.size()) ? text[l - 1] : "";
+        code.erase(0, code.find_first_not_of(" \t"));
+        std::snprintf(line, sizeof(line), "  %6d %12llu  ", l, static_cast<unsigned long long>(line_counts[l]));
+        out << line << code << '\n';
+    }
+}
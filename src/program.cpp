@@ -0,0 +1,38 @@
+#include "program.h"
+#include "lexer.h"
+#include "parser.h"
+#include "inliner.h"
+#include "interpreter.h"
+#include "resolver.h"
+#include "semantic.h"
+#include <fstream>
+#include <stdexcept>
+
+void Program::run(ExecutionContext& context) const {
+    InterpreterVisitor interpreter(context);
+    HeapQuota::Scope quota(context.heap_budget());
+    context.start_limits();
+    for (auto& module : imports) interpreter.run_module(*module->ast);
+    ast->accept(interpreter);
+}
+
+std::shared_ptr<const Program> parse_program(const std::string& name, const std::string& source, bool inline_small) {
+    Lexer lexer(source, true);
+    Parser parser(lexer.tokenize());
+    std::shared_ptr<Program> program(new Program());
+    program->name = name;
+    program->ast = parser.parse();
+    if (inline_small) inline_calls(static_cast<ProgramNode&>(*program->ast));
+    resolve_slots(*program->ast);
+    std::string path = module_path(".", name);
+    program->imports = ModuleLoader::shared().load_imports(static_cast<ProgramNode&>(*program->ast), directory_of(path), path);
+    check_types(static_cast<ProgramNode&>(*program->ast), program->imports.empty());
+    return program;
+}
+
+std::shared_ptr<const Program> load_program(const std::string& path, bool inline_small) {
+    std::ifstream file(path);
+    if (!file.is_open()) throw std::runtime_error("Error opening file: " + path);
+    std::string source((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    return parse_program(path, source, inline_small);
+}
@@ -0,0 +1,151 @@
+#include "repl.h"
+#include "lexer.h"
+#include "parser.h"
+#include "resolver.h"
+#include "semantic.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+double ms_since(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+bool interactive() {
+#ifndef _WIN32
+    return isatty(0) != 0;
+#else
+    return false;
+#endif
+}
+
+} // namespace
+
+ReplSession::ReplSession(ExecutionContext& context) : ctx(context), interpreter(context) {}
+
+bool ReplSession::incomplete(const std::string& text) {
+    int depth = 0;
+    for (const Token& token : Lexer(text, true).tokenize()) {
+        if (token.type == TOK_LBRACE || token.type == TOK_LBRACKET || token.type == TOK_LPAREN) ++depth;
+        else if (token.type == TOK_RBRACE || token.type == TOK_RBRACKET || token.type == TOK_RPAREN) --depth;
+    }
+    return depth > 0;
+}
+
+void ReplSession::submit(const std::string& text, std::vector<StatementTime>* times) {
+    compile_ms = -1;
+    Clock::time_point start = Clock::now();
+    Lexer lexer(text, true);
+    lexer.seek(0, next_line);
+    Parser parser(lexer.tokenize());
+    next_line += static_cast<int>(std::count(text.begin(), text.end(), '\n'));
+    std::unique_ptr<ASTNode> ast = parser.parse();
+    std::unique_ptr<ProgramNode> program(static_cast<ProgramNode*>(ast.release()));
+    auto modules = ModuleLoader::shared().load_imports(*program, ".");
+    compile_ms = ms_since(start);
+    for (auto& module : modules) {
+        auto& ran = imported[module->path];
+        if (ran == module) continue;
+        run_import(*module);
+        ran = module;
+    }
+
+    start = Clock::now();
+    resolve_slots(*program, *globals);
+    check_types(*program, false);
+    globals = &program->layout;
+    inputs.push_back(std::move(program));
+    compile_ms += ms_since(start);
+
+    interpreter.enter_globals(*globals);
+    for (auto& stmt : inputs.back()->statements) {
+        start = Clock::now();
+        interpreter.run_global(*stmt);
+        if (times) times->push_back(StatementTime{stmt->line, ms_since(start)});
+        if (ctx.returning) break; // A top-level yield ends the input, as it ends a script
+    }
+}
+
+// Runs the module in a frame above the globals, then moves its top-level
+// variables into the globals. The module's own AST stays resolved on its
+// own, as the loader shares it.
+void ReplSession::run_import(const Module& module) {
+    interpreter.enter_globals(*globals);
+    interpreter.run_module(*module.ast);
+    const Frame& frame = ctx.frames.back();
+    const std::vector<Symbol>& names = module.ast->layout.slots;
+    std::vector<Value> values;
+    for (size_t i = 0; i < names.size(); ++i) values.push_back(std::move(ctx.stack[frame.base + i]));
+
+    module_layouts.push_back(*globals);
+    FrameLayout& grown = module_layouts.back();
+    for (Symbol name : names) grown.add(name);
+    globals = &grown;
+    interpreter.enter_globals(grown);
+    for (size_t i = 0; i < names.size(); ++i) {
+        if (values[i].type != Value::Type::Unset) ctx.stack[grown.find(names[i])] = std::move(values[i]);
+    }
+}
+
+int run_repl(const ReplOptions& options, std::istream& in) {
+    ExecutionContext context;
+    context.parallel_workers = options.workers;
+    context.parallel_grain = options.grain;
+    ReplSession session(context);
+    bool timing = options.timing;
+    bool prompt = interactive();
+    int status = 0;
+
+    std::string text, line;
+    for (;;) {
+        if (prompt) std::cout << (text.empty() ? "> " : "... ") << std::flush;
+        if (!std::getline(in, line)) break;
+        if (text.empty()) {
+            if (line == ":quit") break;
+            if (line == ":time") {
+                timing = !timing;
+                std::cerr << "timing " << (timing ? "on" : "off") << std::endl;
+                continue;
+            }
+        }
+        text += line;
+        text += '\n';
+        if (ReplSession::incomplete(text)) continue;
+
+        std::vector<ReplSession::StatementTime> times;
+        try {
+            session.submit(text, timing ? &times : nullptr);
+        } catch (const std::exception& e) {
+            std::cout.flush();
+            std::cerr << e.what() << std::endl;
+            status = 1;
+        }
+        std::cout.flush();
+        if (timing && session.last_compile_ms() >= 0) {
+            char buffer[96];
+            std::snprintf(buffer, sizeof buffer, "  compile %.3f ms", session.last_compile_ms());
+            std::cerr << buffer << std::endl;
+            for (auto& module : session.last_imports()) {
+                std::snprintf(buffer, sizeof buffer, "  import %.3f ms%s ", module.compile_ms, module.reused ? " (reused)" : "");
+                std::cerr << buffer << module.path << std::endl;
+            }
+            for (auto& t : times) {
+                std::snprintf(buffer, sizeof buffer, "  line %d: %.3f ms", t.line, t.ms);
+                std::cerr << buffer << std::endl;
+            }
+        }
+        text.clear();
+    }
+    if (!text.empty()) {
+        std::cerr << "Unexpected end of input inside an open block" << std::endl;
+        return 1;
+    }
+    return status;
+}
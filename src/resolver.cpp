@@ -0,0 +1,253 @@
+#include "resolver.h"
+
+namespace {
+
+// Adds every name written by `statements` to `layout`. Blocks, function
+// bodies and parallel_repeat bodies get frames of their own; while bodies
+// run in the enclosing frame, so their writes belong here. Inside a method,
+// assigning to one of the receiver's fields writes the field, not a local.
+void collect_writes(const std::vector<std::unique_ptr<ASTNode>>& statements, FrameLayout& layout,
+                    const FrameLayout* fields) {
+    for (auto& stmt : statements) {
+        if (auto* decl = dynamic_cast<VarDeclNode*>(stmt.get())) {
+            layout.add(decl->name);
+        } else if (auto* let = dynamic_cast<LetConstDeclNode*>(stmt.get())) {
+            layout.add(let->name);
+        } else if (auto* assign = dynamic_cast<AssignmentNode*>(stmt.get())) {
+            if (!fields || fields->find(assign->name) < 0) layout.add(assign->name);
+        } else if (auto* instance = dynamic_cast<InstanceNode*>(stmt.get())) {
+            layout.add(instance->instance_name);
+        } else if (auto* loop = dynamic_cast<WhileNode*>(stmt.get())) {
+            collect_writes(loop->body->statements, layout, fields);
+        }
+    }
+}
+
+// Offset of every field name across all blueprints in the tree, or -1 for
+// names that sit at different offsets in different blueprints.
+void collect_fields(const std::vector<std::unique_ptr<ASTNode>>& statements, std::unordered_map<Symbol, int>& offsets);
+
+void collect_fields(ASTNode& node, std::unordered_map<Symbol, int>& offsets) {
+    if (auto* blueprint = dynamic_cast<BlueprintNode*>(&node)) {
+        for (size_t i = 0; i < blueprint->field_layout.slots.size(); ++i) {
+            auto inserted = offsets.insert(std::make_pair(blueprint->field_layout.slots[i], static_cast<int>(i)));
+            if (!inserted.second && inserted.first->second != static_cast<int>(i)) inserted.first->second = -1;
+        }
+        collect_fields(blueprint->body, offsets);
+    } else if (auto* program = dynamic_cast<ProgramNode*>(&node)) {
+        collect_fields(program->statements, offsets);
+    } else if (auto* function = dynamic_cast<FunctionNode*>(&node)) {
+        collect_fields(function->body, offsets);
+    } else if (auto* branch = dynamic_cast<IfNode*>(&node)) {
+        collect_fields(*branch->then_block, offsets);
+        for (auto& else_if : branch->else_if_blocks) collect_fields(*else_if.second, offsets);
+        if (branch->else_block) collect_fields(*branch->else_block, offsets);
+    } else if (auto* choose = dynamic_cast<ChooseNode*>(&node)) {
+        for (auto& body : choose->cases) collect_fields(*body, offsets);
+        if (choose->otherwise) collect_fields(*choose->otherwise, offsets);
+    } else if (auto* loop = dynamic_cast<WhileNode*>(&node)) {
+        collect_fields(*loop->body, offsets);
+    } else if (auto* parallel = dynamic_cast<ParallelForNode*>(&node)) {
+        collect_fields(*parallel->body, offsets);
+    }
+}
+
+void collect_fields(const std::vector<std::unique_ptr<ASTNode>>& statements, std::unordered_map<Symbol, int>& offsets) {
+    for (auto& stmt : statements) collect_fields(*stmt, offsets);
+}
+
+class SlotResolver : public ASTVisitor {
+public:
+    SlotResolver(ASTNode& root, const FrameLayout* globals, const FrameLayout* fields = nullptr)
+        : blueprint_fields(fields), globals(globals) {
+        collect_fields(root, field_offsets);
+    }
+
+    void visit(ProgramNode& node) override {
+        node.layout = globals ? *globals : FrameLayout();
+        globals = nullptr; // Only the outermost frame continues an earlier one
+        collect_writes(node.statements, node.layout, self_fields);
+        enter(node.layout);
+        for (auto& stmt : node.statements) stmt->accept(*this);
+        leave();
+    }
+    void visit(BlueprintNode& node) override {
+        FrameLayout initializers; // Field initializers run in an empty frame of their own
+        enter(initializers);
+        for (auto& field : node.fields) field->initializer->accept(*this);
+        leave();
+        const FrameLayout* saved = blueprint_fields;
+        blueprint_fields = &node.field_layout;
+        for (auto& stmt : node.body) stmt->accept(*this);
+        blueprint_fields = saved;
+    }
+    void visit(VarDeclNode& node) override {
+        node.initializer->accept(*this);
+        node.slot = frame->find(node.name);
+    }
+    void visit(LetConstDeclNode& node) override {
+        node.initializer->accept(*this);
+        node.slot = frame->find(node.name);
+    }
+    // Methods (functions directly inside a blueprint) see the receiver's
+    // fields by bare name; frames inside them start a fresh chain.
+    void visit(FunctionNode& node) override {
+        const FrameLayout* saved_fields = self_fields;
+        FrameLayout* saved_frame = frame;
+        std::vector<FrameLayout*> saved_chain;
+        saved_chain.swap(method_frames);
+        self_fields = blueprint_fields;
+        blueprint_fields = nullptr;
+        node.layout = FrameLayout();
+        for (Symbol param : node.parameters) node.layout.add(param);
+        collect_writes(node.body, node.layout, self_fields);
+        enter(node.layout);
+        for (auto& stmt : node.body) stmt->accept(*this);
+        leave();
+        blueprint_fields = self_fields;
+        self_fields = saved_fields;
+        method_frames.swap(saved_chain);
+        frame = saved_frame;
+    }
+    void visit(IfNode& node) override {
+        node.condition->accept(*this);
+        node.then_block->accept(*this);
+        for (auto& else_if : node.else_if_blocks) {
+            else_if.first->accept(*this);
+            else_if.second->accept(*this);
+        }
+        if (node.else_block) node.else_block->accept(*this);
+    }
+    void visit(ChooseNode& node) override {
+        node.subject->accept(*this);
+        for (auto& body : node.cases) body->accept(*this);
+        if (node.otherwise) node.otherwise->accept(*this);
+    }
+    void visit(WhileNode& node) override {
+        node.condition->accept(*this);
+        for (auto& stmt : node.body->statements) stmt->accept(*this);
+    }
+    void visit(ParallelForNode& node) override {
+        node.start->accept(*this);
+        node.end->accept(*this);
+        if (node.accumulator != NO_SYMBOL) node.accumulator_slot = frame->find(node.accumulator);
+        node.layout = FrameLayout();
+        node.layout.add(node.counter);
+        collect_writes(node.body->statements, node.layout, self_fields);
+        enter(node.layout);
+        for (auto& stmt : node.body->statements) stmt->accept(*this);
+        leave();
+    }
+    void visit(AccumulateNode& node) override { node.expression->accept(*this); }
+    void visit(PrintNode& node) override { node.expression->accept(*this); }
+    void visit(InputNode&) override {}
+    void visit(BinaryOpNode& node) override {
+        node.left->accept(*this);
+        node.right->accept(*this);
+    }
+    void visit(IdentifierNode& node) override {
+        node.slot = frame->find(node.name);
+        node.field = self_field(node.name);
+    }
+    void visit(NumberNode&) override {}
+    void visit(StringNode&) override {}
+    void visit(BooleanNode&) override {}
+    void visit(AssignmentNode& node) override {
+        node.value->accept(*this);
+        node.slot = frame->find(node.name);
+        node.field = self_field(node.name);
+    }
+    void visit(CallNode& node) override {
+        for (auto& arg : node.arguments) arg->accept(*this);
+        if (node.receiver != NO_SYMBOL) node.receiver_slot = frame->find(node.receiver);
+    }
+    void visit(YieldNode& node) override { node.expression->accept(*this); }
+    void visit(InstanceNode& node) override { node.slot = frame->find(node.instance_name); }
+    void visit(ImportNode&) override {}
+    // The renamed parameters are locals of the frame the call runs in.
+    void visit(InlinedCallNode& node) override {
+        if (node.receiver != NO_SYMBOL) node.receiver_slot = frame->find(node.receiver);
+        for (auto& binding : node.bindings) {
+            frame->add(binding->name);
+            binding->accept(*this);
+        }
+        node.result->accept(*this);
+    }
+    void visit(FieldAccessNode& node) override {
+        node.receiver_slot = frame->find(node.receiver);
+        node.offset = field_offset(node.field);
+    }
+    void visit(FieldAssignmentNode& node) override {
+        node.value->accept(*this);
+        node.receiver_slot = frame->find(node.receiver);
+        node.offset = field_offset(node.field);
+    }
+    void visit(ArrayLiteralNode& node) override {
+        for (auto& element : node.elements) element->accept(*this);
+    }
+    void visit(DictLiteralNode& node) override {
+        for (size_t i = 0; i < node.keys.size(); ++i) {
+            node.keys[i]->accept(*this);
+            node.values[i]->accept(*this);
+        }
+    }
+    void visit(IndexNode& node) override {
+        node.index->accept(*this);
+        node.slot = frame->find(node.name);
+    }
+    void visit(IndexAssignmentNode& node) override {
+        node.index->accept(*this);
+        node.value->accept(*this);
+        node.slot = frame->find(node.name);
+    }
+
+private:
+    FrameLayout* frame = nullptr;
+    std::vector<FrameLayout*> method_frames;      // Frames entered since the innermost function began
+    const FrameLayout* self_fields = nullptr;     // Receiver fields of the current method
+    const FrameLayout* blueprint_fields = nullptr; // Set while visiting a blueprint's own methods
+    std::unordered_map<Symbol, int> field_offsets;
+    const FrameLayout* globals;                   // Slots the outermost frame starts with
+
+    void enter(FrameLayout& layout) {
+        frame = &layout;
+        method_frames.push_back(&layout);
+    }
+    void leave() {
+        method_frames.pop_back();
+        frame = method_frames.empty() ? nullptr : method_frames.back();
+    }
+
+    // A bare name inside a method means the receiver's field unless a
+    // parameter or local of the method shadows it.
+    int self_field(Symbol name) const {
+        if (!self_fields) return -1;
+        for (FrameLayout* layout : method_frames) {
+            if (layout->find(name) >= 0) return -1;
+        }
+        return self_fields->find(name);
+    }
+    int field_offset(Symbol field) const {
+        auto it = field_offsets.find(field);
+        return it == field_offsets.end() ? -1 : it->second;
+    }
+};
+
+} // namespace
+
+void resolve_slots(ASTNode& root) {
+    SlotResolver resolver(root, nullptr);
+    root.accept(resolver);
+}
+
+void resolve_slots(ProgramNode& program, const FrameLayout& globals) {
+    SlotResolver resolver(program, &globals);
+    program.accept(resolver);
+}
+
+// Field offsets come from this body alone; they are only a guess the
+// interpreter checks, so a miss costs a lookup by name.
+void resolve_slots(FunctionNode& function, const FrameLayout* fields) {
+    SlotResolver resolver(function, nullptr, fields);
+    function.accept(resolver);
+}
@@ -0,0 +1,379 @@
+#include "semantic.h"
+#include "builtins.h"
+#include <stdexcept>
+#include <unordered_map>
+
+namespace {
+
+StaticType join(StaticType a, StaticType b) {
+    if (a == b || b == StaticType::Bottom) return a;
+    if (a == StaticType::Bottom) return b;
+    if ((a == StaticType::Int && b == StaticType::Bool) || (a == StaticType::Bool && b == StaticType::Int)) return StaticType::Int;
+    return StaticType::Unknown;
+}
+
+bool int_like(StaticType type) { return type == StaticType::Int || type == StaticType::Bool; }
+
+// Types that as_int() can never convert.
+bool never_int(StaticType type) {
+    return type == StaticType::Instance || type == StaticType::Array || type == StaticType::Dict;
+}
+
+// A function that a plain call can reach by name: defined once, outside
+// any function or blueprint, so it is always registered under that name.
+struct FunctionInfo {
+    std::vector<StaticType> parameters; // Joined over every call site
+    StaticType result = StaticType::Bottom; // Joined over every yield
+    bool always_yields;                 // Its body ends in a yield, so no call returns nothing
+    bool callable;                      // Defined exactly once, at the top level or in its blocks
+};
+
+// One frame under analysis. `types` holds each slot's type joined over
+// every write in every pass; `assigned` marks the slots written on every
+// path to the current statement.
+struct Scope {
+    const FrameLayout* layout;
+    std::vector<StaticType>* types;
+    std::vector<bool> assigned;
+    bool block; // An if block: names it never writes are read from the enclosing scope
+};
+
+// Counts definitions per name and records where each was found.
+void collect_functions(std::vector<std::unique_ptr<ASTNode>>& statements, bool top,
+                       std::unordered_map<FunctionNode*, bool>& tops, std::unordered_map<Symbol, int>& counts);
+
+void collect_functions(ASTNode& node, bool top, std::unordered_map<FunctionNode*, bool>& tops,
+                       std::unordered_map<Symbol, int>& counts) {
+    if (auto* function = dynamic_cast<FunctionNode*>(&node)) {
+        ++counts[function->name];
+        tops[function] = top;
+        collect_functions(function->body, false, tops, counts);
+    } else if (auto* blueprint = dynamic_cast<BlueprintNode*>(&node)) {
+        collect_functions(blueprint->body, false, tops, counts);
+    } else if (auto* program = dynamic_cast<ProgramNode*>(&node)) {
+        collect_functions(program->statements, top, tops, counts);
+    } else if (auto* branch = dynamic_cast<IfNode*>(&node)) {
+        collect_functions(*branch->then_block, top, tops, counts);
+        for (auto& else_if : branch->else_if_blocks) collect_functions(*else_if.second, top, tops, counts);
+        if (branch->else_block) collect_functions(*branch->else_block, top, tops, counts);
+    } else if (auto* choose = dynamic_cast<ChooseNode*>(&node)) {
+        for (auto& body : choose->cases) collect_functions(*body, top, tops, counts);
+        if (choose->otherwise) collect_functions(*choose->otherwise, top, tops, counts);
+    } else if (auto* loop = dynamic_cast<WhileNode*>(&node)) {
+        collect_functions(*loop->body, top, tops, counts);
+    } else if (auto* parallel = dynamic_cast<ParallelForNode*>(&node)) {
+        collect_functions(*parallel->body, false, tops, counts);
+    }
+}
+
+void collect_functions(std::vector<std::unique_ptr<ASTNode>>& statements, bool top,
+                       std::unordered_map<FunctionNode*, bool>& tops, std::unordered_map<Symbol, int>& counts) {
+    for (auto& stmt : statements) collect_functions(*stmt, top, tops, counts);
+}
+
+class TypeInference : public ASTVisitor {
+public:
+    TypeInference(ASTNode& root, bool whole_program) {
+        if (!whole_program) return;
+        std::unordered_map<FunctionNode*, bool> tops;
+        std::unordered_map<Symbol, int> counts;
+        collect_functions(root, true, tops, counts);
+        for (auto& entry : tops) {
+            FunctionNode* function = entry.first;
+            if (!entry.second || counts[function->name] != 1 || find_builtin(function->name)) continue;
+            FunctionInfo& info = functions[function->name];
+            info.parameters.assign(function->parameters.size(), StaticType::Bottom);
+            info.always_yields = !function->body.empty() && dynamic_cast<YieldNode*>(function->body.back().get());
+            info.callable = true;
+        }
+    }
+
+    // One pass over the tree; true if any slot, parameter or result type
+    // grew. Annotations and errors reflect the last pass.
+    bool pass(ASTNode& root) {
+        changed = false;
+        errors.clear();
+        root.accept(*this);
+        return changed;
+    }
+
+    std::vector<std::string> errors;
+
+    void visit(ProgramNode& node) override {
+        bool block = !scopes.empty();
+        enter(node.layout, block);
+        statements(node.statements);
+        scopes.pop_back();
+    }
+    void visit(BlueprintNode& node) override {
+        FrameLayout initializers; // Field initializers run in an empty frame of their own
+        enter(initializers, false);
+        for (auto& field : node.fields) {
+            StaticType type = expression(*field->initializer);
+            check_integer(*field, type, "field");
+        }
+        scopes.pop_back();
+        ++blueprint_depth;
+        statements(node.body);
+        --blueprint_depth;
+    }
+    void visit(VarDeclNode& node) override {
+        StaticType type = expression(*node.initializer);
+        check_integer(node, type, "variable");
+        // The runtime check leaves only ints in an integer variable.
+        write(node.slot, node.type == "integer" ? StaticType::Int : type);
+    }
+    void visit(LetConstDeclNode& node) override { write(node.slot, expression(*node.initializer)); }
+    void visit(FunctionNode& node) override {
+        FunctionInfo* saved = function;
+        bool saved_parallel = in_parallel;
+        auto it = blueprint_depth == 0 ? functions.find(node.name) : functions.end();
+        function = it != functions.end() && it->second.callable ? &it->second : nullptr;
+        in_parallel = false;
+        enter(node.layout, false);
+        for (size_t i = 0; i < node.parameters.size(); ++i) {
+            write(static_cast<int>(i), function ? function->parameters[i] : StaticType::Unknown);
+        }
+        statements(node.body);
+        scopes.pop_back();
+        function = saved;
+        in_parallel = saved_parallel;
+    }
+    void visit(IfNode& node) override {
+        expression(*node.condition);
+        node.then_block->accept(*this);
+        for (auto& else_if : node.else_if_blocks) {
+            expression(*else_if.first);
+            else_if.second->accept(*this);
+        }
+        if (node.else_block) node.else_block->accept(*this);
+    }
+    void visit(ChooseNode& node) override {
+        expression(*node.subject);
+        for (auto& body : node.cases) body->accept(*this);
+        if (node.otherwise) node.otherwise->accept(*this);
+    }
+    // The body may run no times, so its writes are not definite afterwards.
+    void visit(WhileNode& node) override {
+        expression(*node.condition);
+        std::vector<bool> before = scopes.back().assigned;
+        statements(node.body->statements);
+        scopes.back().assigned.swap(before);
+    }
+    void visit(ParallelForNode& node) override {
+        expression(*node.start);
+        expression(*node.end);
+        if (node.accumulator_slot >= 0) write_type(node.accumulator_slot, StaticType::Unknown);
+        bool saved = in_parallel;
+        in_parallel = true;
+        enter(node.layout, false);
+        write(0, StaticType::Int);
+        statements(node.body->statements);
+        scopes.pop_back();
+        in_parallel = saved;
+    }
+    void visit(AccumulateNode& node) override { expression(*node.expression); }
+    void visit(PrintNode& node) override { expression(*node.expression); }
+    void visit(InputNode& node) override { type = node.type == "integer" ? StaticType::Int : StaticType::String; }
+    void visit(BinaryOpNode& node) override {
+        StaticType left = expression(*node.left);
+        StaticType right = expression(*node.right);
+        typedef BinaryOpNode::Kind Kind;
+        const std::string& op = node.op;
+        bool ints = int_like(left) && int_like(right);
+        node.kind = Kind::Generic;
+        if (op == "+") {
+            if (ints) {
+                node.kind = Kind::IntAdd;
+                type = StaticType::Int;
+            } else if (left == StaticType::String || right == StaticType::String) {
+                node.kind = Kind::Concat;
+                type = StaticType::String;
+            } else {
+                if (never_int(left) || never_int(right)) error(node, "Cannot add " + pair(left, right));
+                type = left == StaticType::Unknown || right == StaticType::Unknown ? StaticType::Unknown : StaticType::Int;
+            }
+            return;
+        }
+        if (op == "==") {
+            if (ints) node.kind = Kind::IntEqual;
+            else if (left == StaticType::String && right == StaticType::String) node.kind = Kind::StringEqual;
+            type = StaticType::Bool;
+            return;
+        }
+        if (op == "-" || op == "*" || op == "/") {
+            if (ints) node.kind = op == "-" ? Kind::IntSub : op == "*" ? Kind::IntMul : Kind::IntDiv;
+            type = StaticType::Int;
+        } else if (op == "<=" || op == "!<" || op == ">") {
+            if (ints) node.kind = op == "<=" ? Kind::IntLessEqual : op == "!<" ? Kind::IntNotLess : Kind::IntGreater;
+            type = StaticType::Bool;
+        } else {
+            type = StaticType::Unknown; // Not an operator the interpreter knows; it reports it
+            return;
+        }
+        if (never_int(left) || never_int(right)) error(node, "Operator " + op + " needs integers, got " + pair(left, right));
+    }
+    void visit(IdentifierNode& node) override {
+        node.assigned = false;
+        type = StaticType::Unknown;
+        if (node.field >= 0) return; // A receiver field
+        if (node.slot >= 0 && scopes.back().assigned[node.slot]) {
+            node.assigned = true;
+            type = (*scopes.back().types)[node.slot];
+            return;
+        }
+        // lookup() goes on through enclosing frames, which for an if block
+        // are the scopes around it.
+        if (node.slot >= 0) return;
+        for (size_t i = scopes.size() - 1; scopes[i].block; --i) {
+            const Scope& outer = scopes[i - 1];
+            int slot = outer.layout->find(node.name);
+            if (slot >= 0) {
+                if (outer.assigned[slot]) type = (*outer.types)[slot];
+                return;
+            }
+        }
+    }
+    void visit(NumberNode&) override { type = StaticType::Int; }
+    void visit(StringNode&) override { type = StaticType::String; }
+    void visit(BooleanNode&) override { type = StaticType::Bool; }
+    void visit(AssignmentNode& node) override {
+        StaticType value = expression(*node.value);
+        if (node.field < 0) write(node.slot, value);
+    }
+    void visit(CallNode& node) override {
+        std::vector<StaticType> arguments;
+        for (auto& arg : node.arguments) arguments.push_back(expression(*arg));
+        type = StaticType::Unknown;
+        if (node.receiver != NO_SYMBOL) return;
+        auto it = functions.find(node.name);
+        if (it == functions.end()) return;
+        FunctionInfo& info = it->second;
+        if (arguments.size() != info.parameters.size()) return; // Fails at run time
+        for (size_t i = 0; i < arguments.size(); ++i) grow(info.parameters[i], arguments[i]);
+        if (info.always_yields) type = info.result;
+    }
+    void visit(YieldNode& node) override {
+        StaticType value = expression(*node.expression);
+        if (function) grow(function->result, in_parallel ? StaticType::Unknown : value);
+    }
+    void visit(InstanceNode& node) override { write(node.slot, StaticType::Instance); }
+    void visit(ImportNode&) override {}
+    void visit(InlinedCallNode& node) override {
+        for (auto& binding : node.bindings) binding->accept(*this);
+        type = expression(*node.result);
+    }
+    void visit(FieldAccessNode&) override { type = StaticType::Unknown; }
+    void visit(FieldAssignmentNode& node) override { expression(*node.value); }
+    void visit(ArrayLiteralNode& node) override {
+        for (auto& element : node.elements) expression(*element);
+        type = StaticType::Array;
+    }
+    void visit(DictLiteralNode& node) override {
+        for (size_t i = 0; i < node.keys.size(); ++i) {
+            expression(*node.keys[i]);
+            expression(*node.values[i]);
+        }
+        type = StaticType::Dict;
+    }
+    void visit(IndexNode& node) override {
+        expression(*node.index);
+        type = StaticType::Unknown;
+    }
+    void visit(IndexAssignmentNode& node) override {
+        expression(*node.index);
+        expression(*node.value);
+    }
+
+private:
+    std::unordered_map<Symbol, FunctionInfo> functions;
+    std::unordered_map<const FrameLayout*, std::vector<StaticType>> slot_types;
+    std::vector<Scope> scopes;
+    FunctionInfo* function = nullptr; // The callable function being analyzed, if any
+    bool in_parallel = false;         // Inside a parallel_repeat body of that function
+    int blueprint_depth = 0;
+    StaticType type = StaticType::Unknown; // Of the last expression visited
+    bool changed = false;
+
+    void enter(const FrameLayout& layout, bool block) {
+        std::vector<StaticType>& types = slot_types[&layout];
+        types.resize(layout.slots.size(), StaticType::Bottom);
+        scopes.push_back(Scope{&layout, &types, std::vector<bool>(layout.slots.size(), false), block});
+    }
+    void statements(std::vector<std::unique_ptr<ASTNode>>& list) {
+        for (auto& stmt : list) stmt->accept(*this);
+    }
+    StaticType expression(ASTNode& node) {
+        node.accept(*this);
+        return type;
+    }
+    void grow(StaticType& slot, StaticType value) {
+        StaticType joined = join(slot, value);
+        if (joined != slot) {
+            slot = joined;
+            changed = true;
+        }
+    }
+    void write_type(int slot, StaticType value) {
+        if (slot >= 0) grow((*scopes.back().types)[slot], value);
+    }
+    void write(int slot, StaticType value) {
+        if (slot < 0) return;
+        write_type(slot, value);
+        scopes.back().assigned[slot] = true;
+    }
+    void check_integer(VarDeclNode& node, StaticType value, const char* what) {
+        node.int_proven = node.type == "integer" && int_like(value);
+        if (node.type == "integer" && value != StaticType::Unknown && value != StaticType::Bottom && !int_like(value)) {
+            error(node, std::string("integer ") + what + " " + symbol_name(node.name) + " initialized with " +
+                            type_name(value));
+        }
+    }
+    void error(const ASTNode& node, const std::string& message) {
+        errors.push_back("Type error: " + message + " at line " + std::to_string(node.line));
+    }
+    static std::string pair(StaticType left, StaticType right) {
+        return std::string(type_name(left)) + " and " + type_name(right);
+    }
+};
+
+} // namespace
+
+const char* type_name(StaticType type) {
+    switch (type) {
+        case StaticType::Bottom: return "nothing";
+        case StaticType::Bool: return "bool";
+        case StaticType::Int: return "int";
+        case StaticType::String: return "string";
+        case StaticType::Instance: return "instance";
+        case StaticType::Array: return "array";
+        case StaticType::Dict: return "dict";
+        case StaticType::Unknown: break;
+    }
+    return "unknown";
+}
+
+namespace {
+
+// Types only grow and each one can grow at most three times (Bottom, a
+// concrete type, Int from Bool, Unknown), so the passes reach a fixed point.
+std::vector<std::string> infer(ASTNode& root, bool whole_program) {
+    TypeInference inference(root, whole_program);
+    while (inference.pass(root)) {
+    }
+    return inference.errors;
+}
+
+void throw_errors(const std::vector<std::string>& errors) {
+    std::string message;
+    for (auto& error : errors) message += (message.empty() ? "" : "\n") + error;
+    if (!message.empty()) throw std::runtime_error(message);
+}
+
+} // namespace
+
+std::vector<std::string> infer_types(ProgramNode& program, bool whole_program) { return infer(program, whole_program); }
+
+void check_types(ProgramNode& program, bool whole_program) { throw_errors(infer(program, whole_program)); }
+
+void check_types(FunctionNode& function) { throw_errors(infer(function, false)); }
@@ -0,0 +1,806 @@
+#include "snapshot.h"
+#include "resolver.h"
+#include "semantic.h"
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <unordered_map>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const char MAGIC[8] = {'L', 'A', 'N', 'G', 'S', 'N', 'A', 'P'};
+const uint32_t VERSION = 2;
+
+// Identifies the build that wrote an image. This file is recompiled whenever
+// a header describing the AST or values changes, so images from any other
+// build, whose node layout may differ, are rejected rather than misread.
+uint64_t build_id() {
+    static const char stamp[] = __DATE__ " " __TIME__;
+    return hash_bytes(stamp, sizeof(stamp) - 1);
+}
+
+// Node tags; 0 is a missing optional child.
+enum Tag : uint8_t {
+    NONE, PROGRAM, BLUEPRINT, VAR_DECL, FUNCTION, IF, WHILE, PRINT, INPUT, BINARY_OP, IDENTIFIER, NUMBER, STRING,
+    BOOLEAN, ASSIGNMENT, CALL, YIELD, INSTANCE, LET_CONST_DECL, PARALLEL_FOR, ACCUMULATE, FIELD_ACCESS,
+    FIELD_ASSIGNMENT, ARRAY_LITERAL, DICT_LITERAL, INDEX, INDEX_ASSIGNMENT, IMPORT, CHOOSE
+};
+
+// Value tags. REF repeats an array or dictionary written earlier.
+enum ValueTag : uint8_t { V_NONE, V_UNSET, V_INT, V_STRING, V_ARRAY, V_DICT, V_INSTANCE, V_REF };
+
+// Appends fixed-width fields in host byte order; symbols become indexes
+// into the image's own name table.
+class Encoder {
+public:
+    std::string bytes;
+    std::vector<Symbol> names; // Image symbol number -> symbol
+
+    void u8(uint8_t v) { bytes.push_back(static_cast<char>(v)); }
+    void u32(uint32_t v) { bytes.append(reinterpret_cast<const char*>(&v), sizeof(v)); }
+    void u64(uint64_t v) { bytes.append(reinterpret_cast<const char*>(&v), sizeof(v)); }
+    void i32(int32_t v) { bytes.append(reinterpret_cast<const char*>(&v), sizeof(v)); }
+    void text(const std::string& s) {
+        u32(static_cast<uint32_t>(s.size()));
+        bytes.append(s);
+    }
+    void symbol(Symbol s) {
+        auto inserted = numbers.insert(std::make_pair(s, static_cast<uint32_t>(names.size())));
+        if (inserted.second) names.push_back(s);
+        u32(inserted.first->second);
+    }
+
+private:
+    std::unordered_map<Symbol, uint32_t> numbers;
+};
+
+// Reads what Encoder wrote, failing cleanly on a truncated or foreign image.
+class Decoder {
+public:
+    Decoder(const char* begin, const char* end, const std::vector<Symbol>& names) : p(begin), end(end), names(names) {}
+
+    const char* p;
+
+    uint8_t u8() {
+        need(1);
+        return static_cast<uint8_t>(*p++);
+    }
+    uint32_t u32() {
+        uint32_t v;
+        need(sizeof(v));
+        std::memcpy(&v, p, sizeof(v));
+        p += sizeof(v);
+        return v;
+    }
+    uint64_t u64() {
+        uint64_t v;
+        need(sizeof(v));
+        std::memcpy(&v, p, sizeof(v));
+        p += sizeof(v);
+        return v;
+    }
+    int32_t i32() { return static_cast<int32_t>(u32()); }
+    std::string text() {
+        uint32_t n = u32();
+        need(n);
+        std::string s(p, n);
+        p += n;
+        return s;
+    }
+    Symbol symbol() {
+        uint32_t n = u32();
+        if (n >= names.size()) corrupt();
+        return names[n];
+    }
+    static void corrupt() { throw std::runtime_error("Corrupt snapshot image"); }
+
+private:
+    const char* end;
+    const std::vector<Symbol>& names;
+
+    void need(size_t n) {
+        if (static_cast<size_t>(end - p) < n) corrupt();
+    }
+};
+
+// Writes a tree as the parser built it; resolver and inference results are
+// recomputed on load. Functions and blueprints are numbered in write order.
+class CodeWriter : public ASTVisitor {
+public:
+    explicit CodeWriter(Encoder& out) : out(out) {}
+
+    std::unordered_map<const ASTNode*, uint32_t> numbers;
+    std::unordered_map<const FrameLayout*, uint32_t> layouts; // Blueprint field layouts, for instances
+
+    void write(ASTNode* node) {
+        if (node) {
+            node->accept(*this);
+        } else {
+            out.u8(NONE);
+        }
+    }
+    template <class T>
+    void write(const std::vector<std::unique_ptr<T>>& nodes) {
+        out.u32(static_cast<uint32_t>(nodes.size()));
+        for (auto& node : nodes) write(node.get());
+    }
+
+    void visit(ProgramNode& node) override {
+        start(PROGRAM, node);
+        write(node.statements);
+    }
+    void visit(BlueprintNode& node) override {
+        start(BLUEPRINT, node);
+        layouts[&node.field_layout] = define(node);
+        out.symbol(node.name);
+        out.u8(node.is_abstract);
+        write(node.fields);
+        write(node.body);
+    }
+    void visit(VarDeclNode& node) override {
+        start(VAR_DECL, node);
+        out.text(node.type);
+        out.symbol(node.name);
+        out.u8(node.is_hidden);
+        write(node.initializer.get());
+    }
+    void visit(FunctionNode& node) override {
+        start(FUNCTION, node);
+        define(node);
+        out.symbol(node.name);
+        out.u8(node.is_hidden);
+        out.u32(static_cast<uint32_t>(node.parameters.size()));
+        for (Symbol param : node.parameters) out.symbol(param);
+        write(node.body);
+    }
+    void visit(IfNode& node) override {
+        start(IF, node);
+        write(node.condition.get());
+        write(node.then_block.get());
+        out.u32(static_cast<uint32_t>(node.else_if_blocks.size()));
+        for (auto& branch : node.else_if_blocks) {
+            write(branch.first.get());
+            write(branch.second.get());
+        }
+        write(node.else_block.get());
+    }
+    void visit(ChooseNode& node) override {
+        start(CHOOSE, node);
+        write(node.subject.get());
+        out.u32(static_cast<uint32_t>(node.cases.size()));
+        for (size_t c = 0; c < node.cases.size(); ++c) {
+            out.u32(static_cast<uint32_t>(node.labels[c].size()));
+            for (auto& label : node.labels[c]) {
+                out.u8(label.is_string);
+                out.i32(label.line);
+                if (label.is_string) {
+                    out.symbol(label.text);
+                } else {
+                    out.i32(label.number);
+                }
+            }
+            write(node.cases[c].get());
+        }
+        write(node.otherwise.get());
+    }
+    void visit(WhileNode& node) override {
+        start(WHILE, node);
+        write(node.condition.get());
+        write(node.body.get());
+    }
+    void visit(PrintNode& node) override {
+        start(PRINT, node);
+        write(node.expression.get());
+    }
+    void visit(InputNode& node) override {
+        start(INPUT, node);
+        out.text(node.type);
+    }
+    void visit(BinaryOpNode& node) override {
+        start(BINARY_OP, node);
+        out.text(node.op);
+        write(node.left.get());
+        write(node.right.get());
+    }
+    void visit(IdentifierNode& node) override {
+        start(IDENTIFIER, node);
+        out.symbol(node.name);
+    }
+    void visit(NumberNode& node) override {
+        start(NUMBER, node);
+        out.i32(node.value);
+    }
+    void visit(StringNode& node) override {
+        start(STRING, node);
+        out.symbol(node.value);
+    }
+    void visit(BooleanNode& node) override {
+        start(BOOLEAN, node);
+        out.u8(node.value);
+    }
+    void visit(AssignmentNode& node) override {
+        start(ASSIGNMENT, node);
+        out.symbol(node.name);
+        write(node.value.get());
+    }
+    void visit(CallNode& node) override {
+        start(CALL, node);
+        out.symbol(node.receiver);
+        out.symbol(node.name);
+        write(node.arguments);
+    }
+    void visit(YieldNode& node) override {
+        start(YIELD, node);
+        write(node.expression.get());
+    }
+    void visit(InstanceNode& node) override {
+        start(INSTANCE, node);
+        out.symbol(node.blueprint_name);
+        out.symbol(node.instance_name);
+    }
+    void visit(LetConstDeclNode& node) override {
+        start(LET_CONST_DECL, node);
+        out.u8(node.is_const);
+        out.symbol(node.name);
+        write(node.initializer.get());
+    }
+    void visit(ParallelForNode& node) override {
+        start(PARALLEL_FOR, node);
+        out.symbol(node.counter);
+        out.symbol(node.accumulator);
+        write(node.start.get());
+        write(node.end.get());
+        write(node.body.get());
+    }
+    void visit(AccumulateNode& node) override {
+        start(ACCUMULATE, node);
+        write(node.expression.get());
+    }
+    void visit(FieldAccessNode& node) override {
+        start(FIELD_ACCESS, node);
+        out.symbol(node.receiver);
+        out.symbol(node.field);
+    }
+    void visit(FieldAssignmentNode& node) override {
+        start(FIELD_ASSIGNMENT, node);
+        out.symbol(node.receiver);
+        out.symbol(node.field);
+        write(node.value.get());
+    }
+    void visit(ArrayLiteralNode& node) override {
+        start(ARRAY_LITERAL, node);
+        write(node.elements);
+    }
+    void visit(DictLiteralNode& node) override {
+        start(DICT_LITERAL, node);
+        write(node.keys);
+        write(node.values);
+    }
+    void visit(IndexNode& node) override {
+        start(INDEX, node);
+        out.symbol(node.name);
+        write(node.index.get());
+    }
+    void visit(IndexAssignmentNode& node) override {
+        start(INDEX_ASSIGNMENT, node);
+        out.symbol(node.name);
+        write(node.index.get());
+        write(node.value.get());
+    }
+    void visit(ImportNode& node) override {
+        start(IMPORT, node);
+        out.text(node.path);
+    }
+    void visit(InlinedCallNode& node) override {
+        throw std::runtime_error("Cannot snapshot inlined code at line " + std::to_string(node.line));
+    }
+
+private:
+    Encoder& out;
+
+    void start(Tag tag, const ASTNode& node) {
+        out.u8(tag);
+        out.i32(node.line);
+    }
+    uint32_t define(const ASTNode& node) {
+        uint32_t number = static_cast<uint32_t>(numbers.size());
+        numbers[&node] = number;
+        return number;
+    }
+};
+
+// Rebuilds what CodeWriter wrote, numbering functions and blueprints the same way.
+class CodeReader {
+public:
+    CodeReader(Decoder& in, std::vector<ASTNode*>& defined) : in(in), defined(defined) {}
+
+    std::unique_ptr<ASTNode> read() {
+        uint8_t tag = in.u8();
+        if (tag == NONE) return nullptr;
+        int line = in.i32();
+        switch (tag) {
+            case PROGRAM: {
+                std::unique_ptr<ProgramNode> node(new ProgramNode(line));
+                read(node->statements);
+                return std::move(node);
+            }
+            case BLUEPRINT: {
+                Symbol name = in.symbol();
+                std::unique_ptr<BlueprintNode> node(new BlueprintNode(name, line));
+                defined.push_back(node.get());
+                node->is_abstract = in.u8() != 0;
+                read(node->fields);
+                for (auto& field : node->fields) node->field_layout.add(field->name);
+                read(node->body);
+                return std::move(node);
+            }
+            case VAR_DECL: {
+                std::string type = in.text();
+                Symbol name = in.symbol();
+                std::unique_ptr<VarDeclNode> node(new VarDeclNode(type, name, line));
+                node->is_hidden = in.u8() != 0;
+                node->initializer = read();
+                return std::move(node);
+            }
+            case FUNCTION: {
+                Symbol name = in.symbol();
+                std::unique_ptr<FunctionNode> node(new FunctionNode(name, line));
+                defined.push_back(node.get());
+                node->is_hidden = in.u8() != 0;
+                uint32_t count = in.u32();
+                for (uint32_t i = 0; i < count; ++i) node->parameters.push_back(in.symbol());
+                read(node->body);
+                return std::move(node);
+            }
+            case IF: {
+                std::unique_ptr<IfNode> node(new IfNode(line));
+                node->condition = required();
+                node->then_block = block();
+                uint32_t count = in.u32();
+                for (uint32_t i = 0; i < count; ++i) {
+                    std::unique_ptr<ASTNode> condition = required();
+                    node->else_if_blocks.emplace_back(std::move(condition), block());
+                }
+                std::unique_ptr<ASTNode> else_block = read();
+                if (else_block) node->else_block = as<ProgramNode>(std::move(else_block));
+                return std::move(node);
+            }
+            case CHOOSE: {
+                std::unique_ptr<ChooseNode> node(new ChooseNode(line));
+                node->subject = required();
+                uint32_t count = in.u32();
+                for (uint32_t c = 0; c < count; ++c) {
+                    std::vector<ChooseNode::Label> labels;
+                    uint32_t labels_count = in.u32();
+                    for (uint32_t i = 0; i < labels_count; ++i) {
+                        ChooseNode::Label label{in.u8() != 0, 0, NO_SYMBOL, 0};
+                        label.line = in.i32();
+                        if (label.is_string) {
+                            label.text = in.symbol();
+                        } else {
+                            label.number = in.i32();
+                        }
+                        labels.push_back(label);
+                    }
+                    node->labels.push_back(std::move(labels));
+                    node->cases.push_back(block());
+                }
+                std::unique_ptr<ASTNode> otherwise = read();
+                if (otherwise) node->otherwise = as<ProgramNode>(std::move(otherwise));
+                node->build_dispatch();
+                return std::move(node);
+            }
+            case WHILE: {
+                std::unique_ptr<WhileNode> node(new WhileNode(line));
+                node->condition = required();
+                node->body = block();
+                return std::move(node);
+            }
+            case PRINT: {
+                std::unique_ptr<PrintNode> node(new PrintNode(line));
+                node->expression = required();
+                return std::move(node);
+            }
+            case INPUT:
+                return std::unique_ptr<ASTNode>(new InputNode(in.text(), line));
+            case BINARY_OP: {
+                std::unique_ptr<BinaryOpNode> node(new BinaryOpNode(in.text(), line));
+                node->left = required();
+                node->right = required();
+                return std::move(node);
+            }
+            case IDENTIFIER:
+                return std::unique_ptr<ASTNode>(new IdentifierNode(in.symbol(), line));
+            case NUMBER:
+                return std::unique_ptr<ASTNode>(new NumberNode(std::to_string(in.i32()), line));
+            case STRING:
+                return std::unique_ptr<ASTNode>(new StringNode(in.symbol(), line));
+            case BOOLEAN:
+                return std::unique_ptr<ASTNode>(new BooleanNode(in.u8() != 0, line));
+            case ASSIGNMENT: {
+                std::unique_ptr<AssignmentNode> node(new AssignmentNode(in.symbol(), line));
+                node->value = required();
+                return std::move(node);
+            }
+            case CALL: {
+                Symbol receiver = in.symbol();
+                Symbol name = in.symbol();
+                std::unique_ptr<CallNode> node(new CallNode(receiver, name, line));
+                read(node->arguments);
+                return std::move(node);
+            }
+            case YIELD: {
+                std::unique_ptr<YieldNode> node(new YieldNode(line));
+                node->expression = required();
+                return std::move(node);
+            }
+            case INSTANCE: {
+                Symbol blueprint = in.symbol();
+                Symbol name = in.symbol();
+                return std::unique_ptr<ASTNode>(new InstanceNode(blueprint, name, line));
+            }
+            case LET_CONST_DECL: {
+                bool is_const = in.u8() != 0;
+                std::unique_ptr<LetConstDeclNode> node(new LetConstDeclNode(is_const, in.symbol(), line));
+                node->initializer = read();
+                return std::move(node);
+            }
+            case PARALLEL_FOR: {
+                std::unique_ptr<ParallelForNode> node(new ParallelForNode(line));
+                node->counter = in.symbol();
+                node->accumulator = in.symbol();
+                node->start = required();
+                node->end = required();
+                node->body = block();
+                return std::move(node);
+            }
+            case ACCUMULATE: {
+                std::unique_ptr<AccumulateNode> node(new AccumulateNode(line));
+                node->expression = required();
+                return std::move(node);
+            }
+            case FIELD_ACCESS: {
+                Symbol receiver = in.symbol();
+                return std::unique_ptr<ASTNode>(new FieldAccessNode(receiver, in.symbol(), line));
+            }
+            case FIELD_ASSIGNMENT: {
+                Symbol receiver = in.symbol();
+                std::unique_ptr<FieldAssignmentNode> node(new FieldAssignmentNode(receiver, in.symbol(), line));
+                node->value = required();
+                return std::move(node);
+            }
+            case ARRAY_LITERAL: {
+                std::unique_ptr<ArrayLiteralNode> node(new ArrayLiteralNode(line));
+                read(node->elements);
+                return std::move(node);
+            }
+            case DICT_LITERAL: {
+                std::unique_ptr<DictLiteralNode> node(new DictLiteralNode(line));
+                read(node->keys);
+                read(node->values);
+                return std::move(node);
+            }
+            case INDEX: {
+                std::unique_ptr<IndexNode> node(new IndexNode(in.symbol(), line));
+                node->index = required();
+                return std::move(node);
+            }
+            case INDEX_ASSIGNMENT: {
+                std::unique_ptr<IndexAssignmentNode> node(new IndexAssignmentNode(in.symbol(), line));
+                node->index = required();
+                node->value = required();
+                return std::move(node);
+            }
+            case IMPORT:
+                return std::unique_ptr<ASTNode>(new ImportNode(in.text(), line));
+        }
+        Decoder::corrupt();
+        return nullptr;
+    }
+
+    template <class T>
+    void read(std::vector<std::unique_ptr<T>>& nodes) {
+        uint32_t count = in.u32();
+        for (uint32_t i = 0; i < count; ++i) nodes.push_back(as<T>(required()));
+    }
+
+private:
+    Decoder& in;
+    std::vector<ASTNode*>& defined;
+
+    template <class T>
+    static std::unique_ptr<T> as(std::unique_ptr<ASTNode> node) {
+        if (!dynamic_cast<T*>(node.get())) Decoder::corrupt();
+        return std::unique_ptr<T>(static_cast<T*>(node.release()));
+    }
+    std::unique_ptr<ASTNode> required() {
+        std::unique_ptr<ASTNode> node = read();
+        if (!node) Decoder::corrupt();
+        return node;
+    }
+    std::unique_ptr<ProgramNode> block() { return as<ProgramNode>(required()); }
+};
+
+// Writes values, remembering arrays and dictionaries so shared ones stay shared.
+class ValueWriter {
+public:
+    ValueWriter(Encoder& out, const CodeWriter& code) : out(out), code(code) {}
+
+    void write(const Value& value) {
+        switch (value.type) {
+            case Value::Type::None: out.u8(V_NONE); return;
+            case Value::Type::Unset: out.u8(V_UNSET); return;
+            case Value::Type::Int:
+                out.u8(V_INT);
+                out.i32(value.int_val);
+                return;
+            case Value::Type::String:
+                out.u8(V_STRING);
+                out.u8(value.int_val != NO_SYMBOL); // Interned, as literals are
+                out.text(value.as_string());
+                return;
+            case Value::Type::Array:
+            case Value::Type::Dict: {
+                auto seen = objects.insert(std::make_pair(value.object.get(), static_cast<uint32_t>(objects.size())));
+                if (!seen.second) {
+                    out.u8(V_REF);
+                    out.u32(seen.first->second);
+                    return;
+                }
+                if (value.type == Value::Type::Array) {
+                    const Array& array = value.array();
+                    out.u8(V_ARRAY);
+                    out.u32(static_cast<uint32_t>(array.size()));
+                    for (size_t i = 0; i < array.size(); ++i) write(array.get(i));
+                } else {
+                    const Dict& dict = value.dict();
+                    out.u8(V_DICT);
+                    out.u32(static_cast<uint32_t>(dict.size()));
+                    for (auto& entry : dict.entries) {
+                        if (entry.key.type == Value::Type::Unset) continue; // Erased
+                        write(entry.key);
+                        write(entry.value);
+                    }
+                }
+                return;
+            }
+            case Value::Type::Instance: {
+                const Instance& object = *value.instance;
+                auto layout = code.layouts.find(object.layout);
+                if (layout == code.layouts.end()) throw std::runtime_error("Cannot snapshot an instance of an imported blueprint");
+                out.u8(V_INSTANCE);
+                out.u32(layout->second);
+                out.symbol(object.blueprint);
+                for (uint32_t i = 0; i < object.count; ++i) write(object.fields()[i]);
+                return;
+            }
+            case Value::Type::File:
+                throw std::runtime_error("Cannot snapshot a file handle");
+        }
+    }
+
+private:
+    Encoder& out;
+    const CodeWriter& code;
+    std::unordered_map<const Object*, uint32_t> objects;
+};
+
+class ValueReader {
+public:
+    ValueReader(Decoder& in, const std::vector<ASTNode*>& defined) : in(in), defined(defined) {}
+
+    Value read() {
+        switch (in.u8()) {
+            case V_NONE: return Value();
+            case V_UNSET: return Value::unset();
+            case V_INT: return Value(static_cast<int>(in.i32()));
+            case V_STRING: {
+                bool interned = in.u8() != 0;
+                Value text(in.text());
+                if (interned) text.int_val = SymbolTable::intern(text.as_string());
+                return text;
+            }
+            case V_ARRAY: {
+                Array* array = new Array();
+                Value value(array);
+                objects.push_back(value);
+                uint32_t count = in.u32();
+                for (uint32_t i = 0; i < count; ++i) array->push(read());
+                return value;
+            }
+            case V_DICT: {
+                Dict* dict = new Dict();
+                Value value(dict);
+                objects.push_back(value);
+                uint32_t count = in.u32();
+                for (uint32_t i = 0; i < count; ++i) {
+                    Value key = read();
+                    if (!Dict::valid_key(key)) Decoder::corrupt();
+                    dict->insert(key) = read();
+                }
+                return value;
+            }
+            case V_INSTANCE: {
+                uint32_t number = in.u32();
+                auto* blueprint = number < defined.size() ? dynamic_cast<BlueprintNode*>(defined[number]) : nullptr;
+                if (!blueprint) Decoder::corrupt();
+                Value value(Instance::create(in.symbol(), blueprint->field_layout));
+                for (uint32_t i = 0; i < value.instance->count; ++i) value.instance->fields()[i] = read();
+                return value;
+            }
+            case V_REF: {
+                uint32_t number = in.u32();
+                if (number >= objects.size()) Decoder::corrupt();
+                return objects[number];
+            }
+        }
+        Decoder::corrupt();
+        return Value();
+    }
+
+private:
+    Decoder& in;
+    const std::vector<ASTNode*>& defined;
+    std::vector<Value> objects; // Arrays and dictionaries by number, for V_REF
+};
+
+template <class Node>
+void write_registrations(Encoder& out, const std::unordered_map<Symbol, Node*>& entries, const CodeWriter& code) {
+    std::vector<std::pair<Symbol, uint32_t>> known;
+    for (auto& entry : entries) {
+        auto number = code.numbers.find(entry.second);
+        if (number != code.numbers.end()) known.push_back(std::make_pair(entry.first, number->second));
+    }
+    out.u32(static_cast<uint32_t>(known.size()));
+    for (auto& entry : known) {
+        out.symbol(entry.first);
+        out.u32(entry.second);
+    }
+}
+
+template <class Node>
+void read_registrations(Decoder& in, const std::vector<ASTNode*>& defined, std::vector<std::pair<Symbol, Node*>>& entries) {
+    uint32_t count = in.u32();
+    for (uint32_t i = 0; i < count; ++i) {
+        Symbol name = in.symbol();
+        uint32_t number = in.u32();
+        Node* node = number < defined.size() ? dynamic_cast<Node*>(defined[number]) : nullptr;
+        if (!node) Decoder::corrupt();
+        entries.push_back(std::make_pair(name, node));
+    }
+}
+
+} // namespace
+
+// Image layout: magic, version, build id, name table, code, registered functions and
+// blueprints, then the top-level variables by name. The name table comes
+// first but is only complete once everything else is encoded, so the rest
+// is encoded before it.
+void write_snapshot(const std::string& path, ProgramNode& program, const ExecutionContext& ctx) {
+    if (ctx.frames.size() != 1 || ctx.frames[0].layout != &program.layout) {
+        throw std::runtime_error("Cannot snapshot: the initialization script must run alone, as a module");
+    }
+    Encoder body;
+    CodeWriter code(body);
+    code.write(&program);
+    write_registrations(body, ctx.functions, code);
+    write_registrations(body, ctx.blueprints, code);
+    uint32_t globals_offset = static_cast<uint32_t>(body.bytes.size());
+
+    std::vector<std::pair<Symbol, const Value*>> globals;
+    for (size_t s = 0; s < program.layout.slots.size(); ++s) {
+        const Value& value = ctx.stack[ctx.frames[0].base + s];
+        if (value.type != Value::Type::Unset) globals.push_back(std::make_pair(program.layout.slots[s], &value));
+    }
+    body.u32(static_cast<uint32_t>(globals.size()));
+    ValueWriter values(body, code);
+    for (auto& global : globals) {
+        body.symbol(global.first);
+        try {
+            values.write(*global.second);
+        } catch (const std::runtime_error& e) {
+            throw std::runtime_error(std::string(e.what()) + " (variable " + symbol_name(global.first) + ")");
+        }
+    }
+
+    Encoder header;
+    header.bytes.append(MAGIC, sizeof(MAGIC));
+    header.u32(VERSION);
+    header.u64(build_id());
+    header.u32(static_cast<uint32_t>(body.names.size()));
+    for (Symbol name : body.names) header.text(symbol_name(name));
+    header.u32(globals_offset);
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write(header.bytes.data(), header.bytes.size());
+    file.write(body.bytes.data(), body.bytes.size());
+    if (!file) throw std::runtime_error("Cannot write snapshot " + path);
+}
+
+Snapshot::~Snapshot() {
+#ifndef _WIN32
+    if (mapped) {
+        munmap(const_cast<char*>(image), size);
+        return;
+    }
+#endif
+    delete[] image;
+}
+
+std::shared_ptr<const Snapshot> Snapshot::load(const std::string& path) {
+    std::shared_ptr<Snapshot> snapshot(new Snapshot());
+#ifndef _WIN32
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("Cannot open snapshot " + path);
+    struct stat info;
+    if (fstat(fd, &info) == 0 && info.st_size > 0) {
+        void* memory = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (memory != MAP_FAILED) {
+            snapshot->image = static_cast<const char*>(memory);
+            snapshot->size = static_cast<size_t>(info.st_size);
+            snapshot->mapped = true;
+        }
+    }
+    close(fd);
+#endif
+    if (!snapshot->mapped) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open()) throw std::runtime_error("Cannot open snapshot " + path);
+        std::string bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        char* copy = new char[bytes.size()];
+        std::memcpy(copy, bytes.data(), bytes.size());
+        snapshot->image = copy;
+        snapshot->size = bytes.size();
+    }
+
+    const char* end = snapshot->image + snapshot->size;
+    if (snapshot->size < sizeof(MAGIC) || std::memcmp(snapshot->image, MAGIC, sizeof(MAGIC)) != 0) {
+        throw std::runtime_error(path + " is not a snapshot");
+    }
+    Decoder in(snapshot->image + sizeof(MAGIC), end, snapshot->symbols);
+    if (in.u32() != VERSION || in.u64() != build_id()) throw std::runtime_error(path + " was written by another build");
+    uint32_t count = in.u32();
+    snapshot->symbols.reserve(count);
+    for (uint32_t i = 0; i < count; ++i) snapshot->symbols.push_back(SymbolTable::intern(in.text()));
+    uint32_t globals_offset = in.u32();
+    const char* body = in.p;
+
+    CodeReader code(in, snapshot->defined);
+    std::unique_ptr<ASTNode> root = code.read();
+    if (!dynamic_cast<ProgramNode*>(root.get())) Decoder::corrupt();
+    snapshot->ast.reset(static_cast<ProgramNode*>(root.release()));
+    read_registrations(in, snapshot->defined, snapshot->functions);
+    read_registrations(in, snapshot->defined, snapshot->blueprints);
+    if (in.p != body + globals_offset) Decoder::corrupt();
+    snapshot->globals_offset = static_cast<size_t>(in.p - snapshot->image);
+
+    // As the module loader prepares a module, so the layout matches the saved frame.
+    resolve_slots(*snapshot->ast);
+    check_types(*snapshot->ast, false);
+    return snapshot;
+}
+
+void Snapshot::restore(ExecutionContext& ctx) const {
+    if (!ctx.frames.empty()) throw std::runtime_error("A snapshot must be restored into a fresh context");
+    size_t base = ctx.stack.size();
+    ctx.stack.resize(base + ast->layout.slots.size(), Value::unset());
+    ctx.frames.push_back(Frame{base, &ast->layout, nullptr});
+
+    Decoder in(image + globals_offset, image + size, symbols);
+    ValueReader values(in, defined);
+    uint32_t count = in.u32();
+    for (uint32_t i = 0; i < count; ++i) {
+        int slot = ast->layout.find(in.symbol());
+        if (slot < 0) Decoder::corrupt();
+        ctx.stack[base + slot] = values.read();
+    }
+    for (auto& entry : functions) ctx.functions[entry.first] = entry.second;
+    for (auto& entry : blueprints) ctx.blueprints[entry.first] = entry.second;
+    ++ctx.definitions;
+}
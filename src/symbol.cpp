@@ -0,0 +1,74 @@
+#include "symbol.h"
+#include <atomic>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace {
+
+const size_t BLOCK_BITS = 12;
+const size_t BLOCK_SIZE = size_t(1) << BLOCK_BITS;
+const size_t MAX_BLOCKS = 4096; // 16M symbols
+
+struct Entry {
+    std::string name;
+    uint64_t hash;
+};
+
+// Names live in fixed-size blocks that are never reallocated, so a reader
+// holding a symbol can index them without taking the lock.
+struct Table {
+    std::mutex mutex;
+    std::unordered_map<std::string, Symbol> index;
+    std::atomic<Entry*> blocks[MAX_BLOCKS];
+    std::atomic<size_t> count;
+
+    Table() : count(0) {
+        for (auto& b : blocks) b.store(nullptr);
+        insert("");
+    }
+
+    Symbol insert(const std::string& text) {
+        size_t id = count.load();
+        if (id >= BLOCK_SIZE * MAX_BLOCKS) throw std::runtime_error("Symbol table full");
+        Entry* block = blocks[id >> BLOCK_BITS].load();
+        if (!block) {
+            block = new Entry[BLOCK_SIZE];
+            blocks[id >> BLOCK_BITS].store(block);
+        }
+        block[id & (BLOCK_SIZE - 1)].name = text;
+        block[id & (BLOCK_SIZE - 1)].hash = hash_bytes(text.data(), text.size());
+        index.emplace(text, static_cast<Symbol>(id));
+        count.store(id + 1);
+        return static_cast<Symbol>(id);
+    }
+};
+
+Table& table() {
+    static Table* t = new Table(); // Never destroyed: names outlive static destructors
+    return *t;
+}
+
+} // namespace
+
+Symbol SymbolTable::intern(const std::string& text) {
+    Table& t = table();
+    std::lock_guard<std::mutex> lock(t.mutex);
+    auto it = t.index.find(text);
+    if (it != t.index.end()) return it->second;
+    return t.insert(text);
+}
+
+const std::string& SymbolTable::name(Symbol symbol) {
+    Table& t = table();
+    return t.blocks[symbol >> BLOCK_BITS].load(std::memory_order_acquire)[symbol & (BLOCK_SIZE - 1)].name;
+}
+
+uint64_t SymbolTable::hash(Symbol symbol) {
+    Table& t = table();
+    return t.blocks[symbol >> BLOCK_BITS].load(std::memory_order_acquire)[symbol & (BLOCK_SIZE - 1)].hash;
+}
+
+size_t SymbolTable::size() {
+    return table().count.load();
+}
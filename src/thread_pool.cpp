@@ -0,0 +1,160 @@
+#include "thread_pool.h"
+
+ThreadPool::ThreadPool(unsigned workers) {
+    if (workers == 0) workers = 1;
+    for (unsigned i = 0; i < workers; ++i) {
+        threads.emplace_back(&ThreadPool::worker_loop, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    work_ready.notify_all();
+    for (auto& t : threads) t.join();
+}
+
+unsigned ThreadPool::hardware_threads() {
+    unsigned n = std::thread::hardware_concurrency();
+    return n == 0 ? 1 : n;
+}
+
+void ThreadPool::submit(std::function<void()> job) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queue.push_back(std::move(job));
+        pending++;
+    }
+    work_ready.notify_one();
+}
+
+void ThreadPool::wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    work_done.wait(lock, [this] { return pending == 0; });
+}
+
+void ThreadPool::worker_loop() {
+    while (true) {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            work_ready.wait(lock, [this] { return stopping || !queue.empty(); });
+            if (queue.empty()) return; // Stopping and drained
+            job = std::move(queue.front());
+            queue.pop_front();
+        }
+        job(); // Jobs are expected to catch their own exceptions
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--pending == 0) work_done.notify_all();
+        }
+    }
+}
+
+WorkStealingPool::WorkStealingPool(unsigned count) : remaining(0) {
+    if (count == 0) count = 1;
+    for (unsigned i = 0; i < count; ++i) workers.emplace_back(new Worker());
+    for (unsigned i = 0; i < count; ++i) {
+        workers[i]->thread = std::thread(&WorkStealingPool::worker_loop, this, i);
+    }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    loop_ready.notify_all();
+    for (auto& w : workers) w->thread.join();
+}
+
+WorkStealingPool& WorkStealingPool::shared(unsigned count, std::unique_lock<std::mutex>& lock) {
+    static std::mutex shared_mutex;
+    static std::unique_ptr<WorkStealingPool> pool;
+    if (count == 0) count = ThreadPool::hardware_threads();
+    lock = std::unique_lock<std::mutex>(shared_mutex);
+    if (!pool || pool->size() != count) {
+        pool.reset();
+        pool.reset(new WorkStealingPool(count));
+    }
+    return *pool;
+}
+
+void WorkStealingPool::parallel_for(long begin, long end, long chunk, const RangeBody& fn) {
+    if (end <= begin) return;
+    unsigned n = size();
+    long total = end - begin;
+    // Seed every deque with an equal share so stealing only has to fix imbalance.
+    for (unsigned i = 0; i < n; ++i) {
+        long b = begin + total * i / n;
+        long e = begin + total * (i + 1) / n;
+        if (b < e) workers[i]->ranges.push_back(Range{b, e});
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    body = &fn;
+    grain = chunk < 1 ? 1 : chunk;
+    remaining.store(total);
+    active = n;
+    generation++;
+    loop_ready.notify_all();
+    loop_done.wait(lock, [this] { return active == 0; });
+    body = nullptr;
+}
+
+bool WorkStealingPool::pop_local(unsigned index, Range& out) {
+    Worker& w = *workers[index];
+    std::lock_guard<std::mutex> lock(w.mutex);
+    if (w.ranges.empty()) return false;
+    out = w.ranges.back();
+    w.ranges.pop_back();
+    while (out.end - out.begin > grain) {
+        long mid = out.begin + (out.end - out.begin) / 2;
+        w.ranges.push_back(Range{mid, out.end});
+        out.end = mid;
+    }
+    return true;
+}
+
+bool WorkStealingPool::steal(unsigned thief, Range& out) {
+    unsigned n = size();
+    for (unsigned k = 1; k < n; ++k) {
+        Worker& victim = *workers[(thief + k) % n];
+        {
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (victim.ranges.empty()) continue;
+            out = victim.ranges.front();
+            victim.ranges.pop_front();
+        }
+        // The stolen range goes onto the thief's own deque to be split there.
+        Worker& w = *workers[thief];
+        std::lock_guard<std::mutex> own(w.mutex);
+        w.ranges.push_back(out);
+        return true;
+    }
+    return false;
+}
+
+void WorkStealingPool::worker_loop(unsigned index) {
+    unsigned seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            loop_ready.wait(lock, [this, seen] { return stopping || generation != seen; });
+            if (stopping) return;
+            seen = generation;
+        }
+        Range r;
+        while (remaining.load() > 0) {
+            if (pop_local(index, r)) {
+                (*body)(index, r.begin, r.end);
+                remaining -= r.end - r.begin;
+            } else if (!steal(index, r)) {
+                std::this_thread::yield();
+            }
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--active == 0) loop_done.notify_all();
+    }
+}
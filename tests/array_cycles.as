@@ -0,0 +1,16 @@
+// Arrays may hold other arrays, and the same array more than once
+let inner := [1, 2];
+let outer := [inner, inner];
+append(outer, [inner]);
+lets_print{outer};
+
+// Storing an array inside itself, directly or through another container, is an error
+let a := [1];
+let b := [a];
+b[0] := [2];
+fill(b, [3]);
+lets_print{a};
+lets_print{b};
+append(a, [[b]]);
+lets_print{a};
+append(b, a);
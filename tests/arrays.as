@@ -0,0 +1,22 @@
+let a := [5, 3, 9, 1];
+append(a, 7);
+lets_print{a};
+lets_print{length(a)};
+lets_print{a[2]};
+a[0] := 4;
+lets_print{sum(a)};
+lets_print{min(a) + max(a)};
+sort(a);
+lets_print{a};
+lets_print{search(a, 9)};
+lets_print{map(a, "*", 10)};
+
+// Arrays are shared: b names the same array
+let b := a;
+fill(b, 0);
+lets_print{a};
+
+let words := ["pear", "apple", "fig"];
+sort(words);
+lets_print{words};
+lets_print{range(5)};
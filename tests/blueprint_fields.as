@@ -0,0 +1,27 @@
+blueprint Point {
+    let x := 0;
+    let y := 0;
+    var label := "origin";
+
+    define move(dx, dy) {
+        x := x + dx;
+        y := y + dy;
+    }
+
+    define sum() {
+        yield x + y;
+    }
+}
+
+instance Point p;
+p.move(3, 4);
+lets_print{p.sum()};
+p.label := "moved";
+lets_print{p.label};
+lets_print{p.x};
+
+// Instances are values: q is a copy
+let q := p;
+q.move(10, 10);
+lets_print{p.x};
+lets_print{q.x};
@@ -0,0 +1,14 @@
+// Deep recursion within the native stack runs normally
+define depth(n) {
+    check_if (n > 0) {
+        yield 1 + depth(n - 1);
+    }
+    yield 0;
+}
+lets_print{depth(1000)};
+
+// Unbounded recursion stops with an error at the call instead of crashing
+define forever(n) {
+    yield forever(n + 1);
+}
+lets_print{forever(0)};
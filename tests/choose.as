@@ -0,0 +1,54 @@
+// choose picks one case by table (dense ints), by hash (sparse ints and
+// strings) or falls through to otherwise; labels only match their own type.
+define dense(n) {
+    choose (n) {
+        when 0 { yield "zero"; }
+        when 1, 2 { yield "few"; }
+        when 3 { yield "three"; }
+        when -1 { yield "minus one"; }
+    }
+    yield "many";
+}
+define sparse(n) {
+    choose (n) {
+        when 7 { yield "seven"; }
+        when 1000 { yield "thousand"; }
+        when -50000 { yield "far"; }
+        otherwise { yield "other"; }
+    }
+}
+define command(word) {
+    choose (word) {
+        when "go", "run" { yield 1; }
+        when "stop" { yield 2; }
+        when "" { yield 3; }
+        when 4 { yield 4; }
+        otherwise { yield 0; }
+    }
+}
+let i := 0 - 2;
+repeat_while (5 > i) {
+    lets_print{dense(i)};
+    i := i + 1;
+}
+lets_print{sparse(7)};
+lets_print{sparse(1000)};
+lets_print{sparse(0 - 50000)};
+lets_print{sparse(8)};
+lets_print{command("go")};
+lets_print{command("r" + "un")};
+lets_print{command("stop")};
+lets_print{command("")};
+lets_print{command(4)};
+lets_print{command("4")};
+lets_print{command([1])};
+let parts := ["st", "op"];
+lets_print{command(parts[0] + parts[1])};
+let total := 0;
+parallel_repeat (k := 0 until 40) accumulate total {
+    choose (k) {
+        when 1, 3, 5 { accumulate 100; }
+        otherwise { accumulate 1; }
+    }
+}
+lets_print{total};
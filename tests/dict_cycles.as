@@ -0,0 +1,12 @@
+// Dictionaries may hold other dictionaries, and the same one more than once
+let inner := {"x": 1};
+let outer := {"a": inner, "b": inner};
+outer["c"] := [inner];
+lets_print{outer};
+
+// Storing a dictionary inside itself, directly or through another container, is an error
+let d := {};
+let list := [d];
+d["list"] := [1];
+lets_print{d};
+d["self"] := d;
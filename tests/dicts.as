@@ -0,0 +1,31 @@
+let ages := {"ana": 31, "bo": 27};
+ages["cy"] := 45;
+ages["bo"] := 28;
+lets_print{ages};
+lets_print{length(ages)};
+lets_print{ages["bo"]};
+lets_print{has(ages, "cy")};
+lets_print{get(ages, "dee", 0)};
+lets_print{remove(ages, "ana")};
+lets_print{keys(ages)};
+lets_print{values(ages)};
+
+// Built strings find entries stored under literals
+let name := "c" + "y";
+lets_print{ages[name]};
+
+// Integer keys, shared like arrays
+let doubles := {};
+let copy := doubles;
+let i := 0;
+repeat_while (100 > i) {
+    doubles[i] := i + i;
+    i := i + 1;
+}
+i := 0;
+repeat_while (100 > i) {
+    remove(doubles, i);
+    i := i + 2;
+}
+lets_print{length(copy)};
+lets_print{doubles[99]};
@@ -0,0 +1,18 @@
+// Reads this script back line by line (run from the repository root).
+let f := open_file("tests/files.as");
+let count := 0;
+let longest := 0;
+repeat_while (has_line(f)) {
+    let line := read_line(f);
+    count := count + 1;
+    repeat_while (length(line) > longest) {
+        longest := length(line);
+    }
+}
+lets_print{count};
+lets_print{longest};
+
+let row := "  GET /index.html   200 5120 ";
+lets_print{field(row, 1)};
+lets_print{number(field(row, 3)) + 1};
+lets_print{length(field(row, 9))};
@@ -0,0 +1,10 @@
+// shapes.as and labels.as both import units.as (a diamond).
+import "modules/shapes.as";
+import "modules/labels.as";
+
+instance Rect r;
+r.w := 3;
+r.h := 4;
+lets_print{r.perimeter()};
+lets_print{label("side", r.w)};
+lets_print{unit};
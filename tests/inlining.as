@@ -0,0 +1,51 @@
+// Calls to one-expression functions and getters are replaced by their
+// bodies; the output must match the calls.
+define area(w, h) {
+    yield w + w + h + h;
+}
+define shout(text) {
+    let loud := text + "!";
+    lets_print{loud};
+    yield 1;
+}
+
+// Parameters are renamed apart from the caller's variables.
+let w := 100;
+let h := 200;
+lets_print{area(h, w)};
+lets_print{area(area(1, 2), 3)};
+
+// Arguments still run once each, in order.
+lets_print{area(shout("one"), shout("two"))};
+
+blueprint Account {
+    let balance := 10;
+    let owner := "ada";
+    define total(extra) {
+        yield balance + extra;
+    }
+    // The parameter shadows the field of the same name.
+    define greet(owner) {
+        yield "hi " + owner;
+    }
+    define deposit(amount) {
+        balance := balance + amount;
+    }
+}
+instance Account acct;
+acct.deposit(5);
+lets_print{acct.total(1)};
+lets_print{acct.greet("bob")};
+let i := 0;
+integer sum := 0;
+repeat_while (5 > i) {
+    sum := sum + acct.total(i);
+    i := i + 1;
+}
+lets_print{sum};
+
+// Reached before its definition runs: stays a call, and fails as one.
+lets_print{early()};
+define early() {
+    yield 7;
+}
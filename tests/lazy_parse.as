@@ -0,0 +1,20 @@
+// Run with --lazy-parse, on either engine. Function bodies are parsed on
+// their first call, so a syntax error in a body that is never called does
+// not stop the script, and one in a called body is reported at that call.
+define never_called() {
+    let x := ;
+}
+
+define add_one(n) {
+    yield n + 1;
+}
+
+define broken(n) {
+    let y := n + 1;
+    yield y + ;
+}
+
+lets_print{add_one(1)};
+lets_print{"before the broken call"};
+lets_print{broken(1)};
+lets_print{"not reached"};
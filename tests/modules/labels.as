@@ -0,0 +1,5 @@
+import "units.as";
+
+define label(name, n) {
+    yield name + ": " + with_unit(n);
+}
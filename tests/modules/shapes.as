@@ -0,0 +1,9 @@
+import "units.as";
+
+blueprint Rect {
+    let w := 0;
+    let h := 0;
+    define perimeter() {
+        yield with_unit(w + w + h + h);
+    }
+}
@@ -0,0 +1,7 @@
+// Imported by both shapes.as and labels.as; loaded and run once.
+let unit := "cm";
+lets_print{"units loaded"};
+
+define with_unit(n) {
+    yield n + unit;
+}
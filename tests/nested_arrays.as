@@ -0,0 +1,23 @@
+// Arrays nested 200000 deep are built, measured and freed without
+// recursing once per level
+let a := [0];
+let i := 0;
+repeat_while (200000 > i) {
+    a := [a];
+    i := i + 1;
+}
+lets_print{length(a)};
+a := 0;
+
+// Printing nested arrays and dictionaries
+let small := [[1, [2, []]], {"k": [3, {}], "n": {"m": 4}}, "s"];
+lets_print{small};
+
+let deep := [];
+i := 0;
+repeat_while (200000 > i) {
+    deep := [deep];
+    i := i + 1;
+}
+let text := "" + deep;
+lets_print{length(text)};
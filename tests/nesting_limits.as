@@ -0,0 +1,28 @@
+// Run with --max-heap-mb 64 --max-steps 10000000: a script under limits
+// may nest arrays 200000 deep and dictionaries 20000 deep, and freeing,
+// printing or handing them to parallel_repeat workers does not overflow
+// the stack.
+let a := [0];
+let d := {};
+let i := 0;
+repeat_while (200000 > i) {
+    a := [a];
+    i := i + 1;
+}
+i := 0;
+repeat_while (20000 > i) {
+    d := {"next": d};
+    i := i + 1;
+}
+lets_print{length(a) + length(d)};
+lets_print{length("" + a)};
+lets_print{length("" + d)};
+
+let seen := 0;
+parallel_repeat (k := 0 until 4) accumulate seen {
+    accumulate length(a);
+}
+lets_print{seen};
+a := 0;
+d := 0;
+lets_print{"freed"};
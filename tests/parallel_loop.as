@@ -0,0 +1,19 @@
+// Sum of squares, split across the work-stealing pool
+let total := 0;
+parallel_repeat (i := 1 until 11) accumulate total {
+    let square := 0;
+    let k := 0;
+    repeat_while (i > k) {
+        square := square + i;
+        k := k + 1;
+    }
+    accumulate square;
+}
+lets_print{"Sum of squares: " + total};
+
+// Output and string accumulation keep index order
+let digits := "";
+parallel_repeat (d := 0 until 10) accumulate digits {
+    accumulate "" + d;
+}
+lets_print{digits};
@@ -0,0 +1,15 @@
+// Every broken statement is reported, not just the first: the parser skips
+// to the end of each one and carries on with the next.
+let a := 1 + ;
+define twice(x) {
+    let y := x + x
+    yield y;
+}
+lets_print{a};
+let c := 3 & 4;
+if (a > 0) {
+    lets_print{a
+} otherwise {
+    lets_print{0};
+}
+let ok := 5;
@@ -0,0 +1,14 @@
+// Run with --profile: calls to a small getter are inlined in normal runs,
+// but the profile still lists `get` with its 1000 calls and the line of
+// its body.
+define get(x) {
+    yield x + 1;
+}
+
+let total := 0;
+let i := 0;
+repeat_while (1000 > i) {
+    total := total + get(i);
+    i := i + 1;
+}
+lets_print{total};
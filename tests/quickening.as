@@ -0,0 +1,69 @@
+// Sites specialize on the operands and targets they see first and must
+// fall back to the generic path when those change.
+define combine(a, b) {
+    let sum := a + b;
+    yield sum;
+}
+lets_print{combine(2, 3)};
+lets_print{combine(4, 5)};
+lets_print{combine("ab", "cd")};
+lets_print{combine("n", 1)};
+
+define same(a, b) {
+    let equal := a == b;
+    yield equal;
+}
+lets_print{same(3, 3)};
+lets_print{same("x", "x")};
+lets_print{same("x", "y")};
+
+// The read finds its own slot set on the first call only; later calls see
+// the caller's variable.
+let seen := "outer";
+define probe(k) {
+    repeat_while (k > 2) {
+        let seen := k;
+        k := 0;
+    }
+    yield seen;
+}
+lets_print{probe(3)};
+lets_print{probe(1)};
+lets_print{probe(5)};
+
+// A call site whose function is redefined between calls.
+define pick() {
+    yield 1;
+}
+let round := 0;
+repeat_while (3 > round) {
+    lets_print{pick()};
+    check_if (round == 0) {
+        define pick() {
+            yield 2;
+        }
+    }
+    round := round + 1;
+}
+
+// A method call site whose receiver changes blueprint.
+blueprint Cat {
+    let sound := "meow";
+    define speak() {
+        yield sound;
+    }
+}
+blueprint Dog {
+    let sound := "woof";
+    define speak() {
+        yield sound + "!";
+    }
+}
+instance Cat pet;
+instance Dog other;
+let turn := 0;
+repeat_while (3 > turn) {
+    lets_print{pet.speak()};
+    pet := other;
+    turn := turn + 1;
+}
@@ -0,0 +1,42 @@
+// Operations whose operand types inference proves run unchecked; the
+// output must match the checked path.
+define fib(n) {
+    let r := n;
+    repeat_while (n > 1) {
+        r := fib(n - 1) + fib(n - 2);
+        n := 0;
+    }
+    yield r;
+}
+lets_print{fib(15)};
+
+let name := "ada";
+let greeting := "hi " + name;
+lets_print{greeting == "hi ada"};
+lets_print{greeting + 7};
+
+let flag := true;
+let count := flag + 1;
+lets_print{count};
+
+integer total := 0;
+let i := 0;
+repeat_while (10 > i) {
+    total := total + i;
+    i := i + 1;
+}
+lets_print{total};
+
+// Read before the write in the loop body: falls back to the outer value.
+let step := 2;
+check_if (total > 40) {
+    let doubled := step + step;
+    lets_print{doubled};
+}
+
+// Parameters called with both ints and strings stay checked.
+define twice(x) {
+    yield x + x;
+}
+lets_print{twice(4)};
+lets_print{twice("ab")};